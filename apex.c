@@ -0,0 +1,612 @@
+/*
+ *  apex.c
+ *  Contains libapex API, wraps all structures of one machine behind APEX_Sim
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "apex.h"
+#include "cpu.h"
+#include "forwarding.h"
+#include "functional.h"
+#include "checkpoint.h"
+#include "translate.h"
+#include "checker.h"
+#include "image.h"
+#include "cache.h"
+
+_Static_assert(APEX_CONFIG_SUCCESS == SUCCESS, "APEX_CONFIG_SUCCESS must match SUCCESS");
+
+/* Code memory parsed or mapped once, never written after load */
+struct APEX_Program {
+	const APEX_Instruction* code_memory;
+	int code_memory_size;
+	const int* data_memory;		// initial data memory from address 0, NULL leaves it zero
+	int data_memory_size;
+	APEX_Instruction* parsed_code;		// code memory parsed from assembly, NULL for an image
+	int* data_copy;		// data memory from a .data section or set with APEX_program_set_data
+	Program_Image image;		// mapping code and data of an image point into
+};
+
+/* Compiled code of one program, the program has to outlive it */
+struct APEX_Native {
+	const APEX_Program* program;
+	Native_Code code;
+};
+
+/* Arch state of a machine with nothing in flight, all a pipeline needs to continue from there */
+struct APEX_Arch_State {
+	int pc;
+	int regs[REGISTER_FILE_SIZE];
+	int flags[NUM_FLAG];
+	int zf_value;
+	long long position;		// inst executed before this point, functional and committed
+	int data_memory[DATA_MEMORY_SIZE];
+};
+
+/* Everything one simulated machine owns, only a program can be shared between handles */
+struct APEX_Sim {
+	APEX_CPU* cpu;
+	APEX_LSQ* ls_queue;
+	APEX_IQ* issue_queue;
+	APEX_ROB* rob;
+	APEX_RENAME* rename_table;
+	APEX_Config config;		// sizes the structures were made with, checked against checkpoints
+	APEX_Program* own_program;		// program loaded by APEX_sim_create, freed with the handle
+	const Native_Code* native;		// functional engine, NULL runs the interpreter
+	int halted;
+};
+
+
+/*
+ * ########################################## Create Destroy ##########################################
+*/
+
+APEX_Program* APEX_program_load(const char* filename) {
+	if (!filename) {
+		return NULL;
+	}
+	APEX_Program* program = apex_calloc(1, sizeof(*program));
+	if (!program) {
+		return NULL;
+	}
+	// images are mapped in place, anything else is parsed as assembly
+	if (is_program_image(filename)) {
+		if (map_program_image(filename, &program->image) != SUCCESS) {
+			free(program);
+			return NULL;
+		}
+		program->code_memory = program->image.code_memory;
+		program->code_memory_size = program->image.code_memory_size;
+		program->data_memory = program->image.data_memory;
+		program->data_memory_size = program->image.data_memory_size;
+		return program;
+	}
+	// assembly parsed before with the same text and parser is mapped from the program cache
+	char* cache_path = get_program_cache_path(filename);
+	if ((cache_path)&&(map_cached_program(cache_path, &program->image) == SUCCESS)) {
+		free(cache_path);
+		program->code_memory = program->image.code_memory;
+		program->code_memory_size = program->image.code_memory_size;
+		program->data_memory = program->image.data_memory;
+		program->data_memory_size = program->image.data_memory_size;
+		return program;
+	}
+	program->parsed_code = create_code_memory(filename, &program->code_memory_size, &program->data_copy, &program->data_memory_size);
+	if (!program->parsed_code) {
+		free(cache_path);
+		free(program);
+		return NULL;
+	}
+	program->code_memory = program->parsed_code;
+	program->data_memory = program->data_copy;
+	if (cache_path) {
+		save_cached_program(cache_path, program->parsed_code, program->code_memory_size, program->data_copy, program->data_memory_size);
+		free(cache_path);
+	}
+	return program;
+}
+
+
+void APEX_program_free(APEX_Program* program) {
+	// every handle created from the program must be destroyed first
+	if (!program) {
+		return;
+	}
+	unmap_program_image(&program->image);
+	free(program->parsed_code);
+	free(program->data_copy);
+	free(program);
+}
+
+
+int APEX_program_set_data(APEX_Program* program, const int* data, int size) {
+	// machines created from the program afterwards start with data in data memory from address 0
+	if ((!program)||(size < 0)||(size > DATA_MEMORY_SIZE)||((size > 0)&&(!data))) {
+		return APEX_SIM_ERROR;
+	}
+	int* data_copy = NULL;
+	if (size > 0) {
+		data_copy = apex_malloc(sizeof(int) * size);
+		if (!data_copy) {
+			return APEX_SIM_ERROR;
+		}
+		memcpy(data_copy, data, sizeof(int) * size);
+	}
+	free(program->data_copy);
+	program->data_copy = data_copy;
+	program->data_memory = data_copy;
+	program->data_memory_size = size;
+	return 0;
+}
+
+
+int APEX_program_save_image(const APEX_Program* program, const char* filename) {
+	// code memory and initial data memory, APEX_program_load maps it back
+	if ((!program)||(!filename)) {
+		return APEX_SIM_ERROR;
+	}
+	return (write_program_image(filename, program->code_memory, program->code_memory_size, program->data_memory, program->data_memory_size) == SUCCESS) ? 0 : APEX_SIM_ERROR;
+}
+
+
+int APEX_program_get_size(const APEX_Program* program) {
+	return (program) ? program->code_memory_size : 0;
+}
+
+
+int APEX_program_get_data_size(const APEX_Program* program) {
+	return (program) ? program->data_memory_size : 0;
+}
+
+
+APEX_Native* APEX_native_compile(const APEX_Program* program) {
+	// translates the program to C and compiles it with the local cc, takes a while for large programs
+	if (!program) {
+		return NULL;
+	}
+	APEX_Native* native = apex_calloc(1, sizeof(*native));
+	if (!native) {
+		return NULL;
+	}
+	native->program = program;
+	if (load_native_code(&native->code, program->code_memory, program->code_memory_size) != SUCCESS) {
+		free(native);
+		return NULL;
+	}
+	return native;
+}
+
+
+int APEX_native_write_source(const APEX_Program* program, const char* filename) {
+	// the C APEX_native_compile builds, to read what a program is translated to
+	if ((!program)||(!filename)) {
+		return APEX_SIM_ERROR;
+	}
+	FILE* fp = fopen(filename, "w");
+	if (!fp) {
+		fprintf(stderr, "APEX_Native : Unable to open %s\n", filename);
+		return APEX_SIM_ERROR;
+	}
+	int ret = write_native_source(fp, program->code_memory, program->code_memory_size);
+	if ((fclose(fp) != 0)||(ret != SUCCESS)) {
+		return APEX_SIM_ERROR;
+	}
+	return 0;
+}
+
+
+void APEX_native_free(APEX_Native* native) {
+	// every handle using it must be destroyed or set back to the interpreter first
+	if (!native) {
+		return;
+	}
+	unload_native_code(&native->code);
+	free(native);
+}
+
+
+static int init_sim_queues(APEX_Sim* sim, const APEX_Config* config) {
+	sim->config = *config;
+	sim->ls_queue = init_ls_queue(config->lsq_size);
+	sim->issue_queue = init_issue_queue(config->iq_size, config->rename_table_size);
+	sim->rob = init_reorder_buffer(config->rob_size);
+	sim->rename_table = init_rename_table(config->rename_table_size);
+
+	if ((!sim->cpu)||(!sim->ls_queue)||(!sim->issue_queue)||(!sim->rob)||(!sim->rename_table)) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+
+APEX_Sim* APEX_sim_create(const char* filename, const APEX_Config* config, int verbose) {
+	// config must already be checked with check_config
+	if ((!filename)||(!config)||(check_config(config) != SUCCESS)) {
+		return NULL;
+	}
+	APEX_Program* program = APEX_program_load(filename);
+	if (!program) {
+		return NULL;
+	}
+	APEX_Sim* sim = APEX_sim_create_from_program(program, config, verbose);
+	if (!sim) {
+		APEX_program_free(program);
+		return NULL;
+	}
+	sim->own_program = program;
+	return sim;
+}
+
+
+APEX_Sim* APEX_sim_create_from_program(const APEX_Program* program, const APEX_Config* config, int verbose) {
+	// program is only read and has to outlive the handle
+	if ((!program)||(!config)||(check_config(config) != SUCCESS)) {
+		return NULL;
+	}
+	APEX_Sim* sim = apex_calloc(1, sizeof(*sim));
+	if (!sim) {
+		return NULL;
+	}
+	sim->cpu = APEX_cpu_init_from_code(program->code_memory, program->code_memory_size, verbose, config);
+	if (init_sim_queues(sim, config) != SUCCESS) {
+		APEX_sim_destroy(sim);
+		return NULL;
+	}
+	if (program->data_memory_size > 0) {
+		memcpy(sim->cpu->data_memory, program->data_memory, sizeof(int) * program->data_memory_size);
+	}
+	return sim;
+}
+
+
+void APEX_sim_destroy(APEX_Sim* sim) {
+	if (!sim) {
+		return;
+	}
+	if (sim->issue_queue) {
+		deinit_issue_queue(sim->issue_queue);
+	}
+	if (sim->ls_queue) {
+		deinit_ls_queue(sim->ls_queue);
+	}
+	if (sim->rename_table) {
+		deinit_rename_table(sim->rename_table);
+	}
+	if (sim->rob) {
+		deinit_reorder_buffer(sim->rob);
+	}
+	if (sim->cpu) {
+		APEX_cpu_stop(sim->cpu);
+	}
+	APEX_program_free(sim->own_program);
+	free(sim);
+}
+
+
+/*
+ * ########################################## Step ##########################################
+*/
+
+int APEX_sim_step(APEX_Sim* sim, long long num_cycle) {
+	// run num_cycle more cycles, stops early once HALT commits
+	if ((!sim)||(num_cycle < 1)) {
+		return APEX_SIM_ERROR;
+	}
+	if (sim->halted) {
+		return APEX_SIM_HALTED;
+	}
+	if ((sim->cpu->checker)&&(sim->cpu->checker->diverged)) {
+		return APEX_SIM_ERROR;
+	}
+	if (num_cycle > LLONG_MAX - sim->cpu->clock) {
+		num_cycle = LLONG_MAX - sim->cpu->clock;
+	}
+	int ret = APEX_cpu_run(sim->cpu, sim->cpu->clock + num_cycle, sim->ls_queue, sim->issue_queue, sim->rob, sim->rename_table);
+	if (ret == HALT) {
+		sim->halted = 1;
+		return APEX_SIM_HALTED;
+	}
+	if (ret == ERROR) {
+		// checker found a commit which differs from the golden model
+		return APEX_SIM_ERROR;
+	}
+	return APEX_SIM_RUNNING;
+}
+
+
+static int get_in_flight_count(const APEX_Sim* sim) {
+	// every inst past DRF holds a ROB entry, the ones in F and DRF latches do not have one yet
+	int count = sim->rob->buffer_length;
+	for (int lane=0; lane<MAX_WIDTH; lane++) {
+		count += (!sim->cpu->stage[F][lane].empty) + (!sim->cpu->stage[DRF][lane].empty);
+	}
+	return count;
+}
+
+
+static int is_pipeline_empty(const APEX_Sim* sim) {
+	return (get_in_flight_count(sim) == 0);
+}
+
+
+int APEX_sim_run_functional(APEX_Sim* sim, long long max_instructions) {
+	// execute up to max_instructions more inst on arch state only, clock does not move
+	// pipeline reads the same arch regs, flags, data memory and pc, so stepping continues from there
+	if ((!sim)||(max_instructions < 1)) {
+		return APEX_SIM_ERROR;
+	}
+	if (sim->halted) {
+		return APEX_SIM_HALTED;
+	}
+	if (!is_pipeline_empty(sim)) {
+		fprintf(stderr, "APEX_Sim : Functional run needs an empty pipeline, %d inst in flight (ROB, fetch and decode)\n", get_in_flight_count(sim));
+		return APEX_SIM_ERROR;
+	}
+	int ret = (sim->native) ? APEX_native_run(sim->cpu, sim->native, max_instructions) : APEX_functional_run(sim->cpu, max_instructions);
+	if (sim->cpu->checker) {
+		sync_checker(sim->cpu->checker, sim->cpu);
+	}
+	if (ret == HALT) {
+		sim->halted = 1;
+		return APEX_SIM_HALTED;
+	}
+	if (ret == ERROR) {
+		return APEX_SIM_ERROR;
+	}
+	return APEX_SIM_RUNNING;
+}
+
+
+int APEX_sim_set_native(APEX_Sim* sim, const APEX_Native* native) {
+	// functional runs, fast forward included, use native from now on, NULL goes back to the interpreter
+	// native must be compiled from the program the handle was created from
+	if (!sim) {
+		return APEX_SIM_ERROR;
+	}
+	if ((native)&&(native->program->code_memory != sim->cpu->code_memory)) {
+		fprintf(stderr, "APEX_Sim : Native code was compiled from another program\n");
+		return APEX_SIM_ERROR;
+	}
+	sim->native = (native) ? &native->code : NULL;
+	return 0;
+}
+
+
+int APEX_sim_set_checker(APEX_Sim* sim, int enable) {
+	// golden model runs every inst the pipeline commits and stepping stops at the first mismatch
+	// it starts from the current arch state, so nothing can be in flight
+	if (!sim) {
+		return APEX_SIM_ERROR;
+	}
+	deinit_checker(sim->cpu->checker);
+	sim->cpu->checker = NULL;
+	if (!enable) {
+		return 0;
+	}
+	if (!is_pipeline_empty(sim)) {
+		fprintf(stderr, "APEX_Sim : Checker needs an empty pipeline, %d inst in flight (ROB, fetch and decode)\n", get_in_flight_count(sim));
+		return APEX_SIM_ERROR;
+	}
+	sim->cpu->checker = init_checker(sim->cpu);
+	return (sim->cpu->checker) ? 0 : APEX_SIM_ERROR;
+}
+
+
+int APEX_sim_step_instructions(APEX_Sim* sim, long long num_instructions, long long max_cycles) {
+	// run till num_instructions more inst commit, at most max_cycles cycles
+	// commit width can take it a few inst past num_instructions
+	if ((!sim)||(num_instructions < 1)) {
+		return APEX_SIM_ERROR;
+	}
+	if (num_instructions > LLONG_MAX - sim->cpu->ins_completed) {
+		num_instructions = LLONG_MAX - sim->cpu->ins_completed;
+	}
+	sim->cpu->ins_limit = sim->cpu->ins_completed + num_instructions;
+	int ret = APEX_sim_step(sim, max_cycles);
+	sim->cpu->ins_limit = 0;
+	return ret;
+}
+
+
+int APEX_sim_drain(APEX_Sim* sim, long long max_cycles) {
+	// stop fetching and step till every inst in flight committed or got squashed
+	// afterwards arch state is the whole machine state and functional mode can run again
+	if ((!sim)||(max_cycles < 1)) {
+		return APEX_SIM_ERROR;
+	}
+	int ret = APEX_SIM_RUNNING;
+	sim->cpu->fetch_stopped = 1;
+	for (long long cycle=0; (cycle<max_cycles)&&(ret==APEX_SIM_RUNNING)&&(!is_pipeline_empty(sim)); cycle++) {
+		ret = APEX_sim_step(sim, 1);
+	}
+	sim->cpu->fetch_stopped = 0;
+	if ((ret == APEX_SIM_RUNNING)&&(!is_pipeline_empty(sim))) {
+		fprintf(stderr, "APEX_Sim : Pipeline did not drain in %lld cycles\n", max_cycles);
+		return APEX_SIM_ERROR;
+	}
+	return ret;
+}
+
+
+int APEX_sim_fast_forward(APEX_Sim* sim, long long num_instructions, long long warmup_cycles) {
+	// functional run of num_instructions, then warmup_cycles in the pipeline which are not counted
+	if ((!sim)||(num_instructions < 0)) {
+		return APEX_SIM_ERROR;
+	}
+	int ret = (num_instructions > 0) ? APEX_sim_run_functional(sim, num_instructions) : APEX_SIM_RUNNING;
+	if ((ret == APEX_SIM_RUNNING)&&(warmup_cycles > 0)) {
+		ret = APEX_sim_step(sim, warmup_cycles);
+		APEX_sim_reset_stats(sim);
+	}
+	return ret;
+}
+
+
+void APEX_sim_reset_stats(APEX_Sim* sim) {
+	// timing counters start again from here, machine state and functional inst count are kept
+	if (!sim) {
+		return;
+	}
+	sim->cpu->clock = 0;
+	sim->cpu->ins_completed = 0;
+	sim->cpu->cycle_heap_allocs = 0;
+	memset(sim->cpu->stall_cycles, 0, sizeof(sim->cpu->stall_cycles));
+}
+
+
+/*
+ * ########################################## Checkpoint ##########################################
+*/
+
+APEX_Arch_State* APEX_sim_get_arch_state(const APEX_Sim* sim) {
+	// in memory checkpoint of arch state, NULL while inst are in flight
+	if ((!sim)||(!is_pipeline_empty(sim))) {
+		return NULL;
+	}
+	APEX_Arch_State* state = apex_malloc(sizeof(*state));
+	if (!state) {
+		return NULL;
+	}
+	state->pc = sim->cpu->pc;
+	memcpy(state->regs, sim->cpu->regs, sizeof(state->regs));
+	memcpy(state->flags, sim->cpu->flags, sizeof(state->flags));
+	state->zf_value = sim->cpu->zf_value;
+	state->position = sim->cpu->functional_ins_completed + sim->cpu->ins_completed;
+	memcpy(state->data_memory, sim->cpu->data_memory, sizeof(state->data_memory));
+	return state;
+}
+
+
+int APEX_sim_set_arch_state(APEX_Sim* sim, const APEX_Arch_State* state) {
+	// machine continues from state, timing counters are kept, inst before it count as functional
+	if ((!sim)||(!state)||(!is_pipeline_empty(sim))) {
+		return APEX_SIM_ERROR;
+	}
+	sim->cpu->pc = state->pc;
+	memcpy(sim->cpu->regs, state->regs, sizeof(state->regs));
+	memset(sim->cpu->regs_invalid, 0, sizeof(sim->cpu->regs_invalid));
+	memcpy(sim->cpu->flags, state->flags, sizeof(state->flags));
+	sim->cpu->zf_value = state->zf_value;
+	sim->cpu->functional_ins_completed = state->position - sim->cpu->ins_completed;
+	memcpy(sim->cpu->data_memory, state->data_memory, sizeof(state->data_memory));
+	if (sim->cpu->checker) {
+		sync_checker(sim->cpu->checker, sim->cpu);
+	}
+	sim->halted = 0;
+	return 0;
+}
+
+
+void APEX_arch_state_free(APEX_Arch_State* state) {
+	free(state);
+}
+
+
+static Checkpoint_State get_checkpoint_state(const APEX_Sim* sim) {
+	Checkpoint_State state = {
+		.cpu = sim->cpu,
+		.ls_queue = sim->ls_queue,
+		.issue_queue = sim->issue_queue,
+		.rob = sim->rob,
+		.rename_table = sim->rename_table,
+		.config = &sim->config,
+		.halted = sim->halted,
+	};
+	return state;
+}
+
+
+int APEX_sim_save_checkpoint(const APEX_Sim* sim, const char* filename) {
+	// complete machine state, can be taken at any cycle
+	if ((!sim)||(!filename)) {
+		return APEX_SIM_ERROR;
+	}
+	Checkpoint_State state = get_checkpoint_state(sim);
+	return (save_checkpoint(filename, &state, is_pipeline_empty(sim)) == SUCCESS) ? 0 : APEX_SIM_ERROR;
+}
+
+
+int APEX_sim_load_checkpoint(APEX_Sim* sim, const char* filename) {
+	// handle must run the same program, with the saved config unless nothing was in flight at save
+	if ((!sim)||(!filename)) {
+		return APEX_SIM_ERROR;
+	}
+	Checkpoint_State state = get_checkpoint_state(sim);
+	if (load_checkpoint(filename, &state) != SUCCESS) {
+		return APEX_SIM_ERROR;
+	}
+	sim->halted = state.halted;
+	if (sim->cpu->checker) {
+		// stores in flight already wrote data memory, so the golden model can only start from an empty pipeline
+		if (!is_pipeline_empty(sim)) {
+			fprintf(stderr, "APEX_Sim : Checker turned off, %s has inst in flight\n", filename);
+			APEX_sim_set_checker(sim, 0);
+		}
+		else {
+			sync_checker(sim->cpu->checker, sim->cpu);
+		}
+	}
+	return 0;
+}
+
+
+int APEX_checkpoint_get_config(const char* filename, APEX_Config* config) {
+	// config a checkpoint was saved with, to create a handle it fully restores onto
+	if ((!filename)||(!config)) {
+		return FAILURE;
+	}
+	return get_checkpoint_config(filename, config);
+}
+
+
+/*
+ * ########################################## Stats Print ##########################################
+*/
+
+void APEX_sim_get_stats(const APEX_Sim* sim, APEX_Stats* stats) {
+	memset(stats, 0, sizeof(*stats));
+	if (!sim) {
+		return;
+	}
+	stats->cycles = sim->cpu->clock;
+	stats->instructions = sim->cpu->ins_completed;
+	stats->halted = sim->halted;
+	stats->functional_instructions = sim->cpu->functional_ins_completed;
+	stats->rob_full_cycles = sim->cpu->stall_cycles[STALL_ROB_FULL];
+	stats->iq_full_cycles = sim->cpu->stall_cycles[STALL_IQ_FULL];
+	stats->lsq_full_cycles = sim->cpu->stall_cycles[STALL_LSQ_FULL];
+	stats->rename_stall_cycles = sim->cpu->stall_cycles[STALL_RENAME];
+	stats->result_bus_stall_cycles = sim->cpu->stall_cycles[STALL_RESULT_BUS];
+	stats->cycle_heap_allocs = sim->cpu->cycle_heap_allocs;
+	if (sim->cpu->checker) {
+		stats->checked_instructions = sim->cpu->checker->checked;
+		stats->diverged = sim->cpu->checker->diverged;
+	}
+}
+
+
+void APEX_sim_print_state(const APEX_Sim* sim) {
+	// show everything, same as display mode
+	print_cpu_content(sim->cpu);
+	print_ls_iq_content(sim->ls_queue, sim->issue_queue);
+	print_rob_and_rename_content(sim->rob, sim->rename_table);
+}
+
+
+void APEX_sim_print_arch_state(const APEX_Sim* sim) {
+	// flags, arch regs and data memory only
+	print_cpu_content(sim->cpu);
+}
+
+
+void APEX_sim_print_summary(const APEX_Sim* sim, double seconds) {
+	print_run_summary(sim->cpu, seconds);
+}
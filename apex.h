@@ -0,0 +1,117 @@
+#ifndef _APEX_H_
+#define _APEX_H_
+/*
+ *  apex.h
+ *  Contains libapex API, one opaque APEX_Sim handle per simulated machine
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include "config.h"
+
+/* APEX_sim_step return codes */
+#define APEX_SIM_RUNNING 0		// requested cycles done, program has not halted
+#define APEX_SIM_HALTED 1		// HALT committed, further steps do nothing
+#define APEX_SIM_ERROR -1		// invalid handle or cycle count, or functional run with inst in flight
+
+/* Config functions in config.h and APEX_checkpoint_get_config return this when the value or file is accepted */
+#define APEX_CONFIG_SUCCESS 2
+
+/* Program parsed from assembly or mapped from an apex_asm image, only read by machines so one program can be shared by many handles */
+typedef struct APEX_Program APEX_Program;
+
+/* Arch regs, flags, data memory and pc of a machine with nothing in flight, an in memory checkpoint */
+typedef struct APEX_Arch_State APEX_Arch_State;
+
+/* Program translated to C and compiled to a shared object, a functional engine for handles running that program */
+typedef struct APEX_Native APEX_Native;
+
+/* Handle owns CPU, IQ, LSQ, ROB and rename table of one machine, handles share no state */
+typedef struct APEX_Sim APEX_Sim;
+
+/* verbose of APEX_sim_create is VERBOSE_QUIET(0) to VERBOSE_ALL(3), quiet prints nothing while stepping */
+
+/* Counters of one machine since create */
+typedef struct APEX_Stats {
+	long long cycles;			// clock cycles elapsed
+	long long instructions;		// inst committed
+	int halted;			// 1 once HALT committed
+	long long functional_instructions;		// inst executed by APEX_sim_run_functional, interpreted or native
+	long long rob_full_cycles;		// cycles dispatch waited for a ROB entry
+	long long iq_full_cycles;		// cycles dispatch waited for an IQ entry
+	long long lsq_full_cycles;		// cycles dispatch waited for an LSQ entry
+	long long rename_stall_cycles;		// cycles decode waited for a free phys reg
+	long long result_bus_stall_cycles;		// cycles results waited for a result bus
+	unsigned long cycle_heap_allocs;		// heap allocations made while stepping, expected to stay 0
+	long long checked_instructions;		// commits compared with the golden model, 0 without checker
+	int diverged;		// 1 once a commit differed from the golden model
+} APEX_Stats;
+
+/* SMARTS style sampling, sizes are in committed inst */
+typedef struct APEX_Sample_Config {
+	long long unit_size;		// inst measured in each sample
+	long long warmup_size;		// inst run in the pipeline before each unit and not measured
+	int initial_samples;		// samples of first round, later rounds take as many as the target needs
+	int max_rounds;		// rounds run at most to reach target_error
+	double target_error;		// wanted half width of the interval relative to CPI, eg: 0.03
+	double z;		// z score of the confidence level, eg: 3.0 for 99.7%
+	long long max_instructions;		// inst of the program sampled, 0 samples it till HALT
+	int threads;		// windows run at once on their own machines, 1 runs them in one machine
+} APEX_Sample_Config;
+
+/* Estimate of the last round */
+typedef struct APEX_Sample_Result {
+	long long program_instructions;		// inst sampled over
+	int samples;		// units measured in last round
+	int rounds;		// rounds run
+	int exact;		// program was too short to sample, CPI is of a full pipeline run
+	int target_met;		// error is at most target_error
+	double cpi;		// mean CPI of the units
+	double cpi_stddev;		// standard deviation of unit CPI
+	double cpi_low;		// confidence interval of CPI
+	double cpi_high;
+	double error;		// half width of the interval relative to CPI
+	long long detailed_cycles;		// pipeline cycles of all rounds, warmup and drain included
+	long long detailed_instructions;		// inst committed by the pipeline in all rounds
+	long long functional_instructions;		// inst run in functional mode in all rounds
+} APEX_Sample_Result;
+
+APEX_API APEX_Program* APEX_program_load(const char* filename);
+APEX_API void APEX_program_free(APEX_Program* program);
+APEX_API int APEX_program_set_data(APEX_Program* program, const int* data, int size);
+APEX_API int APEX_program_save_image(const APEX_Program* program, const char* filename);
+APEX_API int APEX_program_get_size(const APEX_Program* program);
+APEX_API int APEX_program_get_data_size(const APEX_Program* program);
+
+APEX_API APEX_Native* APEX_native_compile(const APEX_Program* program);
+APEX_API int APEX_native_write_source(const APEX_Program* program, const char* filename);
+APEX_API void APEX_native_free(APEX_Native* native);
+
+APEX_API APEX_Sim* APEX_sim_create(const char* filename, const APEX_Config* config, int verbose);
+APEX_API APEX_Sim* APEX_sim_create_from_program(const APEX_Program* program, const APEX_Config* config, int verbose);
+APEX_API int APEX_sim_step(APEX_Sim* sim, long long num_cycle);
+APEX_API int APEX_sim_step_instructions(APEX_Sim* sim, long long num_instructions, long long max_cycles);
+APEX_API int APEX_sim_drain(APEX_Sim* sim, long long max_cycles);
+APEX_API int APEX_sim_run_functional(APEX_Sim* sim, long long max_instructions);
+APEX_API int APEX_sim_set_native(APEX_Sim* sim, const APEX_Native* native);
+APEX_API int APEX_sim_set_checker(APEX_Sim* sim, int enable);
+APEX_API int APEX_sim_fast_forward(APEX_Sim* sim, long long num_instructions, long long warmup_cycles);
+APEX_API void APEX_sim_reset_stats(APEX_Sim* sim);
+APEX_API int APEX_sim_save_checkpoint(const APEX_Sim* sim, const char* filename);
+APEX_API int APEX_sim_load_checkpoint(APEX_Sim* sim, const char* filename);
+APEX_API int APEX_checkpoint_get_config(const char* filename, APEX_Config* config);
+APEX_API APEX_Arch_State* APEX_sim_get_arch_state(const APEX_Sim* sim);
+APEX_API int APEX_sim_set_arch_state(APEX_Sim* sim, const APEX_Arch_State* state);
+APEX_API void APEX_arch_state_free(APEX_Arch_State* state);
+APEX_API void APEX_sim_get_stats(const APEX_Sim* sim, APEX_Stats* stats);
+APEX_API void APEX_sim_print_state(const APEX_Sim* sim);
+APEX_API void APEX_sim_print_arch_state(const APEX_Sim* sim);
+APEX_API void APEX_sim_print_summary(const APEX_Sim* sim, double seconds);
+APEX_API void APEX_sim_destroy(APEX_Sim* sim);
+
+APEX_API void APEX_sample_default_config(APEX_Sample_Config* sample);
+APEX_API int APEX_sample_run(const APEX_Program* program, const APEX_Config* config, const APEX_Sample_Config* sample, APEX_Sample_Result* result);
+
+#endif
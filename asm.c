@@ -0,0 +1,110 @@
+/*
+ *  asm.c
+ *  Contains apex_asm, assembles a program once into a binary image apex_sim and apex_sweep map directly
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "apex.h"
+
+
+static double get_wall_time() {
+	// monotonic wall clock in seconds, used to report assemble time
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+
+static void print_usage(const char* program) {
+	fprintf(stderr, "APEX_Help : Usage %s <input_file> <output_image> [--data=<file>]\n", program);
+	fprintf(stderr, "APEX_Help : --data takes whitespace separated numbers, the n'th one is the initial value of data memory address n\n");
+	fprintf(stderr, "APEX_Help : the image can be passed to apex_sim and apex_sweep in place of the assembly file\n");
+}
+
+
+static int* read_data_file(const char* filename, int* size) {
+	// numbers are kept as they are, APEX_program_set_data checks the count fits data memory
+	FILE* fp = fopen(filename, "r");
+	if (!fp) {
+		fprintf(stderr, "APEX_Asm : Unable to open %s\n", filename);
+		return NULL;
+	}
+	int capacity = 256;
+	int* data = malloc(sizeof(int) * capacity);
+	*size = 0;
+	int value = 0;
+	while ((data)&&(fscanf(fp, "%d", &value) == 1)) {
+		if (*size == capacity) {
+			capacity *= 2;
+			int* grown = realloc(data, sizeof(int) * capacity);
+			if (!grown) {
+				free(data);
+				data = NULL;
+				break;
+			}
+			data = grown;
+		}
+		data[(*size)++] = value;
+	}
+	if ((data)&&(!feof(fp))) {
+		fprintf(stderr, "APEX_Asm : %s has something other than a number after %d values\n", filename, *size);
+		free(data);
+		data = NULL;
+	}
+	fclose(fp);
+	return data;
+}
+
+
+int main(int argc, char const* argv[]) {
+
+	if (argc < 3) {
+		print_usage(argv[0]);
+		exit(1);
+	}
+	const char* data_file = NULL;
+	for (int i=3; i<argc; i++) {
+		if (strncmp(argv[i], "--data=", 7) == 0) {
+			data_file = argv[i] + 7;
+		}
+		else {
+			fprintf(stderr, "APEX_Asm : Invalid option '%s'\n", argv[i]);
+			print_usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	double start_time = get_wall_time();
+	APEX_Program* program = APEX_program_load(argv[1]);
+	if (!program) {
+		fprintf(stderr, "APEX_Asm : Unable to load %s\n", argv[1]);
+		exit(1);
+	}
+	if (data_file) {
+		// replaces a .data section of the input file
+		int data_size = 0;
+		int* data = read_data_file(data_file, &data_size);
+		int ret = (data) ? APEX_program_set_data(program, data, data_size) : APEX_SIM_ERROR;
+		free(data);
+		if (ret != 0) {
+			fprintf(stderr, "APEX_Asm : Unable to use %s as initial data memory\n", data_file);
+			APEX_program_free(program);
+			exit(1);
+		}
+	}
+	if (APEX_program_save_image(program, argv[2]) != 0) {
+		APEX_program_free(program);
+		exit(1);
+	}
+	printf("Wrote %s, %d inst and %d data words in %.6f s\n", argv[2], APEX_program_get_size(program), APEX_program_get_data_size(program), get_wall_time() - start_time);
+	APEX_program_free(program);
+	return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ *  cache.c
+ *  Contains APEX program cache, parsed code memory kept as images keyed by a hash of the assembly text
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "forwarding.h"
+
+/*
+ * ########################################## Key ##########################################
+*/
+
+static uint64_t mix_hash(uint64_t hash) {
+	// final avalanche, every input bit reaches every output bit
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+
+static uint64_t get_text_hash(const unsigned char* text, size_t size) {
+	// FNV-1a over 8 byte words, fast enough to be a small part of parse time, not meant to resist crafted collisions
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, text + i, sizeof(word));
+		hash = (hash ^ word) * 0x100000001b3ULL;
+	}
+	for (; i<size; i++) {
+		hash = (hash ^ text[i]) * 0x100000001b3ULL;
+	}
+	return mix_hash(hash);
+}
+
+
+static int get_source_key(const char* filename, uint64_t* hash, uint64_t* size) {
+	// only regular files are cached, pipes cannot be read twice
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return FAILURE;
+	}
+	struct stat file_stat;
+	void* text = MAP_FAILED;
+	if ((fstat(fd, &file_stat) == 0)&&(S_ISREG(file_stat.st_mode))&&(file_stat.st_size > 0)) {
+		*size = (uint64_t)file_stat.st_size;
+		text = mmap(NULL, (size_t)*size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (text == MAP_FAILED) {
+		return FAILURE;
+	}
+	*hash = get_text_hash(text, (size_t)*size);
+	munmap(text, (size_t)*size);
+	// versions are part of the key, a new parser or image layout never sees old entries
+	*hash = mix_hash(*hash ^ ((uint64_t)PARSER_VERSION << 32) ^ ((uint64_t)IMAGE_VERSION << 16) ^ sizeof(APEX_Instruction));
+	return SUCCESS;
+}
+
+
+/*
+ * ########################################## Cache Dir ##########################################
+*/
+
+static char* join_path(const char* base, const char* suffix) {
+	size_t size = strlen(base) + strlen(suffix) + 1;
+	char* path = apex_malloc(size);
+	if (path) {
+		snprintf(path, size, "%s%s", base, suffix);
+	}
+	return path;
+}
+
+
+static char* get_cache_dir() {
+	const char* dir = getenv(CACHE_DIR_ENV);
+	if (dir) {
+		return (dir[0] != '\0') ? join_path(dir, "") : NULL;
+	}
+	const char* base = getenv("XDG_CACHE_HOME");
+	const char* suffix = "/" CACHE_SUBDIR;
+	if ((!base)||(base[0] == '\0')) {
+		base = getenv("HOME");
+		suffix = "/.cache/" CACHE_SUBDIR;
+	}
+	if ((!base)||(base[0] == '\0')) {
+		return NULL;
+	}
+	return join_path(base, suffix);
+}
+
+
+static int make_dirs(char* path) {
+	// mkdir -p, path is changed while walking it and put back
+	for (char* pos = path + 1; ; pos++) {
+		if ((*pos == '/')||(*pos == '\0')) {
+			char saved = *pos;
+			*pos = '\0';
+			int ret = mkdir(path, 0755);
+			*pos = saved;
+			if ((ret != 0)&&(errno != EEXIST)) {
+				return FAILURE;
+			}
+			if (saved == '\0') {
+				return SUCCESS;
+			}
+		}
+	}
+}
+
+
+/*
+ * ########################################## Lookup Save ##########################################
+*/
+
+char* get_program_cache_path(const char* filename) {
+	// <cache dir>/<hash>-<size>.img, NULL when caching is off or the file is not cacheable
+	uint64_t hash = 0;
+	uint64_t size = 0;
+	char* dir = get_cache_dir();
+	if ((!dir)||(get_source_key(filename, &hash, &size) != SUCCESS)) {
+		free(dir);
+		return NULL;
+	}
+	size_t path_size = strlen(dir) + 64;
+	char* path = apex_malloc(path_size);
+	if (path) {
+		snprintf(path, path_size, "%s/%016llx-%llu.img", dir, (unsigned long long)hash, (unsigned long long)size);
+	}
+	free(dir);
+	return path;
+}
+
+
+int map_cached_program(const char* cache_path, Program_Image* image) {
+	// a miss is quiet, a damaged entry is reported by map_program_image and overwritten after parsing
+	struct stat file_stat;
+	if (stat(cache_path, &file_stat) != 0) {
+		return FAILURE;
+	}
+	return map_program_image(cache_path, image);
+}
+
+
+void save_cached_program(const char* cache_path, const APEX_Instruction* code_memory, int code_memory_size, const int* data_memory, int data_memory_size) {
+	// best effort, a read only or full disk only means the next run parses again
+	char* dir = join_path(cache_path, "");
+	char* slash = (dir) ? strrchr(dir, '/') : NULL;
+	if (slash) {
+		*slash = '\0';
+		if ((dir[0] != '\0')&&(make_dirs(dir) != SUCCESS)) {
+			free(dir);
+			return;
+		}
+	}
+	free(dir);
+	write_program_image(cache_path, code_memory, code_memory_size, data_memory, data_memory_size);
+}
@@ -0,0 +1,24 @@
+#ifndef _APEX_CACHE_H_
+#define _APEX_CACHE_H_
+/*
+ *  cache.h
+ *  Contains APEX program cache, parsed code memory kept as images keyed by a hash of the assembly text
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include "cpu.h"
+#include "image.h"
+
+/* Cache dir is $APEX_CACHE_DIR, else $XDG_CACHE_HOME/apex, else $HOME/.cache/apex, APEX_CACHE_DIR set empty turns it off */
+#define CACHE_DIR_ENV "APEX_CACHE_DIR"
+#define CACHE_SUBDIR "apex"
+
+
+char* get_program_cache_path(const char* filename);
+int map_cached_program(const char* cache_path, Program_Image* image);
+void save_cached_program(const char* cache_path, const APEX_Instruction* code_memory, int code_memory_size, const int* data_memory, int data_memory_size);
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ *  checker.c
+ *  Contains APEX lockstep checker, a functional golden model stepped on every commit
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "rob.h"
+#include "checker.h"
+#include "functional.h"
+#include "forwarding.h"
+
+/*
+ * ########################################## Golden Model ##########################################
+*/
+
+APEX_Checker* init_checker(const APEX_CPU* cpu) {
+	// golden model starts from the arch state of cpu, so cpu must have nothing in flight
+	APEX_Checker* checker = apex_calloc(1, sizeof(*checker));
+	if (!checker) {
+		return NULL;
+	}
+	checker->golden = apex_calloc(1, sizeof(APEX_CPU));
+	if (!checker->golden) {
+		free(checker);
+		return NULL;
+	}
+	checker->golden->code_memory = cpu->code_memory;
+	checker->golden->code_memory_size = cpu->code_memory_size;
+	checker->golden->verbose = VERBOSE_QUIET;
+	// reg numbers are checked once here, every step afterwards skips it
+	if (APEX_functional_check(checker->golden) != SUCCESS) {
+		deinit_checker(checker);
+		return NULL;
+	}
+	sync_checker(checker, cpu);
+	return checker;
+}
+
+
+void deinit_checker(APEX_Checker* checker) {
+	if (!checker) {
+		return;
+	}
+	free(checker->golden);
+	free(checker);
+}
+
+
+void sync_checker(APEX_Checker* checker, const APEX_CPU* cpu) {
+	// arch state changed without commits, eg: functional run or a restored checkpoint
+	APEX_CPU* golden = checker->golden;
+	golden->pc = cpu->pc;
+	memcpy(golden->regs, cpu->regs, sizeof(golden->regs));
+	memcpy(golden->flags, cpu->flags, sizeof(golden->flags));
+	memcpy(golden->data_memory, cpu->data_memory, sizeof(golden->data_memory));
+	golden->zf_value = cpu->zf_value;
+	checker->diverged = 0;
+}
+
+
+/*
+ * ########################################## Commit Check ##########################################
+*/
+
+static int report_divergence(APEX_Checker* checker, const APEX_CPU* cpu, const ROB_Entry* rob_entry, const char* what, int value, int expected) {
+	// two lines, where it happened and the first value which differs
+	checker->diverged = 1;
+	fprintf(stderr, "APEX_Checker : Diverged at cycle %lld, commit %lld, pc(%d) %s\n", cpu->clock, checker->checked, rob_entry->pc, get_inst_name(rob_entry->inst_type));
+	fprintf(stderr, "APEX_Checker : %s is %d, golden model has %d\n", what, value, expected);
+	return ERROR;
+}
+
+
+int check_commit(APEX_Checker* checker, const APEX_CPU* cpu, const ROB_Entry* rob_entry, APEX_RENAME* rename_table) {
+	// golden model runs the inst the pipeline commits and the results are compared
+	// dest reg and value, store address and data, and next pc of branches and jumps
+	// next pc of other inst is checked by the pc of the following commit
+	if (checker->diverged) {
+		return ERROR;
+	}
+	APEX_CPU* golden = checker->golden;
+	// NOP never gets a ROB entry, the golden model steps over it without a commit to check
+	while ((golden->pc >= 4000)&&((golden->pc - 4000) / 4 < golden->code_memory_size)&&(golden->code_memory[(golden->pc - 4000) / 4].type == NOP)) {
+		golden->pc += 4;
+	}
+	int pc = golden->pc;
+	checker->checked += 1;
+	if (rob_entry->pc != pc) {
+		return report_divergence(checker, cpu, rob_entry, "commit pc", rob_entry->pc, pc);
+	}
+	int index = (pc - 4000) / 4;
+	if ((pc < 4000)||(index >= golden->code_memory_size)) {
+		return report_divergence(checker, cpu, rob_entry, "commit pc past code memory end", pc, 4000 + (golden->code_memory_size * 4));
+	}
+	const APEX_Instruction* ins = &golden->code_memory[index];
+	if (rob_entry->inst_type != ins->type) {
+		return report_divergence(checker, cpu, rob_entry, "inst type", rob_entry->inst_type, ins->type);
+	}
+
+	// store operands are read before the golden model runs the store
+	int address = 0;
+	int data = 0;
+	if ((ins->type == STORE)||(ins->type == STR)) {
+		int offset = (ins->type == STORE) ? ins->imm : golden->regs[ins->rs2];
+		address = (int)((unsigned int)golden->regs[ins->rs1] + (unsigned int)offset);
+		data = golden->regs[ins->rd];
+	}
+	APEX_functional_run_checked(golden, 1);
+
+	int arch_reg = -1;
+	int next_pc = 0;
+	switch (ins->type) {
+		case STORE:
+		case STR:
+			if (rob_entry->mem_address != address) {
+				return report_divergence(checker, cpu, rob_entry, "store address", rob_entry->mem_address, address);
+			}
+			if (rob_entry->rd_value != data) {
+				return report_divergence(checker, cpu, rob_entry, "store data", rob_entry->rd_value, data);
+			}
+			break;
+		case BZ:
+		case BNZ:
+			// taken branches carry the exception, not taken ones fall through
+			next_pc = (rob_entry->exception) ? pc + ins->imm : pc + 4;
+			if (next_pc != golden->pc) {
+				return report_divergence(checker, cpu, rob_entry, "next pc", next_pc, golden->pc);
+			}
+			break;
+		case JUMP:
+			if (rob_entry->mem_address != golden->pc) {
+				return report_divergence(checker, cpu, rob_entry, "next pc", rob_entry->mem_address, golden->pc);
+			}
+			break;
+		case HALT:
+			break;
+		default:
+			if ((rob_entry->rd >= 0)&&(rob_entry->rd < rename_table->size)) {
+				arch_reg = get_phy_reg_renamed_tag(rob_entry->rd, rename_table);
+			}
+			if (arch_reg != ins->rd) {
+				return report_divergence(checker, cpu, rob_entry, "dest reg", arch_reg, ins->rd);
+			}
+			if (rob_entry->rd_value != golden->regs[ins->rd]) {
+				return report_divergence(checker, cpu, rob_entry, "dest value", rob_entry->rd_value, golden->regs[ins->rd]);
+			}
+			break;
+	}
+	return SUCCESS;
+}
@@ -0,0 +1,28 @@
+#ifndef _APEX_CHECKER_H_
+#define _APEX_CHECKER_H_
+/*
+ *  checker.h
+ *  Contains APEX lockstep checker, a functional golden model stepped on every commit
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include "cpu.h"
+#include "rob.h"
+
+/* Golden model of one machine, runs one inst on its own arch state for every inst the pipeline commits */
+typedef struct APEX_Checker {
+	APEX_CPU* golden;		// arch regs, flags, data memory and pc only, no pipeline
+	long long checked;		// inst compared since the checker was created
+	int diverged;		// set at the first mismatch, commit stops from then on
+} APEX_Checker;
+
+
+APEX_Checker* init_checker(const APEX_CPU* cpu);
+void deinit_checker(APEX_Checker* checker);
+void sync_checker(APEX_Checker* checker, const APEX_CPU* cpu);
+int check_commit(APEX_Checker* checker, const APEX_CPU* cpu, const ROB_Entry* rob_entry, APEX_RENAME* rename_table);
+
+#endif
@@ -0,0 +1,374 @@
+/*
+ *  checkpoint.c
+ *  Contains APEX checkpoint, complete machine state saved to and restored from a binary file
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+#include "forwarding.h"
+
+_Static_assert(sizeof(Checkpoint_Header) % 8 == 0, "Checkpoint_Header must keep 8 byte aligned sections table");
+
+/*
+ * ########################################## Layout ##########################################
+*/
+
+static uint64_t get_code_hash(const APEX_CPU* cpu) {
+	// FNV-1a over the predecoded code memory
+	const unsigned char* bytes = (const unsigned char*)cpu->code_memory;
+	size_t size = (size_t)cpu->code_memory_size * sizeof(APEX_Instruction);
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i=0; i<size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+
+static uint64_t get_aligned_offset(uint64_t offset) {
+	return (offset + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+}
+
+
+static void set_section_table(Checkpoint_Header* header, const Checkpoint_State* state) {
+	// section sizes follow from the sizes of the machine, sections are laid out in enum order
+	header->sections[CKPT_MACHINE].size = sizeof(Checkpoint_Machine);
+	header->sections[CKPT_RESULT_QUEUE].size = (uint64_t)state->cpu->result_queue_size * sizeof(CPU_Stage);
+	header->sections[CKPT_ROB_ENTRIES].size = (uint64_t)state->rob->size * sizeof(APEX_ROB_ENTRY);
+	header->sections[CKPT_RENAME_ENTRIES].size = (uint64_t)state->rename_table->size * sizeof(APEX_RENAME_TABLE);
+	header->sections[CKPT_FREE_LIST].size = (uint64_t)state->rename_table->size * sizeof(int);
+	header->sections[CKPT_IQ_ENTRIES].size = (uint64_t)state->issue_queue->size * sizeof(IQ_FORMAT);
+	header->sections[CKPT_IQ_MASKS].size = get_issue_queue_mask_bytes(state->issue_queue);
+	header->sections[CKPT_LSQ_ENTRIES].size = (uint64_t)state->ls_queue->size * sizeof(LSQ_FORMAT);
+
+	uint64_t offset = get_aligned_offset(sizeof(Checkpoint_Header));
+	for (int i=0; i<NUM_CKPT_SECTIONS; i++) {
+		header->sections[i].offset = offset;
+		offset = get_aligned_offset(offset + header->sections[i].size);
+	}
+}
+
+
+static void* get_section_data(const Checkpoint_State* state, Checkpoint_Machine* machine, int section) {
+	// live storage a section is saved from and restored into
+	switch (section) {
+		case CKPT_MACHINE:
+			return machine;
+		case CKPT_RESULT_QUEUE:
+			return state->cpu->result_queue;
+		case CKPT_ROB_ENTRIES:
+			return state->rob->rob_entry;
+		case CKPT_RENAME_ENTRIES:
+			return state->rename_table->reg_rename;
+		case CKPT_FREE_LIST:
+			return state->rename_table->free_list;
+		case CKPT_IQ_ENTRIES:
+			return state->issue_queue->iq_entries;
+		case CKPT_IQ_MASKS:
+			return state->issue_queue->mask_storage;
+		case CKPT_LSQ_ENTRIES:
+			return state->ls_queue->lsq_entries;
+		default:
+			return NULL;
+	}
+}
+
+
+/*
+ * ########################################## Machine Section ##########################################
+*/
+
+static void get_machine_state(Checkpoint_Machine* machine, const Checkpoint_State* state) {
+	const APEX_CPU* cpu = state->cpu;
+	machine->clock = cpu->clock;
+	machine->pc = cpu->pc;
+	memcpy(machine->regs, cpu->regs, sizeof(machine->regs));
+	memcpy(machine->regs_invalid, cpu->regs_invalid, sizeof(machine->regs_invalid));
+	memcpy(machine->stage, cpu->stage, sizeof(machine->stage));
+	memcpy(machine->flags, cpu->flags, sizeof(machine->flags));
+	memcpy(machine->data_memory, cpu->data_memory, sizeof(machine->data_memory));
+	machine->ins_completed = cpu->ins_completed;
+	machine->result_head = cpu->result_head;
+	machine->result_count = cpu->result_count;
+	machine->zf_tag = cpu->zf_tag;
+	machine->zf_value = cpu->zf_value;
+	memcpy(machine->stall_cycles, cpu->stall_cycles, sizeof(machine->stall_cycles));
+	machine->cycle_stalls = cpu->cycle_stalls;
+	machine->rob_commit_ptr = state->rob->commit_ptr;
+	machine->rob_issue_ptr = state->rob->issue_ptr;
+	machine->rob_buffer_length = state->rob->buffer_length;
+	memcpy(machine->rat_rename, state->rename_table->rat_rename, sizeof(machine->rat_rename));
+	machine->rename_free_head = state->rename_table->free_head;
+	machine->rename_free_count = state->rename_table->free_count;
+	machine->lsq_next_seq = state->ls_queue->next_seq;
+	machine->functional_ins_completed = cpu->functional_ins_completed;
+	machine->cycle_heap_allocs = cpu->cycle_heap_allocs;
+}
+
+
+static void set_arch_state(const Checkpoint_Machine* machine, APEX_CPU* cpu) {
+	// what functional mode works on, enough to continue when nothing was in flight
+	cpu->pc = machine->pc;
+	memcpy(cpu->regs, machine->regs, sizeof(machine->regs));
+	memcpy(cpu->regs_invalid, machine->regs_invalid, sizeof(machine->regs_invalid));
+	memcpy(cpu->flags, machine->flags, sizeof(machine->flags));
+	memcpy(cpu->data_memory, machine->data_memory, sizeof(machine->data_memory));
+	cpu->zf_value = machine->zf_value;
+	cpu->functional_ins_completed = machine->functional_ins_completed;
+}
+
+
+static void set_machine_state(const Checkpoint_Machine* machine, const Checkpoint_State* state) {
+	APEX_CPU* cpu = state->cpu;
+	set_arch_state(machine, cpu);
+	cpu->clock = machine->clock;
+	memcpy(cpu->stage, machine->stage, sizeof(machine->stage));
+	cpu->ins_completed = machine->ins_completed;
+	cpu->result_head = machine->result_head;
+	cpu->result_count = machine->result_count;
+	cpu->zf_tag = machine->zf_tag;
+	memcpy(cpu->stall_cycles, machine->stall_cycles, sizeof(machine->stall_cycles));
+	cpu->cycle_stalls = machine->cycle_stalls;
+	cpu->cycle_heap_allocs = machine->cycle_heap_allocs;
+	state->rob->commit_ptr = machine->rob_commit_ptr;
+	state->rob->issue_ptr = machine->rob_issue_ptr;
+	state->rob->buffer_length = machine->rob_buffer_length;
+	memcpy(state->rename_table->rat_rename, machine->rat_rename, sizeof(machine->rat_rename));
+	state->rename_table->free_head = machine->rename_free_head;
+	state->rename_table->free_count = machine->rename_free_count;
+	state->ls_queue->next_seq = machine->lsq_next_seq;
+}
+
+
+static int check_machine_state(const Checkpoint_Machine* machine, const Checkpoint_State* state) {
+	// ring pointers and tags index arrays directly, so a damaged file must not get past here
+	int rob_size = state->rob->size;
+	int rename_size = state->rename_table->size;
+	int queue_size = state->cpu->result_queue_size;
+	// ROB pointers wrap lazily, so they can be equal to the size
+	if ((machine->rob_commit_ptr < 0)||(machine->rob_commit_ptr > rob_size)||
+		(machine->rob_issue_ptr < 0)||(machine->rob_issue_ptr > rob_size)||
+		(machine->rob_buffer_length < 0)||(machine->rob_buffer_length > rob_size)||
+		(machine->result_head < 0)||(machine->result_head >= queue_size)||
+		(machine->result_count < 0)||(machine->result_count > queue_size)||
+		(machine->rename_free_head < 0)||(machine->rename_free_head >= rename_size)||
+		(machine->rename_free_count < 0)||(machine->rename_free_count > rename_size)||
+		(machine->zf_tag < -1)||(machine->zf_tag >= rename_size)) {
+		return FAILURE;
+	}
+	for (int i=0; i<REGISTER_FILE_SIZE; i++) {
+		if ((machine->rat_rename[i] < -1)||(machine->rat_rename[i] >= rename_size)) {
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+
+/*
+ * ########################################## Save ##########################################
+*/
+
+static int write_section(FILE* fp, const void* data, uint64_t size, uint64_t offset, uint64_t* position) {
+	// zero padding up to the section offset, then the section itself
+	static const char padding[CHECKPOINT_ALIGN];
+	while (*position < offset) {
+		size_t pad = ((offset - *position) < sizeof(padding)) ? (size_t)(offset - *position) : sizeof(padding);
+		if (fwrite(padding, 1, pad, fp) != pad) {
+			return FAILURE;
+		}
+		*position += pad;
+	}
+	if ((size > 0)&&(fwrite(data, 1, size, fp) != size)) {
+		return FAILURE;
+	}
+	*position += size;
+	return SUCCESS;
+}
+
+
+int save_checkpoint(const char* filename, const Checkpoint_State* state, int pipeline_empty) {
+	// written to <filename>.tmp first and renamed, so an interrupted save keeps the old checkpoint
+	Checkpoint_Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.version = CHECKPOINT_VERSION;
+	header.byte_order = CHECKPOINT_BYTE_ORDER;
+	header.header_size = sizeof(header);
+	header.pipeline_empty = pipeline_empty ? 1 : 0;
+	header.halted = state->halted ? 1 : 0;
+	header.code_size = state->cpu->code_memory_size;
+	header.code_hash = get_code_hash(state->cpu);
+	header.config = *state->config;
+	set_section_table(&header, state);
+
+	Checkpoint_Machine* machine = apex_calloc(1, sizeof(*machine));
+	size_t name_size = strlen(filename) + 5;
+	char* temp_name = apex_malloc(name_size);
+	if ((!machine)||(!temp_name)) {
+		free(machine);
+		free(temp_name);
+		return FAILURE;
+	}
+	get_machine_state(machine, state);
+	snprintf(temp_name, name_size, "%s.tmp", filename);
+
+	int ret = FAILURE;
+	FILE* fp = fopen(temp_name, "wb");
+	if (!fp) {
+		fprintf(stderr, "APEX_Checkpoint : Unable to open %s\n", temp_name);
+	}
+	else {
+		uint64_t position = 0;
+		ret = write_section(fp, &header, sizeof(header), 0, &position);
+		for (int i=0; (i<NUM_CKPT_SECTIONS)&&(ret==SUCCESS); i++) {
+			ret = write_section(fp, get_section_data(state, machine, i), header.sections[i].size, header.sections[i].offset, &position);
+		}
+		if ((fclose(fp) != 0)||(ret != SUCCESS)) {
+			fprintf(stderr, "APEX_Checkpoint : Unable to write %s\n", temp_name);
+			remove(temp_name);
+			ret = FAILURE;
+		}
+		else if (rename(temp_name, filename) != 0) {
+			fprintf(stderr, "APEX_Checkpoint : Unable to rename %s to %s\n", temp_name, filename);
+			remove(temp_name);
+			ret = FAILURE;
+		}
+	}
+	free(temp_name);
+	free(machine);
+	return ret;
+}
+
+
+/*
+ * ########################################## Load ##########################################
+*/
+
+static const unsigned char* map_checkpoint(const char* filename, size_t* size) {
+	// whole file is mapped read only, sections are copied out of it
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "APEX_Checkpoint : Unable to open %s\n", filename);
+		return NULL;
+	}
+	struct stat file_stat;
+	void* data = MAP_FAILED;
+	if ((fstat(fd, &file_stat) == 0)&&(file_stat.st_size >= (off_t)sizeof(Checkpoint_Header))) {
+		*size = (size_t)file_stat.st_size;
+		data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "APEX_Checkpoint : %s is not a checkpoint\n", filename);
+		return NULL;
+	}
+	return data;
+}
+
+
+static int check_checkpoint_header(const Checkpoint_Header* header, size_t file_size, const char* filename) {
+	if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0) {
+		fprintf(stderr, "APEX_Checkpoint : %s is not a checkpoint\n", filename);
+		return FAILURE;
+	}
+	if ((header->byte_order != CHECKPOINT_BYTE_ORDER)||(header->version != CHECKPOINT_VERSION)||(header->header_size != sizeof(*header))) {
+		fprintf(stderr, "APEX_Checkpoint : %s is version %u, this build reads version %u\n", filename, header->version, CHECKPOINT_VERSION);
+		return FAILURE;
+	}
+	for (int i=0; i<NUM_CKPT_SECTIONS; i++) {
+		const Checkpoint_Section* section = &header->sections[i];
+		if ((section->offset % CHECKPOINT_ALIGN != 0)||(section->offset > file_size)||(section->size > file_size - section->offset)) {
+			fprintf(stderr, "APEX_Checkpoint : %s is truncated\n", filename);
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+
+int get_checkpoint_config(const char* filename, APEX_Config* config) {
+	size_t file_size = 0;
+	const unsigned char* data = map_checkpoint(filename, &file_size);
+	if (!data) {
+		return FAILURE;
+	}
+	const Checkpoint_Header* header = (const Checkpoint_Header*)data;
+	int ret = check_checkpoint_header(header, file_size, filename);
+	if (ret == SUCCESS) {
+		*config = header->config;
+	}
+	munmap((void*)data, file_size);
+	return ret;
+}
+
+
+int load_checkpoint(const char* filename, Checkpoint_State* state) {
+	// same config restores everything, other configs only take arch state and need a checkpoint with nothing in flight
+	size_t file_size = 0;
+	const unsigned char* data = map_checkpoint(filename, &file_size);
+	if (!data) {
+		return FAILURE;
+	}
+	const Checkpoint_Header* header = (const Checkpoint_Header*)data;
+	Checkpoint_Header expected;
+	memset(&expected, 0, sizeof(expected));
+	set_section_table(&expected, state);
+	int same_config = (memcmp(&header->config, state->config, sizeof(APEX_Config)) == 0);
+
+	int ret = check_checkpoint_header(header, file_size, filename);
+	if ((ret == SUCCESS)&&((header->code_size != (uint32_t)state->cpu->code_memory_size)||(header->code_hash != get_code_hash(state->cpu)))) {
+		fprintf(stderr, "APEX_Checkpoint : %s was saved running another program\n", filename);
+		ret = FAILURE;
+	}
+	if ((ret == SUCCESS)&&(!same_config)&&(!header->pipeline_empty)) {
+		fprintf(stderr, "APEX_Checkpoint : %s has inst in flight, it only restores onto the config it was saved with\n", filename);
+		ret = FAILURE;
+	}
+	for (int i=0; (i<NUM_CKPT_SECTIONS)&&(ret==SUCCESS); i++) {
+		if ((same_config||(i==CKPT_MACHINE))&&(header->sections[i].size != expected.sections[i].size)) {
+			fprintf(stderr, "APEX_Checkpoint : %s section %d has %llu bytes, expected %llu\n", filename, i, (unsigned long long)header->sections[i].size, (unsigned long long)expected.sections[i].size);
+			ret = FAILURE;
+		}
+	}
+
+	Checkpoint_Machine* machine = (ret == SUCCESS) ? apex_malloc(sizeof(*machine)) : NULL;
+	if (machine) {
+		memcpy(machine, data + header->sections[CKPT_MACHINE].offset, sizeof(*machine));
+		if (!same_config) {
+			// timing counters belong to the config the checkpoint was saved with
+			set_arch_state(machine, state->cpu);
+		}
+		else if (check_machine_state(machine, state) != SUCCESS) {
+			fprintf(stderr, "APEX_Checkpoint : %s has out of range queue pointers\n", filename);
+			ret = FAILURE;
+		}
+		else {
+			for (int i=CKPT_MACHINE+1; i<NUM_CKPT_SECTIONS; i++) {
+				memcpy(get_section_data(state, machine, i), data + header->sections[i].offset, header->sections[i].size);
+			}
+			set_machine_state(machine, state);
+		}
+		if (ret == SUCCESS) {
+			state->halted = header->halted;
+		}
+		free(machine);
+	}
+	else {
+		ret = FAILURE;
+	}
+	munmap((void*)data, file_size);
+	return ret;
+}
@@ -0,0 +1,98 @@
+#ifndef _APEX_CHECKPOINT_H_
+#define _APEX_CHECKPOINT_H_
+/*
+ *  checkpoint.h
+ *  Contains APEX checkpoint, complete machine state saved to and restored from a binary file
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+/* File starts with this magic, version changes whenever a section layout changes */
+#define CHECKPOINT_MAGIC "APEXCKPT"
+#define CHECKPOINT_VERSION 4
+#define CHECKPOINT_BYTE_ORDER 0x01020304u
+// every section starts at a multiple of this, so a mapped file can be used in place
+#define CHECKPOINT_ALIGN 64
+
+// sections of a checkpoint file, in file order
+enum {
+	CKPT_MACHINE,
+	CKPT_RESULT_QUEUE,
+	CKPT_ROB_ENTRIES,
+	CKPT_RENAME_ENTRIES,
+	CKPT_FREE_LIST,
+	CKPT_IQ_ENTRIES,
+	CKPT_IQ_MASKS,
+	CKPT_LSQ_ENTRIES,
+	NUM_CKPT_SECTIONS
+};
+
+typedef struct Checkpoint_Section {
+	uint64_t offset;			// from start of file
+	uint64_t size;				// bytes, without padding
+} Checkpoint_Section;
+
+/* Fixed size header at offset 0 */
+typedef struct Checkpoint_Header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;		// CHECKPOINT_BYTE_ORDER as written by the saving machine
+	uint32_t header_size;
+	uint32_t pipeline_empty;		// no inst in flight, arch state alone is the whole machine state
+	uint32_t halted;
+	uint32_t code_size;			// inst in code memory
+	uint64_t code_hash;			// FNV-1a of code memory, checkpoint only restores onto the same program
+	APEX_Config config;
+	Checkpoint_Section sections[NUM_CKPT_SECTIONS];
+} Checkpoint_Header;
+
+/* Scalars and fixed size arrays of CPU, ROB, rename table and LSQ, pointers are never saved */
+typedef struct Checkpoint_Machine {
+	long long clock;
+	int pc;
+	int regs[REGISTER_FILE_SIZE];
+	int regs_invalid[REGISTER_FILE_SIZE];
+	CPU_Stage stage[NUM_STAGES][MAX_WIDTH];
+	int flags[NUM_FLAG];
+	int data_memory[DATA_MEMORY_SIZE];
+	long long ins_completed;
+	int result_head;
+	int result_count;
+	int zf_tag;
+	int zf_value;
+	long long stall_cycles[NUM_STALL];
+	int cycle_stalls;
+	int rob_commit_ptr;
+	int rob_issue_ptr;
+	int rob_buffer_length;
+	int rat_rename[REGISTER_FILE_SIZE];
+	int rename_free_head;
+	int rename_free_count;
+	unsigned int lsq_next_seq;
+	long long functional_ins_completed;
+	uint64_t cycle_heap_allocs;
+} Checkpoint_Machine;
+
+/* Structures of one machine, as owned by an APEX_Sim */
+typedef struct Checkpoint_State {
+	APEX_CPU* cpu;
+	APEX_LSQ* ls_queue;
+	APEX_IQ* issue_queue;
+	APEX_ROB* rob;
+	APEX_RENAME* rename_table;
+	const APEX_Config* config;
+	int halted;
+} Checkpoint_State;
+
+
+int save_checkpoint(const char* filename, const Checkpoint_State* state, int pipeline_empty);
+int load_checkpoint(const char* filename, Checkpoint_State* state);
+int get_checkpoint_config(const char* filename, APEX_Config* config);
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ *  config.c
+ *  Contains APEX run time configuration of structure sizes and pipeline widths
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stddef.h>
+#include <limits.h>
+
+#include "cpu.h"
+#include "config.h"
+
+/*
+ * ########################################## Config Keys ##########################################
+*/
+
+/* keys accepted in config file and as --<key>=<value> */
+static const struct {
+	const char* key;
+	size_t offset;
+	const char* help;
+} config_keys[] = {
+	{"rob_size", offsetof(APEX_Config, rob_size), "ROB entries"},
+	{"iq_size", offsetof(APEX_Config, iq_size), "IQ entries"},
+	{"lsq_size", offsetof(APEX_Config, lsq_size), "LSQ entries"},
+	{"rename_table_size", offsetof(APEX_Config, rename_table_size), "physical registers"},
+	{"fetch_width", offsetof(APEX_Config, fetch_width), "inst fetched and decoded per cycle"},
+	{"dispatch_width", offsetof(APEX_Config, dispatch_width), "inst dispatched per cycle"},
+	{"issue_width", offsetof(APEX_Config, issue_width), "inst issued from IQ per cycle"},
+	{"commit_width", offsetof(APEX_Config, commit_width), "inst committed per cycle"},
+	{"int_fu_count", offsetof(APEX_Config, int_fu_count), "Int FU pipelines"},
+	{"mul_fu_count", offsetof(APEX_Config, mul_fu_count), "Mul FU pipelines"},
+	{"result_bus_count", offsetof(APEX_Config, result_bus_count), "results broadcast per cycle"},
+	{"mem_latency", offsetof(APEX_Config, mem_latency), "cycles a LOAD/STORE spends in Mem FU"},
+};
+
+#define NUM_CONFIG_KEYS ((int)(sizeof(config_keys)/sizeof(config_keys[0])))
+
+
+static void set_pipeline_width(APEX_Config* config, int width) {
+	// same defaults as -DPIPELINE_WIDTH=<width>
+	config->fetch_width = width;
+	config->dispatch_width = width;
+	config->commit_width = width;
+	config->int_fu_count = width;
+	config->mul_fu_count = (width + 1) / 2;
+	config->issue_width = config->int_fu_count + config->mul_fu_count + 1;
+	config->result_bus_count = config->int_fu_count + config->mul_fu_count + 1;
+}
+
+
+void init_default_config(APEX_Config* config) {
+	config->rob_size = ROB_SIZE;
+	config->iq_size = IQ_SIZE;
+	config->lsq_size = LSQ_SIZE;
+	config->rename_table_size = RENAME_TABLE_SIZE;
+	config->fetch_width = FETCH_WIDTH;
+	config->dispatch_width = DISPATCH_WIDTH;
+	config->issue_width = ISSUE_WIDTH;
+	config->commit_width = COMMIT_WIDTH;
+	config->int_fu_count = INT_FU_COUNT;
+	config->mul_fu_count = MUL_FU_COUNT;
+	config->result_bus_count = RESULT_BUS_COUNT;
+	config->mem_latency = MEM_LATENCY;
+}
+
+
+static int get_config_int(const char* value, int* number) {
+	// whole value must be a number
+	char* end = NULL;
+	long parsed = strtol(value, &end, 10);
+	if ((end == value)||(*end != '\0')||(parsed < INT_MIN)||(parsed > INT_MAX)) {
+		return FAILURE;
+	}
+	*number = (int)parsed;
+	return SUCCESS;
+}
+
+
+int set_config_value(APEX_Config* config, const char* key, const char* value) {
+	int number = 0;
+	if (get_config_int(value, &number) != SUCCESS) {
+		fprintf(stderr, "APEX_Config : Value '%s' of %s is not a number\n", value, key);
+		return FAILURE;
+	}
+	if (strcmp(key, "pipeline_width") == 0) {
+		set_pipeline_width(config, number);
+		return SUCCESS;
+	}
+	for (int i=0; i<NUM_CONFIG_KEYS; i++) {
+		if (strcmp(key, config_keys[i].key) == 0) {
+			*(int*)((char*)config + config_keys[i].offset) = number;
+			return SUCCESS;
+		}
+	}
+	fprintf(stderr, "APEX_Config : Unknown key '%s'\n", key);
+	return FAILURE;
+}
+
+
+int get_config_value(const APEX_Config* config, const char* key, int* value) {
+	for (int i=0; i<NUM_CONFIG_KEYS; i++) {
+		if (strcmp(key, config_keys[i].key) == 0) {
+			*value = *(const int*)((const char*)config + config_keys[i].offset);
+			return SUCCESS;
+		}
+	}
+	return FAILURE;
+}
+
+
+const char* get_config_key(int index) {
+	// keys in table order, NULL past the last one
+	if ((index < 0)||(index >= NUM_CONFIG_KEYS)) {
+		return NULL;
+	}
+	return config_keys[index].key;
+}
+
+
+static char* trim_config_text(char* text) {
+	while (isspace((unsigned char)*text)) {
+		text++;
+	}
+	char* end = text + strlen(text);
+	while ((end > text)&&(isspace((unsigned char)end[-1]))) {
+		end--;
+	}
+	*end = '\0';
+	return text;
+}
+
+
+/*
+ * ########################################## Config File ##########################################
+*/
+
+int read_config_file(APEX_Config* config, const char* filename) {
+	// one "key = value" per line, # starts a comment
+	FILE* fp = fopen(filename, "r");
+	if (!fp) {
+		fprintf(stderr, "APEX_Config : Unable to open config file %s\n", filename);
+		return FAILURE;
+	}
+
+	int ret = SUCCESS;
+	int line_number = 0;
+	char line[256];
+	while (fgets(line, sizeof(line), fp)) {
+		line_number++;
+		char* comment = strchr(line, '#');
+		if (comment) {
+			*comment = '\0';
+		}
+		char* text = trim_config_text(line);
+		if (*text == '\0') {
+			continue;
+		}
+		char* equal = strchr(text, '=');
+		if (!equal) {
+			fprintf(stderr, "APEX_Config : %s:%d expected key = value\n", filename, line_number);
+			ret = FAILURE;
+			break;
+		}
+		*equal = '\0';
+		if (set_config_value(config, trim_config_text(text), trim_config_text(equal + 1)) != SUCCESS) {
+			fprintf(stderr, "APEX_Config : in %s:%d\n", filename, line_number);
+			ret = FAILURE;
+			break;
+		}
+	}
+
+	fclose(fp);
+	return ret;
+}
+
+
+int parse_config_option(APEX_Config* config, const char* option) {
+	// --config=<file> or --<key>=<value>, applied in command line order
+	char key[64];
+	const char* equal = strchr(option, '=');
+	if ((strncmp(option, "--", 2) != 0)||(!equal)||((size_t)(equal - option - 2) >= sizeof(key))) {
+		fprintf(stderr, "APEX_Config : Invalid option '%s'\n", option);
+		return FAILURE;
+	}
+	memcpy(key, option + 2, equal - option - 2);
+	key[equal - option - 2] = '\0';
+	if (strcmp(key, "config") == 0) {
+		return read_config_file(config, equal + 1);
+	}
+	return set_config_value(config, key, equal + 1);
+}
+
+
+int check_config(const APEX_Config* config) {
+	// every size and width needs at least one entry, lane based widths are limited by latch lanes
+	int ret = SUCCESS;
+	for (int i=0; i<NUM_CONFIG_KEYS; i++) {
+		int number = *(const int*)((const char*)config + config_keys[i].offset);
+		if (number < 1) {
+			fprintf(stderr, "APEX_Config : %s must be at least 1, got %d\n", config_keys[i].key, number);
+			ret = FAILURE;
+		}
+	}
+	const int lane_widths[] = {config->fetch_width, config->int_fu_count, config->mul_fu_count};
+	const char* lane_keys[] = {"fetch_width", "int_fu_count", "mul_fu_count"};
+	for (int i=0; i<(int)(sizeof(lane_widths)/sizeof(lane_widths[0])); i++) {
+		if (lane_widths[i] > MAX_WIDTH) {
+			fprintf(stderr, "APEX_Config : %s can be at most MAX_WIDTH %d, got %d\n", lane_keys[i], MAX_WIDTH, lane_widths[i]);
+			ret = FAILURE;
+		}
+	}
+	return ret;
+}
+
+
+void print_config_keys() {
+	fprintf(stderr, "APEX_Help : Config keys, as --<key>=<value> or key = value lines in --config=<file>\n");
+	fprintf(stderr, "  %-20s %s\n", "pipeline_width", "sets fetch, dispatch, commit width and FU counts together");
+	for (int i=0; i<NUM_CONFIG_KEYS; i++) {
+		fprintf(stderr, "  %-20s %s\n", config_keys[i].key, config_keys[i].help);
+	}
+}
@@ -0,0 +1,41 @@
+#ifndef _APEX_CONFIG_H_
+#define _APEX_CONFIG_H_
+/*
+ *  config.h
+ *  Contains APEX run time configuration of structure sizes and pipeline widths
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+/* Functions exported from libapex, everything else stays hidden in the shared library */
+#define APEX_API __attribute__((visibility("default")))
+
+/* Sizes and widths of one design point, defaults come from the compile time macros */
+typedef struct APEX_Config {
+	int rob_size;				// ROB entries
+	int iq_size;				// IQ entries
+	int lsq_size;				// LSQ entries
+	int rename_table_size;		// physical registers
+	int fetch_width;			// inst fetched and decoded per cycle
+	int dispatch_width;		// inst dispatched per cycle
+	int issue_width;			// inst issued from IQ per cycle
+	int commit_width;			// inst committed per cycle
+	int int_fu_count;			// Int FU pipelines
+	int mul_fu_count;			// Mul FU pipelines
+	int result_bus_count;		// results broadcast per cycle
+	int mem_latency;			// cycles a LOAD/STORE spends in Mem FU
+} APEX_Config;
+
+
+APEX_API void init_default_config(APEX_Config* config);
+APEX_API int set_config_value(APEX_Config* config, const char* key, const char* value);
+APEX_API int read_config_file(APEX_Config* config, const char* filename);
+APEX_API int parse_config_option(APEX_Config* config, const char* option);
+APEX_API int get_config_value(const APEX_Config* config, const char* key, int* value);
+APEX_API const char* get_config_key(int index);
+APEX_API int check_config(const APEX_Config* config);
+APEX_API void print_config_keys();
+
+#endif
@@ -13,19 +13,33 @@
 
 #include "cpu.h"
 #include "forwarding.h"
+#include "checker.h"
 
 
 /*
  * ########################################## Initialize CPU ##########################################
  */
 
-APEX_CPU* APEX_cpu_init(const char* filename) {
-	// This function creates and initializes APEX cpu.
-	if (!filename) {
+static int get_lane_count(int width) {
+	// keep widths and FU counts within the lanes of a stage latch
+	if (width < 1) {
+		return 1;
+	}
+	if (width > MAX_WIDTH) {
+		fprintf(stderr, "APEX_CPU : Width %d larger than MAX_WIDTH, using %d\n", width, MAX_WIDTH);
+		return MAX_WIDTH;
+	}
+	return width;
+}
+
+APEX_CPU* APEX_cpu_init_from_code(const APEX_Instruction* code_memory, int code_memory_size, int verbose, const APEX_Config* config) {
+	// This function creates and initializes APEX cpu running already parsed code memory.
+	// code memory is only read, caller keeps it alive till the cpu is stopped
+	if ((!code_memory)||(!config)) {
 		return NULL;
 	}
 	// memory allocation of struct APEX_CPU to struct pointer cpu
-	APEX_CPU* cpu = malloc(sizeof(*cpu));
+	APEX_CPU* cpu = apex_malloc(sizeof(*cpu));
 	if (!cpu) {
 		return NULL;
 	}
@@ -34,43 +48,106 @@ APEX_CPU* APEX_cpu_init(const char* filename) {
 	cpu->pc = 4000;
 	memset(cpu->regs, 0, sizeof(int) * REGISTER_FILE_SIZE);  // fill a block of memory with a particular value here value is 0 for 32 regs with size 4 Bytes
 	memset(cpu->regs_invalid, 0, sizeof(int) * REGISTER_FILE_SIZE);  // all registers are valid at start, set to value 1
-	memset(cpu->stage, 0, sizeof(CPU_Stage) * NUM_STAGES); // all values in stage struct of type CPU_Stage like pc, rs1, etc are set to 0
+	memset(cpu->stage, 0, sizeof(CPU_Stage) * NUM_STAGES * MAX_WIDTH); // all values in stage struct of type CPU_Stage like pc, rs1, etc are set to 0
 	memset(cpu->data_memory, 0, sizeof(int) * DATA_MEMORY_SIZE); // from 4000 to 4095 there will be garbage values in data_memory array
 	memset(cpu->flags, 0, sizeof(int) * NUM_FLAG); // all flag values in cpu are set to 0
-
-	/* Parse input file and create code memory */
-	cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
-
-	if (!cpu->code_memory) {
-		free(cpu); // If code_memory is not created free the memory for cpu struct
+	cpu->clock = 0;
+	cpu->ins_completed = 0;
+	cpu->functional_ins_completed = 0;
+	cpu->verbose = verbose;
+	cpu->result_head = 0;
+	cpu->result_count = 0;
+	cpu->zf_tag = -1;
+	cpu->zf_value = 1; // ZF starts clear
+	cpu->mem_latency = (config->mem_latency < 1) ? 1 : config->mem_latency;
+	cpu->fetch_stopped = 0;
+	cpu->ins_limit = 0;
+	memset(cpu->stall_cycles, 0, sizeof(cpu->stall_cycles));
+	cpu->cycle_stalls = 0;
+	cpu->cycle_heap_allocs = 0;
+	cpu->checker = NULL;
+
+	/* Pipeline widths, lanes beyond MAX_WIDTH do not exist */
+	cpu->fetch_width = get_lane_count(config->fetch_width);
+	cpu->dispatch_width = get_lane_count(config->dispatch_width);
+	cpu->commit_width = get_lane_count(config->commit_width);
+	cpu->int_units = get_lane_count(config->int_fu_count);
+	cpu->mul_units = get_lane_count(config->mul_fu_count);
+	cpu->issue_width = (config->issue_width < 1) ? 1 : config->issue_width;
+	cpu->result_buses = (config->result_bus_count < 1) ? 1 : config->result_bus_count;
+
+	/* Results wait for a bus at most one per ROB entry */
+	cpu->result_queue_size = (config->rob_size < 1) ? 1 : config->rob_size;
+	cpu->result_queue = apex_malloc(sizeof(CPU_Stage) * cpu->result_queue_size);
+	if (!cpu->result_queue) {
+		free(cpu);
 		return NULL;
 	}
+
+	cpu->code_memory = code_memory;
+	cpu->code_memory_size = code_memory_size;
+	cpu->owns_code_memory = 0;
 	// Below code just prints the instructions and operands before execution
-	if (ENABLE_DEBUG_MESSAGES) {
+	if (DEBUG_MESSAGES(cpu)) {
 		fprintf(stderr,"APEX_CPU : Initialized APEX CPU, loaded %d instructions\n", cpu->code_memory_size);
 		fprintf(stderr, "APEX_CPU : Printing Code Memory\n");
 		printf("%-9s %-9s %-9s %-9s %-9s\n", "opcode", "rd", "rs1", "rs2", "imm");
 
 		for (int i = 0; i < cpu->code_memory_size; ++i) {
-			printf("%-9s %-9d %-9d %-9d %-9d\n", cpu->code_memory[i].opcode, cpu->code_memory[i].rd, cpu->code_memory[i].rs1, cpu->code_memory[i].rs2, cpu->code_memory[i].imm);
+			printf("%-9s %-9d %-9d %-9d %-9d\n", get_inst_name(cpu->code_memory[i].type), cpu->code_memory[i].rd, cpu->code_memory[i].rs1, cpu->code_memory[i].rs2, cpu->code_memory[i].imm);
 		}
 	}
 
 	/* Make all stages busy except Fetch stage, initally to start the pipeline */
 	for (int i = 0; i < NUM_STAGES; i++) {
-		cpu->stage[i].empty = 1;
+		for (int lane = 0; lane < MAX_WIDTH; lane++) {
+			cpu->stage[i][lane].empty = 1;
+		}
 	}
 
 	return cpu;
 }
 
+
+APEX_CPU* APEX_cpu_init(const char* filename, int verbose, const APEX_Config* config) {
+	// This function creates and initializes APEX cpu.
+	if ((!filename)||(!config)) {
+		return NULL;
+	}
+	/* Parse input file and create code memory */
+	int code_memory_size = 0;
+	int* data_memory = NULL;
+	int data_memory_size = 0;
+	APEX_Instruction* code_memory = create_code_memory(filename, &code_memory_size, &data_memory, &data_memory_size);
+	if (!code_memory) {
+		return NULL;
+	}
+	APEX_CPU* cpu = APEX_cpu_init_from_code(code_memory, code_memory_size, verbose, config);
+	if (!cpu) {
+		free(code_memory); // If cpu is not created free the code memory
+		free(data_memory);
+		return NULL;
+	}
+	cpu->owns_code_memory = 1;
+	if (data_memory_size > 0) {
+		// .data section of the file from address 0
+		memcpy(cpu->data_memory, data_memory, sizeof(int) * data_memory_size);
+	}
+	free(data_memory);
+	return cpu;
+}
+
 /*
  * ########################################## Stop CPU ##########################################
  */
 
 void APEX_cpu_stop(APEX_CPU* cpu) {
 	// This function de-allocates APEX cpu.
-	free(cpu->code_memory);
+	if (cpu->owns_code_memory) {
+		free((void*)cpu->code_memory);
+	}
+	deinit_checker(cpu->checker);
+	free(cpu->result_queue);
 	free(cpu);
 }
 
@@ -80,6 +157,16 @@ int get_code_index(int pc) {
 	return (pc - 4000) / 4;
 }
 
+static const APEX_Instruction* get_code_instruction(APEX_CPU* cpu, int pc) {
+	// Returns the instruction at pc, or an empty instruction once pc runs past code memory
+	static const APEX_Instruction empty_instruction;
+	int code_index = get_code_index(pc);
+	if ((code_index < 0)||(code_index >= cpu->code_memory_size)) {
+		return &empty_instruction;
+	}
+	return &cpu->code_memory[code_index];
+}
+
 
 /*
  * ########################################## Print Stage ##########################################
@@ -89,32 +176,32 @@ static void print_instruction(CPU_Stage* stage) {
 	switch (stage->inst_type) {
 
 		case STORE: case LOAD: case ADDL: case SUBL:
-			printf("%s,R%d,R%d,#%d ", stage->opcode, stage->rd, stage->rs1, stage->buffer);
+			printf("%s,R%d,R%d,#%d ", get_inst_name(stage->inst_type), stage->rd, stage->rs1, stage->buffer);
 			break;
 
 		case STR: case LDR: case ADD: case SUB:case MUL: case DIV: case AND: case OR: case EXOR:
-			printf("%s,R%d,R%d,R%d ", stage->opcode, stage->rd, stage->rs1, stage->rs2);
+			printf("%s,R%d,R%d,R%d ", get_inst_name(stage->inst_type), stage->rd, stage->rs1, stage->rs2);
 			break;
 
 		case MOVC: case JUMP:
-			printf("%s,R%d,#%d ", stage->opcode, stage->rd, stage->buffer);
+			printf("%s,R%d,#%d ", get_inst_name(stage->inst_type), stage->rd, stage->buffer);
 			break;
 
 		case MOV:
-			printf("%s,R%d,R%d ", stage->opcode, stage->rd, stage->rs1);
+			printf("%s,R%d,R%d ", get_inst_name(stage->inst_type), stage->rd, stage->rs1);
 			break;
 
 		case BZ: case BNZ:
-			printf("%s,#%d ", stage->opcode, stage->buffer);
+			printf("%s,#%d ", get_inst_name(stage->inst_type), stage->buffer);
 			break;
 
 		case HALT: case NOP:
-			printf("%s ", stage->opcode);
+			printf("%s ", get_inst_name(stage->inst_type));
 			break;
 
 		default:
 			if (!stage->empty) {
-				printf("<<- %s ->>", stage->opcode);
+				printf("<<- %s ->>", get_inst_name(stage->inst_type));
 			}
 			break;
 	}
@@ -166,13 +253,46 @@ void print_cpu_content(APEX_CPU* cpu) {
 }
 
 
+void print_run_summary(APEX_CPU* cpu, double seconds) {
+	// Print function which prints the final summary of a run, used by batch mode
+	// timing lines are left out when only functional mode ran
+	int timed = (cpu->clock > 0)||(cpu->functional_ins_completed == 0);
+	printf("\n============ SIMULATION SUMMARY ============\n");
+	if (timed) {
+		printf("Cycles:         %lld\n", cpu->clock);
+		printf("Instructions:   %lld\n", cpu->ins_completed);
+		if (cpu->clock > 0) {
+			printf("IPC:            %.4f\n", (double)cpu->ins_completed / cpu->clock);
+		}
+		printf("Stall Cycles:   ROB %lld, IQ %lld, LSQ %lld, Rename %lld, Result Bus %lld\n", cpu->stall_cycles[STALL_ROB_FULL], cpu->stall_cycles[STALL_IQ_FULL], cpu->stall_cycles[STALL_LSQ_FULL], cpu->stall_cycles[STALL_RENAME], cpu->stall_cycles[STALL_RESULT_BUS]);
+		printf("Heap Allocs:    %lu in cycle loop\n", cpu->cycle_heap_allocs);
+		if (cpu->checker) {
+			printf("Checked Ins:    %lld%s\n", cpu->checker->checked, (cpu->checker->diverged) ? ", diverged" : ", all matched");
+		}
+	}
+	if (cpu->functional_ins_completed > 0) {
+		printf("Functional Ins: %lld\n", cpu->functional_ins_completed);
+	}
+	printf("Wall Time:      %.6f s\n", seconds);
+	if (seconds > 0) {
+		if (timed) {
+			printf("Cycles/Second:  %.0f\n", cpu->clock / seconds);
+		}
+		if (!timed) {
+			printf("Func Ins/Sec:   %.0f\n", cpu->functional_ins_completed / seconds);
+		}
+	}
+}
+
+
 /*
  * ########################################## Regs Status Stage ##########################################
 */
 void set_arch_reg_status(APEX_CPU* cpu, APEX_RENAME* rename_table, int reg_number, int status) {
 	// Set Reg Status function
 	// NOTE: instead of set inc or dec regs_invalid
-	if (reg_number > REGISTER_FILE_SIZE) {
+	// reg_number is a phys reg tag, there are rename_table->size of them and it can be more than REGISTER_FILE_SIZE
+	if ((reg_number < 0)||(reg_number >= rename_table->size)) {
 		// Segmentation fault
 		fprintf(stderr, "Segmentation fault for Register location :: %d\n", reg_number);
 	}
@@ -194,61 +314,48 @@ void set_arch_reg_status(APEX_CPU* cpu, APEX_RENAME* rename_table, int reg_numbe
 */
 int fetch(APEX_CPU* cpu) {
 
-	CPU_Stage* stage = &cpu->stage[F];
-	stage->executed = 0;
+	CPU_Stage* group = cpu->stage[F];
 
-	if (!stage->stalled) {
-		/* Store current PC in fetch latch */
-		stage->pc = cpu->pc;
-
-		/* Index into code memory using this pc and copy all instruction fields into fetch latch */
-		APEX_Instruction* current_ins = &cpu->code_memory[get_code_index(cpu->pc)];
-		strcpy(stage->opcode, current_ins->opcode);
-		stage->rd = current_ins->rd;
-		stage->rd_valid = 0;
-		stage->rs1 = current_ins->rs1;
-		stage->rs1_valid = 0;
-		stage->rs2 = current_ins->rs2;
-		stage->rs2_valid = 0;
-		stage->imm = current_ins->imm;
-		stage->buffer = current_ins->imm;
-		stage->inst_type = current_ins->type;
-
-		/* Copy data from Fetch latch to Decode latch*/
-		stage->executed = 1;
-		// cpu->stage[DRF] = cpu->stage[F]; // this is cool I should empty the fetch stage as well to avoid repetition ?
-		// cpu->stage[DRF].executed = 0;
-		if (stage->inst_type == 0) {
-			// stop fetching Instructions, exit from writeback stage
-			stage->stalled = 0;
-			stage->empty = 1;
-		}
-		else {
-			/* Update PC for next instruction */
-			cpu->pc += 4;
-			stage->empty = 0;
-		}
-	}
-	else {
-		//If Fetch has HALT and Decode has HALT fetch only one Inst
-		if (cpu->stage[DRF].inst_type == HALT) {
-			// just fetch the next instruction
+	// fetch group is refilled only after it moved to DRF
+	if ((!group[0].stalled)&&(group[0].empty)&&(!cpu->fetch_stopped)) {
+		for (int lane=0; lane<cpu->fetch_width; lane++) {
+			CPU_Stage* stage = &group[lane];
+			stage->executed = 0;
+
+			/* Store current PC in fetch latch */
 			stage->pc = cpu->pc;
-			APEX_Instruction* current_ins = &cpu->code_memory[get_code_index(cpu->pc)];
-			strcpy(stage->opcode, current_ins->opcode);
+
+			/* Index into code memory using this pc and copy all instruction fields into fetch latch */
+			const APEX_Instruction* current_ins = get_code_instruction(cpu, cpu->pc);
 			stage->rd = current_ins->rd;
 			stage->rd_valid = 0;
 			stage->rs1 = current_ins->rs1;
 			stage->rs1_valid = 0;
 			stage->rs2 = current_ins->rs2;
 			stage->rs2_valid = 0;
-			stage->imm = current_ins->imm;
+			stage->buffer = current_ins->imm;
 			stage->inst_type = current_ins->type;
+
+			if (stage->inst_type == 0) {
+				// stop fetching Instructions, exit from writeback stage
+				stage->empty = 1;
+				break;
+			}
+			/* Update PC for next instruction */
+			cpu->pc += 4;
+			stage->executed = 1;
+			stage->empty = 0;
+			if ((stage->inst_type == HALT)||(stage->inst_type == BZ)||(stage->inst_type == BNZ)||(stage->inst_type == JUMP)) {
+				// nothing after HALT is fetched, fall through path of a branch waits for next group
+				break;
+			}
 		}
 	}
 
-	if (ENABLE_DEBUG_MESSAGES) {
-		print_stage_content("Fetch", stage);
+	if (DEBUG_MESSAGES(cpu)) {
+		for (int lane=0; lane<cpu->fetch_width; lane++) {
+			print_stage_content("Fetch", &group[lane]);
+		}
 	}
 
 	return 0;
@@ -257,25 +364,59 @@ int fetch(APEX_CPU* cpu) {
 /*
  * ########################################## Decode Stage ##########################################
 */
-int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
+static int has_desc_reg(int inst_type) {
+	// instructions which get a phys reg for rd at decode
+	switch (inst_type) {
+		case LOAD: case LDR: case MOVC: case MOV: case ADD: case ADDL: case SUB: case SUBL: case MUL: case DIV: case AND: case OR: case EXOR:
+			return VALID;
+		default:
+			return INVALID;
+	}
+}
+
+
+static int is_zf_producer(int inst_type) {
+	// instructions which set ZF from their result
+	switch (inst_type) {
+		case ADD: case ADDL: case SUB: case SUBL: case MUL: case DIV:
+			return VALID;
+		default:
+			return INVALID;
+	}
+}
+
+
+static int decode_lane(APEX_CPU* cpu, APEX_RENAME* rename_table, CPU_Stage* stage) {
 
-	CPU_Stage* stage = &cpu->stage[DRF];
 	stage->executed = 0;
 	int ret = -1;
-	// decode should stall if IQ is full
+	// without a free phys reg the inst waits in DRF and is decoded again next cycle
+	if ((has_desc_reg(stage->inst_type))&&(can_rename_reg_tag(rename_table)!=SUCCESS)) {
+		cpu->cycle_stalls |= (1 << STALL_RENAME);
+		if (DEBUG_MESSAGES_L2(cpu)) {
+			printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+		}
+		return FAILURE;
+	}
 	if (!stage->stalled) {
 		/* Read data from register file for store */
 		switch(stage->inst_type) {
 
 			case STORE:  // ************************************* STORE ************************************* //
 
-				stage->buffer = stage->imm; // keeping literal value in buffer to calculate mem add in exe stage
+				// literal value is kept in buffer by fetch to calculate mem add in exe stage
 				// check if src regs are renamed
 				if (check_if_reg_renamed(stage->rs1, rename_table)==SUCCESS) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -291,7 +432,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the desc reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rd), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rd);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rd);
+						}
+					}
+					else if (get_phy_reg_value(stage->rd, &(stage->rd_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rd_valid = VALID;
 					}
 				}
 				else {
@@ -311,7 +458,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -327,7 +480,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs2), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs2, &(stage->rs2_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs2_valid = VALID;
 					}
 				}
 				else {
@@ -343,7 +502,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the desc reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rd), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rd);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rd);
+						}
+					}
+					else if (get_phy_reg_value(stage->rd, &(stage->rd_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rd_valid = VALID;
 					}
 				}
 				else {
@@ -359,13 +524,19 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 
 			case LOAD:  // ************************************* LOAD ************************************* //
 				// read literal and register values
-				stage->buffer = stage->imm; // keeping literal value in buffer to calculate mem add in exe stage
+				// literal value is kept in buffer by fetch to calculate mem add in exe stage
 				// check if src regs are renamed
 				if (check_if_reg_renamed(stage->rs1, rename_table)==SUCCESS) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -381,11 +552,15 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// change the desc regs tag
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rd);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rd);
+						}
 					}
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
@@ -396,7 +571,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -412,7 +593,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs2), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs2, &(stage->rs2_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs2_valid = VALID;
 					}
 				}
 				else {
@@ -428,24 +615,30 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// change the desc regs tag
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rd);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rd);
+						}
 					}
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
 			case MOVC:  // ************************************* MOVC ************************************* //
 				// read literal values
-				stage->buffer = stage->imm; // keeping literal value in buffer to load in mem stage
+				// literal value is kept in buffer by fetch to load in mem stage
 				// check if renaming can be done
 				if (can_rename_reg_tag(rename_table)==SUCCESS) {
 					// change the desc regs tag
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
@@ -456,7 +649,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -473,7 +672,9 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
@@ -484,7 +685,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -500,7 +707,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs2), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs2, &(stage->rs2_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs2_valid = VALID;
 					}
 				}
 				else {
@@ -517,19 +730,27 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
 			case ADDL:  // ************************************* ADDL ************************************* //
 				// read only values of last two registers
-				stage->buffer = stage->imm; // keeping literal value in buffer to add in exe stage
+				// literal value is kept in buffer by fetch to add in exe stage
 				// check if src regs are renamed
 				if (check_if_reg_renamed(stage->rs1, rename_table)==SUCCESS) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -545,11 +766,15 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// change the desc regs tag
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rd);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rd);
+						}
 					}
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
@@ -560,7 +785,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -576,7 +807,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs2), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs2, &(stage->rs2_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs2_valid = VALID;
 					}
 				}
 				else {
@@ -593,19 +830,27 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
 			case SUBL:  // ************************************* SUBL ************************************* //
 				// read only values of last two registers
-				stage->buffer = stage->imm; // keeping literal value in buffer to add in exe stage
+				// literal value is kept in buffer by fetch to add in exe stage
 				// check if src regs are renamed
 				if (check_if_reg_renamed(stage->rs1, rename_table)==SUCCESS) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -622,7 +867,9 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
@@ -633,7 +880,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -649,7 +902,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs2), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs2, &(stage->rs2_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs2_valid = VALID;
 					}
 				}
 				else {
@@ -666,7 +925,9 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
@@ -677,7 +938,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -693,13 +960,19 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs2), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs2, &(stage->rs2_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs2_valid = VALID;
 					}
 				}
 				else {
 					// check arch reg if valid read from them
 					// here 0 is valid and any other number is invalid
-					if(get_reg_status(cpu, stage->rs1)==INVALID) {
+					if(get_reg_status(cpu, stage->rs2)==INVALID) {
 						stage->rs2_value = get_reg_values(cpu, stage->rs2);
 						stage->rs2_valid = VALID;
 					}
@@ -710,7 +983,9 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
@@ -721,7 +996,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -737,7 +1018,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs2), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs2, &(stage->rs2_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs2_valid = VALID;
 					}
 				}
 				else {
@@ -754,7 +1041,9 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
@@ -765,7 +1054,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -781,7 +1076,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs2), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs2, &(stage->rs2_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs2_valid = VALID;
 					}
 				}
 				else {
@@ -798,7 +1099,9 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
@@ -809,7 +1112,13 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
@@ -825,13 +1134,19 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs2), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs2);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs2, &(stage->rs2_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs2_valid = VALID;
 					}
 				}
 				else {
 					// check arch reg if valid read from them
 					// here 0 is valid and any other number is invalid
-					if(get_reg_status(cpu, stage->rs1)==INVALID) {
+					if(get_reg_status(cpu, stage->rs2)==INVALID) {
 						stage->rs2_value = get_reg_values(cpu, stage->rs2);
 						stage->rs2_valid = VALID;
 					}
@@ -842,37 +1157,53 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 					ret = rename_desc_reg(&(stage->rd), rename_table);
 				}
 				else {
-					printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, stage->opcode);
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						printf("Cannot Rename Register R%d of pc(%d) :: %s\n", stage->rd, stage->pc, get_inst_name(stage->inst_type));
+					}
 				}
 				break;
 
-			case BZ:  // ************************************* BZ ************************************* //
-				// read literal values
-				stage->buffer = stage->imm; // keeping literal value in buffer to jump in exe stage
-				break;
-
-			case BNZ:  // ************************************* BNZ ************************************* //
+			case BZ: case BNZ:  // ************************************* BZ or BNZ ************************************* //
 				// read literal values
-				stage->buffer = stage->imm; // keeping literal value in buffer to jump in exe stage
+				// literal value is kept in buffer by fetch to jump in exe stage
+				// ZF is read as rs1, the result of the youngest older inst which sets ZF
+				if (cpu->zf_tag>=0) {
+					stage->rs1 = cpu->zf_tag;
+					if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
+					}
+				}
+				else {
+					// producer committed, its result is kept by commit
+					stage->rs1_value = cpu->zf_value;
+					stage->rs1_valid = VALID;
+				}
 				break;
 
 			case JUMP:   // ************************************* JUMP ************************************* //
 				// read literal and register values
-				stage->buffer = stage->imm; // keeping literal value in buffer to calculate mem add in exe stage
+				// literal value is kept in buffer by fetch to calculate mem add in exe stage
 				// check if src regs are renamed
 				if (check_if_reg_renamed(stage->rs1, rename_table)==SUCCESS) {
 					// get the src reg renamed tag
 					ret = get_reg_renamed_tag(&(stage->rs1), rename_table);
 					if (ret!=SUCCESS) {
-						printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							printf("Failed to get renamed tag for R%d\n", stage->rs1);
+						}
+					}
+					else if (get_phy_reg_value(stage->rs1, &(stage->rs1_value), rename_table)==SUCCESS) {
+						// producer already wrote back, no need to wait for it in IQ
+						stage->rs1_valid = VALID;
 					}
 				}
 				else {
 					// check arch reg if valid read from them
 					// here 0 is valid and any other number is invalid
 					if(get_reg_status(cpu, stage->rs1)==INVALID) {
-						stage->rs2_value = get_reg_values(cpu, stage->rs2);
-						stage->rs2_valid = VALID;
+						stage->rs1_value = get_reg_values(cpu, stage->rs1);
+						stage->rs1_valid = VALID;
 					}
 				}
 				break;
@@ -880,7 +1211,7 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 			case HALT:  // ************************************* HALT ************************************* //
 				// Halt causes a type of Intrupt where Fetch is stalled and cpu intrupt Bit is Set
 				// Stop fetching new instruction but allow all the instruction to go from Decode Writeback
-				cpu->stage[F].stalled = 1; // add NOP from fetch stage
+				cpu->stage[F][0].stalled = 1; // add NOP from fetch stage
 				cpu->flags[IF] = 1; // Halt as Interrupt
 				break;
 
@@ -888,17 +1219,41 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 				break; // Nothing
 
 			default:
-				if (strcmp(stage->opcode, "") != 0) {
-					fprintf(stderr, "Decode/RF Invalid Instruction Found :: %s\n", stage->opcode);
+				if (stage->inst_type != INVALID) {
+					fprintf(stderr, "Decode/RF Invalid Instruction Found :: %s\n", get_inst_name(stage->inst_type));
 				}
 				break;
 		}
+		if (is_zf_producer(stage->inst_type)) {
+			// branches decoded after this read ZF from its desc phys reg
+			cpu->zf_tag = stage->rd;
+		}
 
 		stage->executed = 1;
 	}
 
-	if (ENABLE_DEBUG_MESSAGES) {
-		print_stage_content("Decode/RF", stage);
+	return SUCCESS;
+}
+
+
+int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
+
+	// rename in program order, an inst which can not be renamed holds back the ones after it
+	for (int lane=0; lane<cpu->fetch_width; lane++) {
+		CPU_Stage* stage = &cpu->stage[DRF][lane];
+		// executed lanes are decoded and waiting for dispatch
+		if ((stage->empty)||(stage->executed)) {
+			continue;
+		}
+		if (decode_lane(cpu, rename_table, stage)!=SUCCESS) {
+			break;
+		}
+	}
+
+	if (DEBUG_MESSAGES(cpu)) {
+		for (int lane=0; lane<cpu->fetch_width; lane++) {
+			print_stage_content("Decode/RF", &cpu->stage[DRF][lane]);
+		}
 	}
 
 	return 0;
@@ -909,38 +1264,40 @@ int decode(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 */
 int int_one_stage(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 
-	CPU_Stage* stage = &cpu->stage[INT_ONE];
-	stage->executed = 0;
-	if ((!stage->stalled)&&(!stage->empty)) {
-		/* Read data from register file for store */
-		switch(stage->inst_type) {
+	for (int lane=0; lane<cpu->int_units; lane++) {
+		CPU_Stage* stage = &cpu->stage[INT_ONE][lane];
+		stage->executed = 0;
+		if ((!stage->stalled)&&(!stage->empty)) {
+			/* Read data from register file for store */
+			switch(stage->inst_type) {
 
-			case STORE: case STR:  // ************************************* STORE or STR ************************************* //
-				break;
-			// ************************************* LOAD to EX-OR ************************************* //
-			case LOAD: case LDR: case MOVC: case MOV: case ADD: case ADDL: case SUB: case SUBL: case DIV: case AND: case OR: case EXOR:
-				// make desitination regs invalid count increment by one following instructions stall
-				set_arch_reg_status(cpu, rename_table, stage->rd, 1);
-				stage->rd_valid = INVALID;
-				break;
+				case STORE: case STR:  // ************************************* STORE or STR ************************************* //
+					break;
+				// ************************************* LOAD to EX-OR ************************************* //
+				case LOAD: case LDR: case MOVC: case MOV: case ADD: case ADDL: case SUB: case SUBL: case DIV: case AND: case OR: case EXOR:
+					// make desitination regs invalid count increment by one following instructions stall
+					set_arch_reg_status(cpu, rename_table, stage->rd, 1);
+					stage->rd_valid = INVALID;
+					break;
 
-			case JUMP:  // ************************************* JUMP ************************************* //
-				break;
+				case JUMP:  // ************************************* JUMP ************************************* //
+					break;
 
-			case HALT:  // ************************************* HALT ************************************* //
-				break;
+				case HALT:  // ************************************* HALT ************************************* //
+					break;
 
-			case NOP:  // ************************************* NOP ************************************* //
-				break;
+				case NOP:  // ************************************* NOP ************************************* //
+					break;
 
-			default:
-				break;
+				default:
+					break;
+			}
+			stage->executed = 1;
 		}
-		stage->executed = 1;
-	}
 
-	if (ENABLE_DEBUG_MESSAGES) {
-		print_stage_content("Int FU One", stage);
+		if (DEBUG_MESSAGES(cpu)) {
+			print_stage_content("Int FU One", stage);
+		}
 	}
 
 	return 0;
@@ -951,182 +1308,184 @@ int int_one_stage(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 */
 int int_two_stage(APEX_CPU* cpu) {
 
-	CPU_Stage* stage = &cpu->stage[INT_TWO];
-	stage->executed = 0;
-	if ((!stage->stalled)&&(!stage->empty)) {
-		/* Read data from register file for store */
-		switch(stage->inst_type) {
-
-			case STORE: case LOAD:  // ************************************* STORE or LOAD ************************************* //
-				// create memory address using literal and register values
-				stage->mem_address = stage->rs1_value + stage->buffer;
-				break;
-
-			case STR: case LDR: // ************************************* STR or LDR ************************************* //
-				// create memory address using two source register values
-				stage->mem_address = stage->rs1_value + stage->rs2_value;
-				break;
+	for (int lane=0; lane<cpu->int_units; lane++) {
+		CPU_Stage* stage = &cpu->stage[INT_TWO][lane];
+		stage->executed = 0;
+		if ((!stage->stalled)&&(!stage->empty)) {
+			/* Read data from register file for store */
+			switch(stage->inst_type) {
 
-			case MOVC:	// ************************************* MOVC ************************************* //
-				// move buffer value to rd_value so it can be forwarded
-				stage->rd_value = stage->buffer;
-				stage->rd_valid = VALID;
-				break;
+				case STORE: case LOAD:  // ************************************* STORE or LOAD ************************************* //
+					// create memory address using literal and register values
+					stage->mem_address = stage->rs1_value + stage->buffer;
+					break;
 
-			case MOV:	// ************************************* MOV ************************************* //
-				// move rs1_value value to rd_value so it can be forwarded
-				stage->rd_value = stage->rs1_value;
-				stage->rd_valid = VALID;
-				break;
+				case STR: case LDR: // ************************************* STR or LDR ************************************* //
+					// create memory address using two source register values
+					stage->mem_address = stage->rs1_value + stage->rs2_value;
+					break;
 
-			case ADD:	// ************************************* ADD ************************************* //
-				// add registers value and keep in rd_value for mem / writeback stage
-				if ((stage->rs2_value > 0 && stage->rs1_value > INT_MAX - stage->rs2_value) ||
-					(stage->rs2_value < 0 && stage->rs1_value < INT_MIN - stage->rs2_value)) {
-					if (ENABLE_DEBUG_MESSAGES_L2) {
-						fprintf(stderr, "Overflow Occurred\n");
-					}
+				case MOVC:	// ************************************* MOVC ************************************* //
+					// move buffer value to rd_value so it can be forwarded
+					stage->rd_value = stage->buffer;
 					stage->rd_valid = VALID;
-					cpu->flags[OF] = 1; // there is an overflow
-				}
-				else {
-					stage->rd_value = stage->rs1_value + stage->rs2_value;
+					break;
+
+				case MOV:	// ************************************* MOV ************************************* //
+					// move rs1_value value to rd_value so it can be forwarded
+					stage->rd_value = stage->rs1_value;
 					stage->rd_valid = VALID;
-					cpu->flags[OF] = 0; // there is no overflow
-					if (stage->rd_value == 0) {
-						cpu->flags[ZF] = 1; // computation resulted value zero
+					break;
+
+				case ADD:	// ************************************* ADD ************************************* //
+					// add registers value and keep in rd_value for mem / writeback stage
+					if ((stage->rs2_value > 0 && stage->rs1_value > INT_MAX - stage->rs2_value) ||
+						(stage->rs2_value < 0 && stage->rs1_value < INT_MIN - stage->rs2_value)) {
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							fprintf(stderr, "Overflow Occurred\n");
+						}
+						stage->rd_valid = VALID;
+						cpu->flags[OF] = 1; // there is an overflow
 					}
 					else {
-						cpu->flags[ZF] = 0; // computation did not resulted value zero
+						stage->rd_value = stage->rs1_value + stage->rs2_value;
+						stage->rd_valid = VALID;
+						cpu->flags[OF] = 0; // there is no overflow
+						if (stage->rd_value == 0) {
+							cpu->flags[ZF] = 1; // computation resulted value zero
+						}
+						else {
+							cpu->flags[ZF] = 0; // computation did not resulted value zero
+						}
 					}
-				}
-				break;
+					break;
 
-			case ADDL:	// ************************************* ADDL ************************************* //
-				// add literal and register value and keep in rd_value for mem / writeback stage
-				if ((stage->buffer > 0 && stage->rs1_value > INT_MAX - stage->buffer) ||
-					(stage->buffer < 0 && stage->rs1_value < INT_MIN - stage->buffer)) {
-					if (ENABLE_DEBUG_MESSAGES_L2) {
-						fprintf(stderr, "Overflow Occurred\n");
-					}
-					stage->rd_valid = VALID;
-					cpu->flags[OF] = 1; // there is an overflow
-				}
-				else {
-					stage->rd_value = stage->rs1_value + stage->buffer;
-					stage->rd_valid = VALID;
-					cpu->flags[OF] = 0; // there is no overflow
-					if (stage->rd_value == 0) {
-						cpu->flags[ZF] = 1; // computation resulted value zero
+				case ADDL:	// ************************************* ADDL ************************************* //
+					// add literal and register value and keep in rd_value for mem / writeback stage
+					if ((stage->buffer > 0 && stage->rs1_value > INT_MAX - stage->buffer) ||
+						(stage->buffer < 0 && stage->rs1_value < INT_MIN - stage->buffer)) {
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							fprintf(stderr, "Overflow Occurred\n");
+						}
+						stage->rd_valid = VALID;
+						cpu->flags[OF] = 1; // there is an overflow
 					}
 					else {
-						cpu->flags[ZF] = 0; // computation did not resulted value zero
-					}
-				}
-				break;
-
-			case SUB:	// ************************************* SUB ************************************* //
-				// sub registers value and keep in rd_value for mem / writeback stage
-				if (stage->rs2_value > stage->rs1_value) {
-					if (ENABLE_DEBUG_MESSAGES_L2) {
-						fprintf(stderr, "Carry Occurred\n");
+						stage->rd_value = stage->rs1_value + stage->buffer;
+						stage->rd_valid = VALID;
+						cpu->flags[OF] = 0; // there is no overflow
+						if (stage->rd_value == 0) {
+							cpu->flags[ZF] = 1; // computation resulted value zero
+						}
+						else {
+							cpu->flags[ZF] = 0; // computation did not resulted value zero
+						}
 					}
-					stage->rd_value = stage->rs1_value - stage->rs2_value;
-					stage->rd_valid = VALID;
-					cpu->flags[CF] = 1; // there is an carry
-				}
-				else {
-					stage->rd_value = stage->rs1_value - stage->rs2_value;
-					stage->rd_valid = VALID;
-					cpu->flags[CF] = 0; // there is no carry
-					if (stage->rd_value == 0) {
-						cpu->flags[ZF] = 1; // computation resulted value zero
+					break;
+
+				case SUB:	// ************************************* SUB ************************************* //
+					// sub registers value and keep in rd_value for mem / writeback stage
+					if (stage->rs2_value > stage->rs1_value) {
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							fprintf(stderr, "Carry Occurred\n");
+						}
+						stage->rd_value = stage->rs1_value - stage->rs2_value;
+						stage->rd_valid = VALID;
+						cpu->flags[CF] = 1; // there is an carry
 					}
 					else {
-						cpu->flags[ZF] = 0; // computation did not resulted value zero
+						stage->rd_value = stage->rs1_value - stage->rs2_value;
+						stage->rd_valid = VALID;
+						cpu->flags[CF] = 0; // there is no carry
+						if (stage->rd_value == 0) {
+							cpu->flags[ZF] = 1; // computation resulted value zero
+						}
+						else {
+							cpu->flags[ZF] = 0; // computation did not resulted value zero
+						}
 					}
-				}
-				break;
+					break;
 
-			case SUBL:	// ************************************* SUBL ************************************* //
-				// sub literal and register value and keep in rd_value for mem / writeback stage
-				if (stage->buffer > stage->rs1_value) {
-					if (ENABLE_DEBUG_MESSAGES_L2) {
-						fprintf(stderr, "Carry Occurred\n");
-					}
-					stage->rd_value = stage->rs1_value - stage->buffer;
-					stage->rd_valid = VALID;
-					cpu->flags[CF] = 1; // there is an carry
-				}
-				else {
-					stage->rd_value = stage->rs1_value - stage->buffer;
-					stage->rd_valid = VALID;
-					cpu->flags[CF] = 0; // there is no carry
-					if (stage->rd_value == 0) {
-						cpu->flags[ZF] = 1; // computation resulted value zero
+				case SUBL:	// ************************************* SUBL ************************************* //
+					// sub literal and register value and keep in rd_value for mem / writeback stage
+					if (stage->buffer > stage->rs1_value) {
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							fprintf(stderr, "Carry Occurred\n");
+						}
+						stage->rd_value = stage->rs1_value - stage->buffer;
+						stage->rd_valid = VALID;
+						cpu->flags[CF] = 1; // there is an carry
 					}
 					else {
-						cpu->flags[ZF] = 0; // computation did not resulted value zero
+						stage->rd_value = stage->rs1_value - stage->buffer;
+						stage->rd_valid = VALID;
+						cpu->flags[CF] = 0; // there is no carry
+						if (stage->rd_value == 0) {
+							cpu->flags[ZF] = 1; // computation resulted value zero
+						}
+						else {
+							cpu->flags[ZF] = 0; // computation did not resulted value zero
+						}
 					}
-				}
-				break;
+					break;
 
-			case DIV:	// ************************************* DIV ************************************* //
-				// div registers value and keep in rd_value for mem / writeback stage
-				if (stage->rs2_value != 0) {
-					stage->rd_value = stage->rs1_value / stage->rs2_value;
-					stage->rd_valid = VALID;
-					if (stage->rd_value == 0) {
-						cpu->flags[ZF] = 1; // computation resulted value zero
+				case DIV:	// ************************************* DIV ************************************* //
+					// div registers value and keep in rd_value for mem / writeback stage
+					if (stage->rs2_value != 0) {
+						stage->rd_value = stage->rs1_value / stage->rs2_value;
+						stage->rd_valid = VALID;
+						if (stage->rd_value == 0) {
+							cpu->flags[ZF] = 1; // computation resulted value zero
+						}
+						else {
+							cpu->flags[ZF] = 0; // computation did not resulted value zero
+						}
 					}
 					else {
-						cpu->flags[ZF] = 0; // computation did not resulted value zero
-					}
-				}
-				else {
-					if (ENABLE_DEBUG_MESSAGES_L2) {
-						fprintf(stderr, "Division By Zero Returning Value Zero\n");
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							fprintf(stderr, "Division By Zero Returning Value Zero\n");
+						}
+						stage->rd_value = 0;
+						stage->rd_valid = VALID;
 					}
-					stage->rd_value = 0;
-					stage->rd_valid = VALID;
-				}
-				break;
+					break;
 
-			case AND:	// ************************************* AND ************************************* //
-				// logical AND registers value and keep in rd_value for mem / writeback stage
-				stage->rd_value = stage->rs1_value & stage->rs2_value;
-				stage->rd_valid = VALID;
-				break;
+				case AND:	// ************************************* AND ************************************* //
+					// logical AND registers value and keep in rd_value for mem / writeback stage
+					stage->rd_value = stage->rs1_value & stage->rs2_value;
+					stage->rd_valid = VALID;
+					break;
 
-			case OR:	// ************************************* OR ************************************* //
-				// logical OR registers value and keep in rd_value for mem / writeback stage
-				stage->rd_value = stage->rs1_value | stage->rs2_value;
-				stage->rd_valid = VALID;
-				break;
+				case OR:	// ************************************* OR ************************************* //
+					// logical OR registers value and keep in rd_value for mem / writeback stage
+					stage->rd_value = stage->rs1_value | stage->rs2_value;
+					stage->rd_valid = VALID;
+					break;
 
-			case EXOR:	// ************************************* EX-OR ************************************* //
-				// logical OR registers value and keep in rd_value for mem / writeback stage
-				stage->rd_value = stage->rs1_value ^ stage->rs2_value;
-				stage->rd_valid = VALID;
-				break;
+				case EXOR:	// ************************************* EX-OR ************************************* //
+					// logical OR registers value and keep in rd_value for mem / writeback stage
+					stage->rd_value = stage->rs1_value ^ stage->rs2_value;
+					stage->rd_valid = VALID;
+					break;
 
-			case JUMP:  // ************************************* JUMP ************************************* //
-				break;
+				case JUMP:  // ************************************* JUMP ************************************* //
+					break;
 
-			case HALT:  // ************************************* HALT ************************************* //
-				break;
+				case HALT:  // ************************************* HALT ************************************* //
+					break;
 
-			case NOP:  // ************************************* NOP ************************************* //
-				break;
+				case NOP:  // ************************************* NOP ************************************* //
+					break;
 
-			default:
-				break;
+				default:
+					break;
+			}
+			stage->executed = 1;
 		}
-		stage->executed = 1;
-	}
 
-	if (ENABLE_DEBUG_MESSAGES) {
-		print_stage_content("Int FU Two", stage);
+		if (DEBUG_MESSAGES(cpu)) {
+			print_stage_content("Int FU Two", stage);
+		}
 	}
 
 	return 0;
@@ -1138,27 +1497,29 @@ int int_two_stage(APEX_CPU* cpu) {
 */
 int mul_one_stage(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 
-	CPU_Stage* stage = &cpu->stage[MUL_ONE];
-	stage->executed = 0;
-	if ((!stage->stalled)&&(!stage->empty)) {
-		/* Read data from register file for store */
-		switch(stage->inst_type) {
+	for (int lane=0; lane<cpu->mul_units; lane++) {
+		CPU_Stage* stage = &cpu->stage[MUL_ONE][lane];
+		stage->executed = 0;
+		if ((!stage->stalled)&&(!stage->empty)) {
+			/* Read data from register file for store */
+			switch(stage->inst_type) {
 
-			case MUL:  // ************************************* MUL ************************************* //
-				// mul registers value and keep in rd_value for mem / writeback stage
-				// if possible check y it requires 3 cycle
-				set_arch_reg_status(cpu, rename_table, stage->rd, 1);
-				stage->rd_valid = INVALID;
-				break;
+				case MUL:  // ************************************* MUL ************************************* //
+					// mul registers value and keep in rd_value for mem / writeback stage
+					// if possible check y it requires 3 cycle
+					set_arch_reg_status(cpu, rename_table, stage->rd, 1);
+					stage->rd_valid = INVALID;
+					break;
 
-			default:
-				break;
+				default:
+					break;
+			}
+			stage->executed = 1;
 		}
-		stage->executed = 1;
-	}
 
-	if (ENABLE_DEBUG_MESSAGES) {
-		print_stage_content("Mul FU One", stage);
+		if (DEBUG_MESSAGES(cpu)) {
+			print_stage_content("Mul FU One", stage);
+		}
 	}
 
 	return 0;
@@ -1170,27 +1531,29 @@ int mul_one_stage(APEX_CPU* cpu, APEX_RENAME* rename_table) {
 */
 int mul_two_stage(APEX_CPU* cpu) {
 
-	CPU_Stage* stage = &cpu->stage[MUL_TWO];
-	stage->executed = 0;
-	if ((!stage->stalled)&&(!stage->empty)) {
-		/* Read data from register file for store */
-		switch(stage->inst_type) {
+	for (int lane=0; lane<cpu->mul_units; lane++) {
+		CPU_Stage* stage = &cpu->stage[MUL_TWO][lane];
+		stage->executed = 0;
+		if ((!stage->stalled)&&(!stage->empty)) {
+			/* Read data from register file for store */
+			switch(stage->inst_type) {
 
-			case MUL:  // ************************************* MUL ************************************* //
-				// mul registers value and keep in rd_value for mem / writeback stage
-				// if possible check y it requires 3 cycle
-				stage->rd_value = stage->rs1_value * stage->rs2_value;
-				stage->rd_valid = INVALID;
-				break;
+				case MUL:  // ************************************* MUL ************************************* //
+					// mul registers value and keep in rd_value for mem / writeback stage
+					// if possible check y it requires 3 cycle
+					stage->rd_value = stage->rs1_value * stage->rs2_value;
+					stage->rd_valid = INVALID;
+					break;
 
-			default:
-				break;
+				default:
+					break;
+			}
+			stage->executed = 1;
 		}
-		stage->executed = 1;
-	}
 
-	if (ENABLE_DEBUG_MESSAGES) {
-		print_stage_content("Mul FU Two", stage);
+		if (DEBUG_MESSAGES(cpu)) {
+			print_stage_content("Mul FU Two", stage);
+		}
 	}
 
 	return 0;
@@ -1202,33 +1565,35 @@ int mul_two_stage(APEX_CPU* cpu) {
 */
 int mul_three_stage(APEX_CPU* cpu) {
 
-	CPU_Stage* stage = &cpu->stage[MUL_THREE];
-	stage->executed = 0;
-	if ((!stage->stalled)&&(!stage->empty)) {
-		/* Read data from register file for store */
-		switch(stage->inst_type) {
+	for (int lane=0; lane<cpu->mul_units; lane++) {
+		CPU_Stage* stage = &cpu->stage[MUL_THREE][lane];
+		stage->executed = 0;
+		if ((!stage->stalled)&&(!stage->empty)) {
+			/* Read data from register file for store */
+			switch(stage->inst_type) {
 
-			case MUL:  // ************************************* MUL ************************************* //
-				// mul registers value and keep in rd_value for mem / writeback stage
-				// if possible check y it requires 3 cycle
-				stage->rd_value = stage->rs1_value * stage->rs2_value;
-				stage->rd_valid = VALID;
-				if (stage->rd_value == 0) {
-					cpu->flags[ZF] = 1; // computation resulted value zero
-				}
-				else {
-					cpu->flags[ZF] = 0; // computation did not resulted value zero
-				}
-				break;
+				case MUL:  // ************************************* MUL ************************************* //
+					// mul registers value and keep in rd_value for mem / writeback stage
+					// if possible check y it requires 3 cycle
+					stage->rd_value = stage->rs1_value * stage->rs2_value;
+					stage->rd_valid = VALID;
+					if (stage->rd_value == 0) {
+						cpu->flags[ZF] = 1; // computation resulted value zero
+					}
+					else {
+						cpu->flags[ZF] = 0; // computation did not resulted value zero
+					}
+					break;
 
-			default:
-				break;
+				default:
+					break;
+			}
+			stage->executed = 1;
 		}
-		stage->executed = 1;
-	}
 
-	if (ENABLE_DEBUG_MESSAGES) {
-		print_stage_content("Mul FU Three", stage);
+		if (DEBUG_MESSAGES(cpu)) {
+			print_stage_content("Mul FU Three", stage);
+		}
 	}
 
 	return 0;
@@ -1238,9 +1603,28 @@ int mul_three_stage(APEX_CPU* cpu) {
 /*
  * ########################################## Branch FU Stage ##########################################
 */
-int branch_stage(APEX_CPU* cpu) {
+static int redirect_fetch(APEX_CPU* cpu, APEX_ROB* rob, CPU_Stage* stage, int new_pc) {
+	// flush F and DRF and fetch from branch target
+	// returns VALID if fall through path already got renamed or dispatched, ROB squashes it when branch commits
+	int squash = (has_younger_reorder_buffer_entry(rob, stage->rob_index)==SUCCESS) ? VALID : INVALID;
+	for (int lane=0; lane<cpu->fetch_width; lane++) {
+		if ((!cpu->stage[DRF][lane].empty)&&(cpu->stage[DRF][lane].executed)) {
+			squash = VALID;
+		}
+	}
+	clear_stage_entry(cpu, DRF);
+	clear_stage_entry(cpu, F);
+	cpu->flags[IF] = 0; // flushed HALT does not stop fetch
+	cpu->pc = new_pc;
+	// stall F so it wont fetch in same cycle
+	cpu->stage[F][0].stalled = VALID;
+	return squash;
+}
+
+
+int branch_stage(APEX_CPU* cpu, APEX_ROB* rob) {
 
-	CPU_Stage* stage = &cpu->stage[BRANCH];
+	CPU_Stage* stage = &cpu->stage[BRANCH][0];
 	stage->executed = 0;
 	if ((!stage->stalled)&&(!stage->empty)) {
 		/* Read data from register file for store */
@@ -1252,17 +1636,13 @@ int branch_stage(APEX_CPU* cpu) {
 				stage->mem_address = stage->buffer;
 				new_pc = stage->pc + stage->mem_address;
 				if ((new_pc < 4000)||(new_pc > ((cpu->code_memory_size*4)+4000))) {
-					fprintf(stderr, "Instruction %s Invalid Relative Address %d\n", stage->opcode, new_pc);
+					fprintf(stderr, "Instruction %s Invalid Relative Address %d\n", get_inst_name(stage->inst_type), new_pc);
 				}
 				else {
-					if (cpu->flags[ZF] == VALID) {
-						clear_stage_entry(cpu, DRF);
-						clear_stage_entry(cpu, F);
+					// ZF comes with rs1 from the inst which set it
+					if (stage->rs1_value == 0) {
 						stage->rd_value = INVALID;
-						stage->rd_valid = VALID;
-						cpu->pc = new_pc;
-						// stall F so it wont fetch in same cycle
-						cpu->stage[F].stalled = VALID;
+						stage->rd_valid = redirect_fetch(cpu, rob, stage, new_pc);
 					}
 					else {
 						stage->rd_value = VALID;
@@ -1276,17 +1656,13 @@ int branch_stage(APEX_CPU* cpu) {
 				stage->mem_address = stage->buffer;
 				new_pc = stage->pc + stage->mem_address;
 				if ((new_pc < 4000)||(new_pc > ((cpu->code_memory_size*4)+4000))) {
-					fprintf(stderr, "Instruction %s Invalid Relative Address %d\n", stage->opcode, new_pc);
+					fprintf(stderr, "Instruction %s Invalid Relative Address %d\n", get_inst_name(stage->inst_type), new_pc);
 				}
 				else {
-					if (cpu->flags[ZF] == INVALID) {
+					// ZF comes with rs1 from the inst which set it
+					if (stage->rs1_value != 0) {
 						stage->rd_value = VALID;
-						stage->rd_valid = VALID;
-						clear_stage_entry(cpu, DRF);
-						clear_stage_entry(cpu, F);
-						cpu->pc = new_pc;
-						// stall F so it wont fetch in same cycle
-						cpu->stage[F].stalled = VALID;
+						stage->rd_valid = redirect_fetch(cpu, rob, stage, new_pc);
 					}
 					else {
 						stage->rd_value = INVALID;
@@ -1300,16 +1676,12 @@ int branch_stage(APEX_CPU* cpu) {
 				stage->mem_address = stage->rs1_value + stage->buffer;
 				new_pc = stage->mem_address;
 				if ((new_pc < 4000)||(new_pc > ((cpu->code_memory_size*4)+4000))) {
-					fprintf(stderr, "Instruction %s Invalid Address %d\n", stage->opcode, new_pc);
+					fprintf(stderr, "Instruction %s Invalid Address %d\n", get_inst_name(stage->inst_type), new_pc);
 				}
 				else {
-					// so rob can commite
-					stage->rd_value = INVALID;
-					stage->rd_valid = VALID;
-					// just change the pc and flush the F and DRF
-					cpu->pc = new_pc;
-					clear_stage_entry(cpu, DRF);
-					clear_stage_entry(cpu, F);
+					// always taken, fall through path is squashed like a taken branch
+					stage->rd_value = VALID;
+					stage->rd_valid = redirect_fetch(cpu, rob, stage, new_pc);
 				}
 				break;
 
@@ -1319,7 +1691,7 @@ int branch_stage(APEX_CPU* cpu) {
 		stage->executed = 1;
 	}
 
-	if (ENABLE_DEBUG_MESSAGES) {
+	if (DEBUG_MESSAGES(cpu)) {
 		print_stage_content("Branch FU", stage);
 	}
 
@@ -1332,11 +1704,11 @@ int branch_stage(APEX_CPU* cpu) {
 */
 int mem_stage(APEX_CPU* cpu) {
 
-	CPU_Stage* stage = &cpu->stage[MEM];
+	CPU_Stage* stage = &cpu->stage[MEM][0];
 	stage->executed = 0;
 	if ((!stage->stalled)&&(!stage->empty)) {
 		/* Read data from register file for store */
-		if (stage->stage_cycle >= 3) {
+		if (stage->stage_cycle >= cpu->mem_latency) {
 
 			switch(stage->inst_type) {
 
@@ -1381,7 +1753,7 @@ int mem_stage(APEX_CPU* cpu) {
 		}
 	}
 
-	if (ENABLE_DEBUG_MESSAGES) {
+	if (DEBUG_MESSAGES(cpu)) {
 		print_stage_content("Mem FU", stage);
 		printf("Mem FU Cycle :: %d\n",stage->stage_cycle);
 	}
@@ -1393,134 +1765,190 @@ int mem_stage(APEX_CPU* cpu) {
 /*
  * ########################################## Writeback Stage ##########################################
 */
+static void get_stage_ls_iq_entry(CPU_Stage* stage, LS_IQ_Entry* ls_iq_entry) {
+	*ls_iq_entry = (LS_IQ_Entry){
+		.inst_type = stage->inst_type,
+		.executed = stage->executed,
+		.pc = stage->pc,
+		.rd = stage->rd,
+		.rd_value = stage->rd_value,
+		.rd_valid = stage->rd_valid,
+		.rs1 = stage->rs1,
+		.rs1_value = stage->rs1_value,
+		.rs1_valid = stage->rs1_valid,
+		.rs2 = stage->rs2,
+		.rs2_value = stage->rs2_value,
+		.rs2_valid = stage->rs2_valid,
+		.buffer = stage->buffer,
+		.mem_address = stage->mem_address,
+		.lsq_index = stage->lsq_index,
+		.rob_index = stage->rob_index,
+		.stage_cycle = stage->stage_cycle};
+}
+
+
+static void update_rob_from_stage(APEX_CPU* cpu, APEX_ROB* rob, CPU_Stage* stage) {
+	ROB_Entry rob_entry = {
+		.inst_type = stage->inst_type,
+		.executed = stage->executed,
+		.pc = stage->pc,
+		.rd = stage->rd,
+		.rd_value = stage->rd_value,
+		.rd_valid = stage->rd_valid,
+		.rs1 = stage->rs1,
+		.rs1_value = stage->rs1_value,
+		.rs1_valid = stage->rs1_valid,
+		.rs2 = stage->rs2,
+		.rs2_value = stage->rs2_value,
+		.rs2_valid = stage->rs2_valid,
+		.buffer = stage->buffer,
+		.mem_address = stage->mem_address,
+		.exception = stage->rd_valid,
+		.stage_cycle = stage->stage_cycle,
+		.rob_index = stage->rob_index};
+
+	int ret = update_reorder_buffer_entry_data(rob, &rob_entry);
+	if (ret==ERROR) {
+		if (DEBUG_MESSAGES_L2(cpu)) {
+			fprintf(stderr, "Writeback Failed to Update Rob Entry (%d) for pc(%d):: %.5s\n", ret, stage->pc, get_inst_name(stage->inst_type));
+		}
+	}
+	if (ret==FAILURE) {
+		if (DEBUG_MESSAGES_L2(cpu)) {
+			fprintf(stderr, "Writeback Nothing to Update in Rob Entry (%d) for pc(%d):: %.5s\n", ret, stage->pc, get_inst_name(stage->inst_type));
+		}
+	}
+}
+
+
+static void broadcast_result(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, APEX_RENAME* rename_table, CPU_Stage* stage) {
+	// result bus carries desc phys reg tag and value to ROB, Pn, IQ, LSQ and DRF in the same cycle
+	int ret = -1;
+	LS_IQ_Entry ls_iq_entry;
+	get_stage_ls_iq_entry(stage, &ls_iq_entry);
+
+	update_rob_from_stage(cpu, rob, stage);
+	set_phy_reg_value(stage->rd, stage->rd_value, rename_table);
+
+	ret = update_issue_queue_entry(issue_queue, &ls_iq_entry);
+	if (ret==FAILURE) {
+		if (DEBUG_MESSAGES_L2(cpu)) {
+			fprintf(stderr, "Writeback Nothing to Update in IQ Entry (%d) for pc(%d):: %.5s\n", ret, stage->pc, get_inst_name(stage->inst_type));
+		}
+	}
+
+	ret = update_ls_queue_entry_reg(ls_queue, &ls_iq_entry);
+	if (ret==FAILURE) {
+		if (DEBUG_MESSAGES_L2(cpu)) {
+			fprintf(stderr, "Writeback Nothing to Update in LSQ Entry (%d) for pc(%d):: %.5s\n", ret, stage->pc, get_inst_name(stage->inst_type));
+		}
+	}
+	// Also update DRF regs so next they can be dispatched
+	for (int lane=0; lane<cpu->fetch_width; lane++) {
+		CPU_Stage* drf = &cpu->stage[DRF][lane];
+		// src regs of a lane hold phys tags only after it is decoded
+		if ((drf->empty)||(!drf->executed)) {
+			continue;
+		}
+		switch (drf->inst_type) {
+			// check single src reg instructions
+			case STORE: case LOAD: case MOV: case ADDL: case SUBL: case JUMP: case BZ: case BNZ:
+				if ((drf->rs1==stage->rd)&&(drf->rs1_valid==INVALID)) {
+					drf->rs1_value = stage->rd_value;
+					drf->rs1_valid = stage->rd_valid;
+				}
+				break;
+			// check two src reg instructions
+			case STR: case LDR: case ADD: case SUB: case MUL: case DIV: case AND: case OR: case EXOR:
+				if ((drf->rs1==stage->rd)&&(drf->rs1_valid==INVALID)) {
+					drf->rs1_value = stage->rd_value;
+					drf->rs1_valid = stage->rd_valid;
+				}
+				if ((drf->rs2==stage->rd)&&(drf->rs2_valid==INVALID)) {
+					drf->rs2_value = stage->rd_value;
+					drf->rs2_valid = stage->rd_valid;
+				}
+				break;
+			default:
+				break;
+		}
+		// Store data reg is read from rd
+		if ((drf->inst_type==STORE)||(drf->inst_type==STR)) {
+			if ((drf->rd==stage->rd)&&(drf->rd_valid==INVALID)) {
+				drf->rd_value = stage->rd_value;
+				drf->rd_valid = stage->rd_valid;
+			}
+		}
+	}
+}
+
+
 int writeback_stage(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, APEX_RENAME* rename_table) {
 
 	// take MUL_THREE, INT_TWO Stage and update the ROB entry so in next cycle
 	// instruction can be commited
 
 	int cpu_stages[CPU_OUT_STAGES] = {INT_TWO, MUL_THREE, BRANCH, MEM};
+	int stage_lanes[CPU_OUT_STAGES] = {cpu->int_units, cpu->mul_units, 1, 1};
+	int buses_free = cpu->result_buses;
+
+	// oldest waiting results go first
+	while ((buses_free>0)&&(cpu->result_count>0)) {
+		broadcast_result(cpu, ls_queue, issue_queue, rob, rename_table, &cpu->result_queue[cpu->result_head]);
+		cpu->result_head = (cpu->result_head + 1) % cpu->result_queue_size;
+		cpu->result_count -= 1;
+		buses_free -= 1;
+	}
 
 	for (int i=0; i<CPU_OUT_STAGES; i++) {
+		for (int lane=0; lane<stage_lanes[i]; lane++) {
+
+			CPU_Stage* stage = &cpu->stage[cpu_stages[i]][lane];
 
-		CPU_Stage* stage = &cpu->stage[cpu_stages[i]];
-
-		if ((stage->executed)&&(!stage->empty)) {
-			int ret = -1;
-			LS_IQ_Entry ls_iq_entry = {
-				.inst_type = stage->inst_type,
-				.executed = stage->executed,
-				.pc = stage->pc,
-				.rd = stage->rd,
-				.rd_value = stage->rd_value,
-				.rd_valid = stage->rd_valid,
-				.rs1 = stage->rs1,
-				.rs1_value = stage->rs1_value,
-				.rs1_valid = stage->rs1_valid,
-				.rs2 = stage->rs2,
-				.rs2_value = stage->rs2_value,
-				.rs2_valid = stage->rs2_valid,
-				.buffer = stage->buffer,
-				.mem_address = stage->mem_address,
-				.lsq_index = stage->lsq_index,
-				.stage_cycle = stage->stage_cycle};
-
-			ROB_Entry rob_entry = {
-				.inst_type = stage->inst_type,
-				.executed = stage->executed,
-				.pc = stage->pc,
-				.rd = stage->rd,
-				.rd_value = stage->rd_value,
-				.rd_valid = stage->rd_valid,
-				.rs1 = stage->rs1,
-				.rs1_value = stage->rs1_value,
-				.rs1_valid = stage->rs1_valid,
-				.rs2 = stage->rs2,
-				.rs2_value = stage->rs2_value,
-				.rs2_valid = stage->rs2_valid,
-				.buffer = stage->buffer,
-				.exception = stage->rd_valid,
-				.stage_cycle = stage->stage_cycle};
-
-			if ((cpu_stages[i]==INT_TWO)&&((stage->inst_type==STORE)||(stage->inst_type==STR)||(stage->inst_type==LOAD)||(stage->inst_type==LDR))) {
-				ret = update_ls_queue_entry_mem_address(ls_queue, ls_iq_entry);
-				if (ret!=SUCCESS) {
-					if (ENABLE_DEBUG_MESSAGES_L2) {
-						fprintf(stderr, "Failed to Update LSQ Entry (%d) for pc(%d):: %.5s\n", ret, stage->pc, stage->opcode);
+			if ((stage->executed)&&(!stage->empty)) {
+				int ret = -1;
+
+				if ((cpu_stages[i]==INT_TWO)&&((stage->inst_type==STORE)||(stage->inst_type==STR)||(stage->inst_type==LOAD)||(stage->inst_type==LDR))) {
+					LS_IQ_Entry ls_iq_entry;
+					get_stage_ls_iq_entry(stage, &ls_iq_entry);
+					ret = update_ls_queue_entry_mem_address(ls_queue, &ls_iq_entry);
+					if (ret!=SUCCESS) {
+						if (DEBUG_MESSAGES_L2(cpu)) {
+							fprintf(stderr, "Failed to Update LSQ Entry (%d) for pc(%d):: %.5s\n", ret, stage->pc, get_inst_name(stage->inst_type));
+						}
 					}
+					continue;
 				}
-				continue;
-			}
-			else if (cpu_stages[i]==BRANCH) {
-				ret = update_reorder_buffer_entry_data(rob, rob_entry);
-				if (ret==ERROR) {
-					if (ENABLE_DEBUG_MESSAGES_L2) {
-						fprintf(stderr, "Writeback Failed to Update Rob Entry (%d) for pc(%d):: %.5s\n", ret, stage->pc, stage->opcode);
-					}
+				else if ((cpu_stages[i]==BRANCH)||(stage->inst_type==STORE)||(stage->inst_type==STR)) {
+					// no desc reg, only ROB has to know inst is done
+					update_rob_from_stage(cpu, rob, stage);
+					continue;
 				}
-				if (ret==FAILURE) {
-					if (ENABLE_DEBUG_MESSAGES_L2) {
-						fprintf(stderr, "Writeback Nothing to Update in Rob Entry (%d) for pc(%d):: %.5s\n", ret, stage->pc, stage->opcode);
-					}
+				else if ((buses_free>0)&&(cpu->result_count==0)) {
+					// nothing older is waiting, broadcast straight from the stage
+					broadcast_result(cpu, ls_queue, issue_queue, rob, rename_table, stage);
+					buses_free -= 1;
+				}
+				else if (cpu->result_count<cpu->result_queue_size) {
+					// result waits for a result bus
+					cpu->result_queue[(cpu->result_head + cpu->result_count) % cpu->result_queue_size] = *stage;
+					cpu->result_count += 1;
 				}
-				continue;
 			}
 			else {
-				ret = update_reorder_buffer_entry_data(rob, rob_entry);
-				if (ret==ERROR) {
-					if (ENABLE_DEBUG_MESSAGES_L2) {
-						fprintf(stderr, "Writeback Failed to Update Rob Entry (%d) for pc(%d):: %.5s\n", ret, stage->pc, stage->opcode);
-					}
-				}
-				if (ret==FAILURE) {
-					if (ENABLE_DEBUG_MESSAGES_L2) {
-						fprintf(stderr, "Writeback Nothing to Update in Rob Entry (%d) for pc(%d):: %.5s\n", ret, stage->pc, stage->opcode);
-					}
-				}
-
-				ret = update_issue_queue_entry(issue_queue, ls_iq_entry);
-				if (ret==FAILURE) {
-					if (ENABLE_DEBUG_MESSAGES_L2) {
-						fprintf(stderr, "Writeback Failed to Update IQ Entry (%d) for pc(%d):: %.5s\n", ret, stage->pc, stage->opcode);
-					}
-				}
-
-				ret = update_ls_queue_entry_reg(ls_queue, ls_iq_entry);
-				if (ret==FAILURE) {
-					if (ENABLE_DEBUG_MESSAGES_L2) {
-						fprintf(stderr, "Writeback Nothing to Update in LSQ Entry (%d) for pc(%d):: %.5s\n", ret, stage->pc, stage->opcode);
-					}
-				}
-				// Also update DRF regs so next they can be dispatched
-				switch (cpu->stage[DRF].inst_type) {
-					// check single src reg instructions
-					case STORE: case LOAD: case MOV: case ADDL: case SUBL: case JUMP:
-						if ((cpu->stage[DRF].rs1==stage->rd)&&(cpu->stage[DRF].rs1_valid==INVALID)) {
-							cpu->stage[DRF].rs1_value = stage->rd_value;
-							cpu->stage[DRF].rs1_valid = stage->rd_valid;
-						}
-						break;
-					// check two src reg instructions
-					case STR: case LDR: case ADD: case SUB: case MUL: case DIV: case AND: case OR: case EXOR:
-						if ((cpu->stage[DRF].rs1==stage->rd)&&(cpu->stage[DRF].rs1_valid==INVALID)) {
-							cpu->stage[DRF].rs1_value = stage->rd_value;
-							cpu->stage[DRF].rs1_valid = stage->rd_valid;
-						}
-						if ((cpu->stage[DRF].rs2==stage->rd)&&(cpu->stage[DRF].rs2_valid==INVALID)) {
-							cpu->stage[DRF].rs2_value = stage->rd_value;
-							cpu->stage[DRF].rs2_valid = stage->rd_valid;
-						}
-						break;
-					// confirm if for Store we need to read all three src reg
-					default:
-						break;
+				if (DEBUG_MESSAGES_L2(cpu)) {
+					fprintf(stderr, "Writeback for Stage %d Not Ready to Process\n", cpu_stages[i]);
 				}
 			}
 		}
-		else {
-			if (ENABLE_DEBUG_MESSAGES_L2) {
-				fprintf(stderr, "Writeback for Stage %d Not Ready to Process\n", cpu_stages[i]);
-			}
-		}
+	}
+
+	// results which did not get a bus this cycle are broadcast from the queue
+	if (cpu->result_count>0) {
+		cpu->cycle_stalls |= (1 << STALL_RESULT_BUS);
+	}
+	if ((cpu->result_count>0)&&(DEBUG_MESSAGES_L2(cpu))) {
+		fprintf(stderr, "Writeback %d Results Waiting for Result Bus\n", cpu->result_count);
 	}
 
 	return 0;
@@ -1530,110 +1958,143 @@ int writeback_stage(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APE
 /*
  * ########################################## Dispatch Stage ##########################################
 */
-int dispatch_instruction(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, APEX_RENAME* rename_table){
+static int dispatch_lane(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, CPU_Stage* stage) {
 	// check if ISQ entry is free and ROB entry is free then dispatch the instruction
-	CPU_Stage* stage = &cpu->stage[DRF];
-	if (stage->executed) {
-		int ret = 0;
-		int lsq_index = -1;
-
-		LS_IQ_Entry ls_iq_entry = {
-			.inst_type = stage->inst_type,
-			.executed = stage->executed,
-			.pc = stage->pc,
-			.rd = stage->rd,
-			.rd_value = stage->rd_value,
-			.rd_valid = stage->rd_valid,
-			.rs1 = stage->rs1,
-			.rs1_value = stage->rs1_value,
-			.rs1_valid = stage->rs1_valid,
-			.rs2 = stage->rs2,
-			.rs2_value = stage->rs2_value,
-			.rs2_valid = stage->rs2_valid,
-			.buffer = stage->buffer,
-			.stage_cycle = INVALID}; // so that which issue is called it stalls this just added inst for at least 1 cycyle
-
-		ROB_Entry rob_entry = {
-			.inst_type = stage->inst_type,
-			.executed = stage->executed,
-			.pc = stage->pc,
-			.rd = stage->rd,
-			.rd_value = stage->rd_value,
-			.rd_valid = stage->rd_valid,
-			.rs1 = stage->rs1,
-			.rs1_value = stage->rs1_value,
-			.rs1_valid = stage->rs1_valid,
-			.rs2 = stage->rs2,
-			.rs2_value = stage->rs2_value,
-			.rs2_valid = stage->rs2_valid,
-			.exception = INVALID,
-			.buffer = stage->buffer,
-			.stage_cycle = INVALID};
-
-		switch (stage->inst_type) {
-			case STORE: case STR: case LOAD: case LDR:
-				// add entry to LSQ and ROB
-				// check if LSQ entry is available and rob entry is available
-				if ((can_add_entry_in_issue_queue(issue_queue)==SUCCESS)&&(can_add_entry_in_ls_queue(ls_queue)==SUCCESS)&&(can_add_entry_in_reorder_buffer(rob)==SUCCESS)) {
-					ret = add_ls_queue_entry(ls_queue, ls_iq_entry, &lsq_index);
-					if(ret==SUCCESS) {
-						ret = add_issue_queue_entry(issue_queue, ls_iq_entry, &lsq_index);
-						ret = add_reorder_buffer_entry(rob, rob_entry);
-					}
-					else {
-						if (ENABLE_DEBUG_MESSAGES_L2) {
-							fprintf(stderr, "LSQ IQ ROB Eentry Failed for Inst Type :: %d\n", stage->inst_type);
-						}
-					}
-				}
-				else{
-					// stall DRF and Fetch stage
-					cpu->stage[DRF].stalled = VALID;
-					cpu->stage[F].stalled = VALID;
-				}
-				break;
+	int ret = SUCCESS;
+	int lsq_index = -1;
+	int rob_index = -1;
+
+	LS_IQ_Entry ls_iq_entry = {
+		.inst_type = stage->inst_type,
+		.executed = stage->executed,
+		.pc = stage->pc,
+		.rd = stage->rd,
+		.rd_value = stage->rd_value,
+		.rd_valid = stage->rd_valid,
+		.rs1 = stage->rs1,
+		.rs1_value = stage->rs1_value,
+		.rs1_valid = stage->rs1_valid,
+		.rs2 = stage->rs2,
+		.rs2_value = stage->rs2_value,
+		.rs2_valid = stage->rs2_valid,
+		.buffer = stage->buffer,
+		.stage_cycle = INVALID}; // so that which issue is called it stalls this just added inst for at least 1 cycyle
+
+	ROB_Entry rob_entry = {
+		.inst_type = stage->inst_type,
+		.executed = stage->executed,
+		.pc = stage->pc,
+		.rd = stage->rd,
+		.rd_value = stage->rd_value,
+		.rd_valid = stage->rd_valid,
+		.rs1 = stage->rs1,
+		.rs1_value = stage->rs1_value,
+		.rs1_valid = stage->rs1_valid,
+		.rs2 = stage->rs2,
+		.rs2_value = stage->rs2_value,
+		.rs2_valid = stage->rs2_valid,
+		.exception = INVALID,
+		.buffer = stage->buffer,
+		.stage_cycle = INVALID};
 
-			case MOVC ... JUMP:
-				// add entry to ISQ and ROB
-				// check if IQ entry is available and rob entry is available
-				if ((can_add_entry_in_issue_queue(issue_queue)==SUCCESS)&&(can_add_entry_in_reorder_buffer(rob)==SUCCESS)) {
-					ret = add_issue_queue_entry(issue_queue, ls_iq_entry, &lsq_index);
-					ret = add_reorder_buffer_entry(rob, rob_entry);
-					if(ret!=SUCCESS) {
-						if (ENABLE_DEBUG_MESSAGES_L2) {
-							fprintf(stderr, "IQ ROB Eentry Failed for Inst Type :: %d\n", stage->inst_type);
-						}
-					}
+	switch (stage->inst_type) {
+		case STORE: case STR: case LOAD: case LDR:
+			// add entry to LSQ and ROB
+			// check if LSQ entry is available and rob entry is available
+			if ((can_add_entry_in_issue_queue(issue_queue)==SUCCESS)&&(can_add_entry_in_ls_queue(ls_queue)==SUCCESS)&&(can_add_entry_in_reorder_buffer(rob)==SUCCESS)) {
+				// ROB entry first so IQ and LSQ entries carry its index
+				add_reorder_buffer_entry(rob, &rob_entry, &rob_index);
+				ls_iq_entry.rob_index = rob_index;
+				if(add_ls_queue_entry(ls_queue, &ls_iq_entry, &lsq_index)==SUCCESS) {
+					add_issue_queue_entry(issue_queue, &ls_iq_entry, &lsq_index);
 				}
-				else{
-					// stall DRF and Fetch stage
-					cpu->stage[DRF].stalled = VALID;
-					cpu->stage[F].stalled = VALID;
+				else {
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						fprintf(stderr, "LSQ IQ ROB Eentry Failed for Inst Type :: %d\n", stage->inst_type);
+					}
 				}
-				break;
+			}
+			else{
+				// inst stays in DRF till entries are free
+				ret = FAILURE;
+			}
+			break;
 
-			case HALT:
-				// add entry to ROB
-				if (can_add_entry_in_reorder_buffer(rob)==SUCCESS) {
-					ret = add_reorder_buffer_entry(rob, rob_entry);
-					if(ret!=SUCCESS) {
-						if (ENABLE_DEBUG_MESSAGES_L2) {
-							fprintf(stderr, "ROB Eentry Failed for Inst Type :: %d\n", stage->inst_type);
-						}
+		case MOVC ... JUMP:
+			// add entry to ISQ and ROB
+			// check if IQ entry is available and rob entry is available
+			if ((can_add_entry_in_issue_queue(issue_queue)==SUCCESS)&&(can_add_entry_in_reorder_buffer(rob)==SUCCESS)) {
+				// ROB entry first so IQ entry carries its index
+				add_reorder_buffer_entry(rob, &rob_entry, &rob_index);
+				ls_iq_entry.rob_index = rob_index;
+				if(add_issue_queue_entry(issue_queue, &ls_iq_entry, &lsq_index)!=SUCCESS) {
+					if (DEBUG_MESSAGES_L2(cpu)) {
+						fprintf(stderr, "IQ ROB Eentry Failed for Inst Type :: %d\n", stage->inst_type);
 					}
 				}
-				break;
+			}
+			else{
+				// inst stays in DRF till entries are free
+				ret = FAILURE;
+			}
+			break;
 
-			default:
-				break;
-		}
+		case HALT:
+			// add entry to ROB
+			if (can_add_entry_in_reorder_buffer(rob)==SUCCESS) {
+				add_reorder_buffer_entry(rob, &rob_entry, &rob_index);
+			}
+			else {
+				ret = FAILURE;
+			}
+			break;
+
+		default:
+			break;
 	}
-	else {
-		if (!stage->empty){
-			if (ENABLE_DEBUG_MESSAGES_L2) {
-				fprintf(stderr, "Dispatch Failed DRF has non executed instruction :: pc(%d) %s\n", stage->pc, stage->opcode);
+
+	return ret;
+}
+
+
+static void note_dispatch_stall(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, int inst_type) {
+	// every structure the inst needs and finds full is a cause of this stall
+	if (can_add_entry_in_reorder_buffer(rob)!=SUCCESS) {
+		cpu->cycle_stalls |= (1 << STALL_ROB_FULL);
+	}
+	if ((inst_type!=HALT)&&(can_add_entry_in_issue_queue(issue_queue)!=SUCCESS)) {
+		cpu->cycle_stalls |= (1 << STALL_IQ_FULL);
+	}
+	if (((inst_type==STORE)||(inst_type==STR)||(inst_type==LOAD)||(inst_type==LDR))&&(can_add_entry_in_ls_queue(ls_queue)!=SUCCESS)) {
+		cpu->cycle_stalls |= (1 << STALL_LSQ_FULL);
+	}
+}
+
+
+int dispatch_instruction(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, APEX_RENAME* rename_table){
+	// dispatch DRF lanes in program order, first one which can not be dispatched holds back the rest
+	int dispatched = 0;
+	for (int lane=0; (lane<cpu->fetch_width)&&(dispatched<cpu->dispatch_width); lane++) {
+		CPU_Stage* stage = &cpu->stage[DRF][lane];
+		if (stage->empty) {
+			continue;
+		}
+		if (!stage->executed) {
+			if (DEBUG_MESSAGES_L2(cpu)) {
+				fprintf(stderr, "Dispatch Failed DRF has non executed instruction :: pc(%d) %s\n", stage->pc, get_inst_name(stage->inst_type));
 			}
+			break;
 		}
+		if (dispatch_lane(cpu, ls_queue, issue_queue, rob, stage)!=SUCCESS) {
+			note_dispatch_stall(cpu, ls_queue, issue_queue, rob, stage->inst_type);
+			if (DEBUG_MESSAGES_L2(cpu)) {
+				fprintf(stderr, "Dispatch Stalled for pc(%d) %s\n", stage->pc, get_inst_name(stage->inst_type));
+			}
+			break;
+		}
+		// lane is free, once all lanes are free next fetch group moves in
+		clear_stage_lane(stage);
+		dispatched += 1;
 	}
 
 	return 0;
@@ -1645,102 +2106,66 @@ int dispatch_instruction(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue
 */
 int issue_instruction(APEX_CPU* cpu, APEX_IQ* issue_queue, APEX_LSQ* ls_queue) {
 	// check if respective FU is free and All Regs Value are Valid then issue the instruction
-	// get issue_index of all the instruction
+	// each func unit takes the oldest ready instruction waiting for it
 	int ret = 0;
-	int issue_index[IQ_SIZE] = {[0 ... IQ_SIZE-1] = -1};
-	ret = get_issue_queue_index_to_issue(issue_queue, issue_index);
-	if (ret==SUCCESS) {
-		char* inst_type_str = (char*) malloc(10);
-		for (int i=0; i<IQ_SIZE; i++) {
-			if (issue_index[i]>-1) {
-				int stage_num = -1;
-
-				switch (issue_queue->iq_entries[issue_index[i]].inst_type) {
-
-					case STORE: case STR: case LOAD: case LDR: case MOVC: case MOV: case ADD: case ADDL: case SUB: case SUBL: case DIV: case AND: case OR: case EXOR:
-						stage_num = INT_ONE;
-						break;
-
-					case MUL:
-						stage_num = MUL_ONE;
-						break;
-
-					case BZ: case BNZ:
-						stage_num = BRANCH;
-						break;
-
-					default:
-						break;
-				}
-				if (stage_num>DRF) {
-					CPU_Stage* stage = &cpu->stage[stage_num];
-					if ((stage->executed)||(stage->empty)) {
-						strcpy(inst_type_str, "");
-						stage->executed = INVALID;
-						stage->empty = INVALID;
-						stage->inst_type = issue_queue->iq_entries[issue_index[i]].inst_type;
-						get_inst_name(stage->inst_type, inst_type_str);
-						strcpy(stage->opcode, inst_type_str);
-						stage->pc = issue_queue->iq_entries[issue_index[i]].inst_ptr;
-						stage->rd = issue_queue->iq_entries[issue_index[i]].rd;
-						stage->rd_value = issue_queue->iq_entries[issue_index[i]].rd_value;
-						if ((stage->inst_type==STORE)||(stage->inst_type==STR)) {
-							stage->rd_valid = issue_queue->iq_entries[issue_index[i]].rd_ready;;
-						}
-						else {
-							stage->rd_valid = INVALID;
-						}
-						stage->rs1 = issue_queue->iq_entries[issue_index[i]].rs1;
-						stage->rs1_value = issue_queue->iq_entries[issue_index[i]].rs1_value;
-						stage->rs1_valid = issue_queue->iq_entries[issue_index[i]].rs1_ready;
-						stage->rs2 = issue_queue->iq_entries[issue_index[i]].rs2;
-						stage->rs2_value = issue_queue->iq_entries[issue_index[i]].rs2_value;
-						stage->rs2_valid = issue_queue->iq_entries[issue_index[i]].rs2_ready;
-						stage->buffer = issue_queue->iq_entries[issue_index[i]].literal;
-						stage->lsq_index = issue_queue->iq_entries[issue_index[i]].lsq_index;
-						// remove the entry from issue_queue or mark it as invalid
-						issue_queue->iq_entries[issue_index[i]].status = INVALID;
-						issue_queue->iq_entries[issue_index[i]].inst_type = INVALID;
-						issue_queue->iq_entries[issue_index[i]].inst_ptr = INVALID;
-						issue_queue->iq_entries[issue_index[i]].rd = INVALID;
-						issue_queue->iq_entries[issue_index[i]].rd_value = INVALID;
-						issue_queue->iq_entries[issue_index[i]].rd_ready = INVALID;
-						issue_queue->iq_entries[issue_index[i]].rs1 = INVALID;
-						issue_queue->iq_entries[issue_index[i]].rs1_value = INVALID;
-						issue_queue->iq_entries[issue_index[i]].rs1_ready = INVALID;
-						issue_queue->iq_entries[issue_index[i]].rs2 = INVALID;
-						issue_queue->iq_entries[issue_index[i]].rs2_value = INVALID;
-						issue_queue->iq_entries[issue_index[i]].rs2_ready = INVALID;
-						issue_queue->iq_entries[issue_index[i]].literal = INVALID;
-						issue_queue->iq_entries[issue_index[i]].lsq_index = INVALID;
-						issue_queue->iq_entries[issue_index[i]].stage_cycle = INVALID;
-					}
-				}
-				if (ENABLE_DEBUG_MESSAGES_L2) {
-					fprintf(stderr, "Inst issueed to Unit :: %d\n", stage_num);
+	int issued = 0;
+	int fu_types[] = {IQ_FU_INT, IQ_FU_MUL, IQ_FU_BRANCH};
+	int fu_stages[] = {INT_ONE, MUL_ONE, BRANCH};
+	int fu_lanes[] = {cpu->int_units, cpu->mul_units, 1};
+	for (int i=0; i<(int)(sizeof(fu_types)/sizeof(fu_types[0])); i++) {
+		for (int lane=0; (lane<fu_lanes[i])&&(issued<cpu->issue_width); lane++) {
+			CPU_Stage* stage = &cpu->stage[fu_stages[i]][lane];
+			if (!((stage->executed)||(stage->empty))) {
+				continue;
+			}
+			int issue_index = -1;
+			ret = get_issue_queue_index_to_issue(issue_queue, fu_types[i], &issue_index);
+			if (ret==SUCCESS) {
+				IQ_FORMAT* iq_entry = &issue_queue->iq_entries[issue_index];
+				stage->executed = INVALID;
+				stage->empty = INVALID;
+				stage->inst_type = iq_entry->inst_type;
+				stage->pc = iq_entry->inst_ptr;
+				stage->rd = iq_entry->rd;
+				stage->rd_value = iq_entry->rd_value;
+				if ((stage->inst_type==STORE)||(stage->inst_type==STR)) {
+					stage->rd_valid = iq_entry->rd_ready;
+				}
+				else {
+					stage->rd_valid = INVALID;
+				}
+				stage->rs1 = iq_entry->rs1;
+				stage->rs1_value = iq_entry->rs1_value;
+				stage->rs1_valid = iq_entry->rs1_ready;
+				stage->rs2 = iq_entry->rs2;
+				stage->rs2_value = iq_entry->rs2_value;
+				stage->rs2_valid = iq_entry->rs2_ready;
+				stage->buffer = iq_entry->literal;
+				stage->lsq_index = iq_entry->lsq_index;
+				stage->rob_index = iq_entry->rob_index;
+				// remove the entry from issue_queue or mark it as invalid
+				remove_issue_queue_entry(issue_queue, issue_index);
+				issued += 1;
+				if (DEBUG_MESSAGES_L2(cpu)) {
+					fprintf(stderr, "Inst issueed to Unit :: %d\n", fu_stages[i]);
+				}
+			}
+			else {
+				if (DEBUG_MESSAGES_L2(cpu)) {
+					fprintf(stderr, "No Inst to issue to Unit :: %d\n", fu_stages[i]);
 				}
 			}
-		}
-		free(inst_type_str);
-	}
-	else {
-		if (ENABLE_DEBUG_MESSAGES_L2) {
-			fprintf(stderr, "No Inst to issue to Unit\n");
 		}
 	}
 
 	int lsq_index = -1;
 	ret = get_ls_queue_index_to_issue(ls_queue, &lsq_index);
 	if (ret==SUCCESS) {
-		char* inst_type_str = (char*) malloc(10);
-		CPU_Stage* stage = &cpu->stage[MEM];
+		CPU_Stage* stage = &cpu->stage[MEM][0];
 		if ((stage->executed)||(stage->empty)) {
-			strcpy(inst_type_str, "");
 			stage->executed = INVALID;
 			stage->empty = INVALID;
 			stage->inst_type = ls_queue->lsq_entries[lsq_index].load_store;
-			get_inst_name(stage->inst_type, inst_type_str);
-			strcpy(stage->opcode, inst_type_str);
 			stage->pc = ls_queue->lsq_entries[lsq_index].inst_ptr;
 			stage->rd = ls_queue->lsq_entries[lsq_index].rd;
 			stage->rd_value = ls_queue->lsq_entries[lsq_index].rd_value;
@@ -1753,6 +2178,7 @@ int issue_instruction(APEX_CPU* cpu, APEX_IQ* issue_queue, APEX_LSQ* ls_queue) {
 			stage->rs2_valid = VALID;
 			stage->buffer = ls_queue->lsq_entries[lsq_index].literal;
 			stage->mem_address = ls_queue->lsq_entries[lsq_index].mem_address;
+			stage->rob_index = ls_queue->lsq_entries[lsq_index].rob_index;
 
 			// remove the entry from issue_queue or mark it as invalid
 			ls_queue->lsq_entries[lsq_index].status = INVALID;
@@ -1768,9 +2194,10 @@ int issue_instruction(APEX_CPU* cpu, APEX_IQ* issue_queue, APEX_LSQ* ls_queue) {
 			ls_queue->lsq_entries[lsq_index].rs2 = INVALID;
 			ls_queue->lsq_entries[lsq_index].rs2_value = INVALID;
 			ls_queue->lsq_entries[lsq_index].stage_cycle = INVALID;
+			ls_queue->lsq_entries[lsq_index].rob_index = INVALID;
 		}
 		else {
-			if (ENABLE_DEBUG_MESSAGES_L2) {
+			if (DEBUG_MESSAGES_L2(cpu)) {
 				fprintf(stderr, "Cannot Issue Inst To Mem Stage\n");
 			}
 		}
@@ -1792,7 +2219,7 @@ int execute_instruction(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue,
 	mul_one_stage(cpu, rename_table);
 	mul_two_stage(cpu);
 	mul_three_stage(cpu);
-	branch_stage(cpu);
+	branch_stage(cpu, rob);
 	mem_stage(cpu);
 
 	writeback_stage(cpu, ls_queue, issue_queue, rob, rename_table);
@@ -1811,52 +2238,68 @@ void branch_misprediction(APEX_CPU* cpu, ROB_Entry* rob_entry, APEX_ROB* rob, AP
 
 	clear_issue_queue_entry(issue_queue);
 	clear_ls_queue_entry(ls_queue);
+	// results waiting for a bus belong to squashed instructions
+	cpu->result_head = 0;
+	cpu->result_count = 0;
+
+	// everything in flight is younger than the branch, clear FUs so no stale rob index writes back
+	int fu_stages[] = {INT_ONE, INT_TWO, MUL_ONE, MUL_TWO, MUL_THREE, BRANCH, MEM};
+	for (int i=0; i<(int)(sizeof(fu_stages)/sizeof(fu_stages[0])); i++) {
+		clear_stage_entry(cpu, fu_stages[i]);
+	}
 
 	// clear all the cpu stages
 	// change pc and flush F DRF
 	clear_stage_entry(cpu, DRF);
 	clear_stage_entry(cpu, F);
 	// stall F so it wont fetch in same cycle
-	cpu->stage[F].stalled = VALID;
+	cpu->stage[F][0].stalled = VALID;
+	// a HALT on the squashed path must not keep fetch stalled
+	cpu->flags[IF] = 0;
+	// every ZF producer in flight is squashed, committed ZF is the one to read
+	cpu->zf_tag = -1;
+	// no squashed inst will commit to take back its arch reg status
+	memset(cpu->regs_invalid, 0, sizeof(int) * REGISTER_FILE_SIZE);
 
 }
 
 /*
  * ########################################## Commit Stage ##########################################
 */
-int commit_instruction(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, APEX_RENAME* rename_table) {
+static int commit_rob_head(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, APEX_RENAME* rename_table) {
 	// check if rob entry is valid and data is valid then commit instruction and free rob entry
 	int ret = -1;
 
-	ROB_Entry* rob_entry = malloc(sizeof(*rob_entry));
-	// entry removed from rob
+	// entry removed from rob, copied out since a misprediction flush clears the ROB
+	ROB_Entry commit_entry;
+	ROB_Entry* rob_entry = &commit_entry;
 	ret = commit_reorder_buffer_entry(rob, rob_entry);
 
 	if (ret==SUCCESS) {
+		if ((cpu->checker)&&(check_commit(cpu->checker, cpu, rob_entry, rename_table)!=SUCCESS)) {
+			// stop at the first divergence, this inst is not counted
+			return ERROR;
+		}
+		cpu->ins_completed += 1;
 		if ((rob_entry->inst_type==STORE)||(rob_entry->inst_type==STR)) {
 			; // no need to free regs or pass rd value
 		}
 		else if (rob_entry->inst_type==JUMP) {
-			; // no need to free regs or pass rd value
-		}
-		else if (rob_entry->inst_type==BZ) {
 			// no need to free regs or pass rd value
-			if ((cpu->flags[ZF]==VALID)&&(rob_entry->exception)) {
-				// branch misspredicted
-				// revert the changes
+			if (rob_entry->exception) {
+				// fall through path got renamed or dispatched before the jump executed
 				branch_misprediction(cpu, rob_entry, rob, ls_queue, issue_queue, rename_table);
-				// pc of branch inst plus 4 will be nex pc
-				cpu->pc = rob_entry->pc + 4;
+				cpu->pc = rob_entry->mem_address;
 			}
 		}
-		else if (rob_entry->inst_type==BNZ) {
+		else if ((rob_entry->inst_type==BZ)||(rob_entry->inst_type==BNZ)) {
 			// no need to free regs or pass rd value
-			if ((cpu->flags[ZF]==INVALID)&&(rob_entry->exception)) {
-				// branch misspredicted
+			if (rob_entry->exception) {
+				// branch was taken after fall through path got renamed or dispatched
 				// revert the changes
 				branch_misprediction(cpu, rob_entry, rob, ls_queue, issue_queue, rename_table);
-				// pc of branch inst plus 4 will be nex pc
-				cpu->pc = rob_entry->pc + 4;
+				// branch target will be next pc
+				cpu->pc = rob_entry->pc + get_code_instruction(cpu, rob_entry->pc)->imm;
 			}
 		}
 		else if (rob_entry->inst_type==HALT) {
@@ -1864,109 +2307,199 @@ int commit_instruction(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue,
 			return HALT;
 		}
 		else {
-			// also update IQ here as well
-			LS_IQ_Entry ls_iq_entry = {
-				.inst_type = rob_entry->inst_type,
-				.executed = rob_entry->executed,
-				.pc = rob_entry->pc,
-				.rd = rob_entry->rd,
-				.rd_value = rob_entry->rd_value,
-				.rd_valid = rob_entry->rd_valid,
-				.rs1 = rob_entry->rs1,
-				.rs1_value = rob_entry->rs1_value,
-				.rs1_valid = rob_entry->rs1_valid,
-				.rs2 = rob_entry->rs2,
-				.rs2_value = rob_entry->rs2_value,
-				.rs2_valid = rob_entry->rs2_valid,
-				.buffer = rob_entry->buffer,
-				.stage_cycle = rob_entry->stage_cycle};
-
-			ret = update_issue_queue_entry(issue_queue, ls_iq_entry);
-			if (ret==FAILURE) {
-				if (ENABLE_DEBUG_MESSAGES_L2) {
-					fprintf(stderr, "Commit Failed to Update IQ Entry (%d) for pc(%d)\n", ret, ls_iq_entry.pc);
-				}
-			}
-
-			ret = update_ls_queue_entry_reg(ls_queue, ls_iq_entry);
-			if (ret==FAILURE) {
-				if (ENABLE_DEBUG_MESSAGES_L2) {
-					fprintf(stderr, "Commit Nothing to Update in LSQ Entry (%d) for pc(%d)\n", ret, ls_iq_entry.pc);
-				}
-			}
-
-			// put the value in DRF
-			switch (cpu->stage[DRF].inst_type) {
-				// check single src reg instructions
-				case STORE: case LOAD: case MOV: case ADDL: case SUBL: case JUMP:
-				if ((cpu->stage[DRF].rs1==rob_entry->rd)&&(cpu->stage[DRF].rs1_valid==INVALID)) {
-					cpu->stage[DRF].rs1_value = rob_entry->rd_value;
-					cpu->stage[DRF].rs1_valid = rob_entry->rd_valid;
-				}
-				break;
-				// check two src reg instructions
-				case STR: case LDR: case ADD: case SUB: case MUL: case DIV: case AND: case OR: case EXOR:
-				if ((cpu->stage[DRF].rs1==rob_entry->rd)&&(cpu->stage[DRF].rs1_valid==INVALID)) {
-					cpu->stage[DRF].rs1_value = rob_entry->rd_value;
-					cpu->stage[DRF].rs1_valid = rob_entry->rd_valid;
-				}
-				if ((cpu->stage[DRF].rs2==rob_entry->rd)&&(cpu->stage[DRF].rs2_valid==INVALID)) {
-						cpu->stage[DRF].rs2_value = rob_entry->rd_value;
-						cpu->stage[DRF].rs2_valid = rob_entry->rd_valid;
-				}
-				break;
-				// confirm if for Store we need to read all three src reg
-				default:
-				break;
-			}
+			// dependents got the value from result bus at writeback
 		// change decs reg in cpu
 		// undo the renaming
 		// put the value in arch reg and increment valid valid count
 		int src_reg = -1;
 		src_reg = get_phy_reg_renamed_tag(rob_entry->rd, rename_table);
 		if (src_reg<0) {
-			if (ENABLE_DEBUG_MESSAGES_L2) {
+			if (DEBUG_MESSAGES_L2(cpu)) {
 				fprintf(stderr, "Commit Failed to Rename :: P%d for pc(%d)\n", rob_entry->rd, rob_entry->pc);
 			}
 		}
 		else {
 			// free the physical regs
 			cpu->regs[src_reg] = rob_entry->rd_value;
-			rename_table->reg_rename[rob_entry->rd].tag_valid = INVALID;
+			if (is_zf_producer(rob_entry->inst_type)) {
+				// branches decoded from now on read ZF from here
+				cpu->zf_value = rob_entry->rd_value;
+				if (cpu->zf_tag==rob_entry->rd) {
+					cpu->zf_tag = -1;
+				}
+			}
+			free_phy_reg(rob_entry->rd, rename_table);
 			set_reg_status(cpu, src_reg, -1);
 			}
 		}
 	}
 	else {
-		printf("Failed to Commit Rob Entry\n");
+		if (DEBUG_MESSAGES_L2(cpu)) {
+			printf("Failed to Commit Rob Entry\n");
+		}
+	}
+
+	return ret;
+}
+
+
+int commit_instruction(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, APEX_RENAME* rename_table) {
+	// commit up to commit width entries from ROB head in order
+	// stops at first entry not ready, a misprediction flush empties the ROB so it stops there too
+	for (int i=0; i<cpu->commit_width; i++) {
+		int ret = commit_rob_head(cpu, ls_queue, issue_queue, rob, rename_table);
+		if ((ret==HALT)||(ret==ERROR)) {
+			return ret;
+		}
+		if (ret!=SUCCESS) {
+			break;
+		}
 	}
 
 	return 0;
 }
 
+/*
+ * ########################################## Idle Cycle Skipping ##########################################
+*/
+
+/* Front end state compared before and after a cycle to find out if it is waiting */
+typedef struct Frontend_Snapshot {
+	CPU_Stage fetch[MAX_WIDTH];
+	CPU_Stage decode[MAX_WIDTH];
+	int pc;
+	int flags[NUM_FLAG];
+	int rob_issue_ptr;
+	int rob_buffer_length;
+	int iq_count;
+	int lsq_count;
+	int rat_rename[REGISTER_FILE_SIZE];
+	int rename_free_head;
+	int rename_free_count;
+} Frontend_Snapshot;
+
+
+static void take_frontend_snapshot(Frontend_Snapshot* snapshot, APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, APEX_RENAME* rename_table) {
+	// only fields front end stages can change or read to make a decision
+	memset(snapshot, 0, sizeof(*snapshot));
+	memcpy(snapshot->fetch, cpu->stage[F], sizeof(snapshot->fetch));
+	memcpy(snapshot->decode, cpu->stage[DRF], sizeof(snapshot->decode));
+	snapshot->pc = cpu->pc;
+	memcpy(snapshot->flags, cpu->flags, sizeof(int) * NUM_FLAG);
+	snapshot->rob_issue_ptr = rob->issue_ptr;
+	snapshot->rob_buffer_length = rob->buffer_length;
+	snapshot->iq_count = get_issue_queue_count(issue_queue);
+	snapshot->lsq_count = get_ls_queue_count(ls_queue);
+	memcpy(snapshot->rat_rename, rename_table->rat_rename, sizeof(snapshot->rat_rename));
+	snapshot->rename_free_head = rename_table->free_head;
+	snapshot->rename_free_count = rename_table->free_count;
+}
+
+
+static int get_idle_cycles(APEX_CPU* cpu, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob) {
+	// returns number of coming cycles in which FUs, IQ, LSQ and ROB only count latency
+	// 0 means some unit can make progress in next cycle, INT_MAX means nothing ever will
+	int fu_stages[] = {INT_ONE, INT_TWO, MUL_ONE, MUL_TWO, MUL_THREE, BRANCH};
+	int fu_lanes[] = {cpu->int_units, cpu->int_units, cpu->mul_units, cpu->mul_units, cpu->mul_units, 1};
+
+	if (can_commit_reorder_buffer_entry(rob)==SUCCESS) {
+		return 0;
+	}
+	if (cpu->result_count>0) {
+		return 0;
+	}
+	if (has_issue_queue_ready_entry(issue_queue)==SUCCESS) {
+		return 0;
+	}
+	for (int i=0; i<(int)(sizeof(fu_stages)/sizeof(fu_stages[0])); i++) {
+		for (int lane=0; lane<fu_lanes[i]; lane++) {
+			if (!cpu->stage[fu_stages[i]][lane].empty) {
+				return 0;
+			}
+		}
+	}
+
+	CPU_Stage* stage = &cpu->stage[MEM][0];
+	if (stage->empty) {
+		// Mem FU is free so any ready LSQ entry gets issued
+		return (has_ls_queue_ready_entry(ls_queue)==SUCCESS) ? 0 : INT_MAX;
+	}
+	if (stage->stage_cycle < cpu->mem_latency) {
+		// LSQ entries wait behind Mem FU till it reaches its latency
+		return cpu->mem_latency - stage->stage_cycle;
+	}
+	if ((!stage->executed)&&(stage->rd_valid != VALID)&&((stage->inst_type==STORE)||(stage->inst_type==STR))) {
+		// store data never arrives in Mem FU once issued
+		return INT_MAX;
+	}
+	return 0;
+}
+
+
+static void add_cycle_stalls(APEX_CPU* cpu, int cycles) {
+	// stall causes seen in this cycle count for every cycle it stands for
+	for (int i=0; i<NUM_STALL; i++) {
+		if (cpu->cycle_stalls & (1 << i)) {
+			cpu->stall_cycles[i] += cycles;
+		}
+	}
+}
+
+
+static void skip_idle_cycles(APEX_CPU* cpu, APEX_LSQ* ls_queue, int cycles) {
+	// apply in bulk what running each of the idle cycles would have changed
+	// front end is unchanged so it stalls for the same causes in all of them
+	cpu->clock += cycles;
+	add_cycle_stalls(cpu, cycles);
+	age_ls_queue_entries(ls_queue, cycles);
+	if (!cpu->stage[MEM][0].empty) {
+		cpu->stage[MEM][0].stage_cycle += cycles;
+	}
+}
+
+
 /*
  * ########################################## CPU Run ##########################################
 */
 
-int APEX_cpu_run(APEX_CPU* cpu, int num_cycle, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, APEX_RENAME* rename_table) {
+int APEX_cpu_run(APEX_CPU* cpu, long long num_cycle, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, APEX_RENAME* rename_table) {
 
 	int ret = 0;
+	// skipping is only done when nothing is printed, so traces still show every cycle
+	int skip_idle = ENABLE_IDLE_CYCLE_SKIP && (cpu->verbose == VERBOSE_QUIET) && (num_cycle > 0);
+	Frontend_Snapshot before, after;
+	unsigned long heap_allocs = apex_heap_allocs;
 
 	while (ret==0) {
 
 		/* Requested number of cycle committed, so pause and exit */
 		if ((num_cycle>0)&&(cpu->clock == num_cycle)) {
-			printf("\n--------------------------------\n");
-			printf("Requested %d Cycle Completed", num_cycle);
-			printf("\n--------------------------------\n");
+			if (DEBUG_MESSAGES(cpu)) {
+				printf("\n--------------------------------\n");
+				printf("Requested %lld Cycle Completed", num_cycle);
+				printf("\n--------------------------------\n");
+			}
+			break;
+		}
+		else if ((cpu->ins_limit>0)&&(cpu->ins_completed >= cpu->ins_limit)) {
+			// requested number of inst committed
 			break;
 		}
 		else {
 			cpu->clock++; // places here so we can see prints aligned with executions
+			cpu->cycle_stalls = 0;
 
-			if (ENABLE_DEBUG_MESSAGES) {
+			int idle_cycles = 0;
+			if (skip_idle) {
+				idle_cycles = get_idle_cycles(cpu, ls_queue, issue_queue, rob);
+				if (idle_cycles > 0) {
+					take_frontend_snapshot(&before, cpu, ls_queue, issue_queue, rob, rename_table);
+				}
+			}
+
+			if (DEBUG_MESSAGES(cpu)) {
 				printf("\n--------------------------------\n");
-				printf("Clock Cycle #: %d\n", cpu->clock);
+				printf("Clock Cycle #: %lld\n", cpu->clock);
 				printf("%-15s: Executed: Instruction\n", "Stage");
 				printf("--------------------------------\n");
 			}
@@ -1974,7 +2507,7 @@ int APEX_cpu_run(APEX_CPU* cpu, int num_cycle, APEX_LSQ* ls_queue, APEX_IQ* issu
 			int stage_ret = 0;
 			// commit inst
 			stage_ret = commit_instruction(cpu, ls_queue, issue_queue, rob, rename_table);
-			if (stage_ret==HALT) {
+			if ((stage_ret==HALT)||(stage_ret==ERROR)) {
 				ret = stage_ret;
 			}
 			// adding inst to FU
@@ -1992,11 +2525,28 @@ int APEX_cpu_run(APEX_CPU* cpu, int num_cycle, APEX_LSQ* ls_queue, APEX_IQ* issu
 			// fetch inst from code memory
 			stage_ret = fetch(cpu);
 			// dispatch func will have rename call inside
-			print_ls_iq_content(ls_queue, issue_queue);
-			print_rob_and_rename_content(rob, rename_table);
+			if (STATUS_PRINT(cpu)) {
+				print_ls_iq_content(ls_queue, issue_queue);
+				print_rob_and_rename_content(rob, rename_table);
+			}
 
 			// push only after IQ Stages
 			push_func_unit_stages(cpu, VALID);
+			add_cycle_stalls(cpu, 1);
+
+			if ((idle_cycles > 0)&&(ret==0)) {
+				// if this cycle left front end unchanged it stays so till backend makes progress
+				take_frontend_snapshot(&after, cpu, ls_queue, issue_queue, rob, rename_table);
+				if (memcmp(&before, &after, sizeof(before)) == 0) {
+					idle_cycles = get_idle_cycles(cpu, ls_queue, issue_queue, rob);
+					if (idle_cycles > num_cycle - cpu->clock) {
+						idle_cycles = (int)(num_cycle - cpu->clock);
+					}
+					if (idle_cycles > 0) {
+						skip_idle_cycles(cpu, ls_queue, idle_cycles);
+					}
+				}
+			}
 
 			// if ((stage_ret!=HALT)&&(stage_ret!=SUCCESS)) {
 			// 	ret = stage_ret;
@@ -2004,5 +2554,11 @@ int APEX_cpu_run(APEX_CPU* cpu, int num_cycle, APEX_LSQ* ls_queue, APEX_IQ* issu
 		}
 	}
 
+	// every structure is sized at init, a cycle should never need the heap
+	cpu->cycle_heap_allocs += apex_heap_allocs - heap_allocs;
+	if ((cpu->cycle_heap_allocs>0)&&(DEBUG_MESSAGES(cpu))) {
+		fprintf(stderr, "APEX_CPU : %lu heap allocations made in cycle loop\n", cpu->cycle_heap_allocs);
+	}
+
 	return ret;
 }
@@ -10,17 +10,64 @@
  */
 
 //
+#include <stdint.h>
+
 #include "rob.h"
 #include "ls_iq.h"
+#include "config.h"
 
 
 #define RUNNING_IN_WINDOWS 1
 
 #define DATA_MEMORY_SIZE 4096
+#ifndef REGISTER_FILE_SIZE
 #define REGISTER_FILE_SIZE 32
+#endif
 
 #define CPU_OUT_STAGES 4
 
+/* Cycles a LOAD/STORE spends in Mem FU before accessing data memory, default of mem_latency */
+#ifndef MEM_LATENCY
+#define MEM_LATENCY 3
+#endif
+
+/* Instructions fetched, dispatched and committed per cycle, 1 is the scalar pipeline */
+#ifndef PIPELINE_WIDTH
+#define PIPELINE_WIDTH 1
+#endif
+#ifndef FETCH_WIDTH
+#define FETCH_WIDTH PIPELINE_WIDTH
+#endif
+#ifndef DISPATCH_WIDTH
+#define DISPATCH_WIDTH PIPELINE_WIDTH
+#endif
+#ifndef COMMIT_WIDTH
+#define COMMIT_WIDTH PIPELINE_WIDTH
+#endif
+
+/* Number of Int and Mul FU pipelines, Branch and Mem FU stay single */
+#ifndef INT_FU_COUNT
+#define INT_FU_COUNT PIPELINE_WIDTH
+#endif
+#ifndef MUL_FU_COUNT
+#define MUL_FU_COUNT ((PIPELINE_WIDTH + 1) / 2)
+#endif
+
+/* Inst issued from IQ per cycle, default is one per Int, Mul and Branch FU like the scalar pipeline */
+#ifndef ISSUE_WIDTH
+#define ISSUE_WIDTH (INT_FU_COUNT + MUL_FU_COUNT + 1)
+#endif
+
+/* Lanes allocated per stage latch, none of the widths or FU counts can be larger */
+#ifndef MAX_WIDTH
+#define MAX_WIDTH 8
+#endif
+
+/* Results broadcast from writeback per cycle, extra results wait for a free bus */
+#ifndef RESULT_BUS_COUNT
+#define RESULT_BUS_COUNT (INT_FU_COUNT + MUL_FU_COUNT + 1)
+#endif
+
 /* Set this flag to 1 to enable debug messages */
 #define ENABLE_DEBUG_MESSAGES 1
 #define ENABLE_DEBUG_MESSAGES_L2 1
@@ -29,6 +76,22 @@
 #define ENABLE_REG_MEM_STATUS_PRINT 1
 #define ENABLE_PUSH_STAGE_PRINT 0
 
+/* Set this flag to 1 to jump the clock over cycles where only latency counters change */
+#define ENABLE_IDLE_CYCLE_SKIP 1
+
+/* Runtime verbosity, above flags still have to be enabled while compiling */
+enum {
+	VERBOSE_QUIET,		// batch mode, nothing is printed while running only the final summary
+	VERBOSE_STAGES,		// print content of stages every cycle
+	VERBOSE_QUEUES,		// also print IQ, LSQ, ROB and Rename Table every cycle
+	VERBOSE_ALL,			// also print level two debug messages
+	NUM_VERBOSE
+};
+
+#define DEBUG_MESSAGES(cpu) (ENABLE_DEBUG_MESSAGES && ((cpu)->verbose >= VERBOSE_STAGES))
+#define DEBUG_MESSAGES_L2(cpu) (ENABLE_DEBUG_MESSAGES_L2 && ((cpu)->verbose >= VERBOSE_ALL))
+#define STATUS_PRINT(cpu) (ENABLE_REG_MEM_STATUS_PRINT && ((cpu)->verbose >= VERBOSE_QUEUES))
+
 enum {
 	F,
 	DRF,
@@ -38,7 +101,7 @@ enum {
 	MUL_TWO,
 	MUL_THREE,
 	BRANCH,
-	MEM,	// one stage with 3 cycle latency
+	MEM,	// one stage with MEM_LATENCY cycle latency
 	WB,		// this is replaces by ROB making the commit and updating the reg or other stages
 	NUM_STAGES
 };
@@ -54,6 +117,16 @@ enum {
 	NUM_EXIT
 };
 
+/* Stall causes, each counts the cycles in which it held back an instruction */
+enum {
+	STALL_ROB_FULL,		// dispatch waits for a ROB entry
+	STALL_IQ_FULL,		// dispatch waits for an IQ entry
+	STALL_LSQ_FULL,		// dispatch waits for an LSQ entry
+	STALL_RENAME,		// decode waits for a free phys reg
+	STALL_RESULT_BUS,		// results wait for a result bus
+	NUM_STALL
+};
+
 /* Index of Flags */
 enum {
 	ZF, // Zero Flag index
@@ -88,59 +161,89 @@ enum {
 };
 
 
-/* Format of an APEX instruction  */
+/* Format of an APEX instruction, predecoded into a fixed width micro-op  */
 typedef struct APEX_Instruction {
-	char opcode[128];	// Operation Code
-	int rd;           // Destination Register Address
-	int rs1;          // Source-1 Register Address
-	int rs2;          // Source-2 Register Address
-	int imm;          // Literal Value
-	int type;         // Inst Type
+	uint8_t type;     // Inst Type, get_inst_name gives the opcode string
+	uint8_t rd;       // Destination Register Address
+	uint8_t rs1;      // Source-1 Register Address
+	uint8_t rs2;      // Source-2 Register Address
+	int32_t imm;      // Literal Value
 } APEX_Instruction;
 
-/* Model of CPU stage latch */
+_Static_assert(sizeof(APEX_Instruction) == 8, "APEX_Instruction must stay a fixed 8 byte micro-op");
+
+/* Model of CPU stage latch, the micro-op is code memory[index of pc], the rest is per stage state */
 typedef struct CPU_Stage {
-	int pc;           // Program Counter
-	char opcode[128]; // Operation Code
-	int rd;           // Destination Register Address
-	int rs1;          // Source-1 Register Address
-	int rs2;          // Source-2 Register Address
-	int imm;          // Literal Value
+	int pc;           // Program Counter, pc of the micro-op in code memory
+	int rd;           // Destination Register Address, phys reg tag after rename
+	int rs1;          // Source-1 Register Address, phys reg tag after rename
+	int rs2;          // Source-2 Register Address, phys reg tag after rename
 	int rd_value;     // Destination Register Value
-	int rd_valid;     // Destination Register Value Valid
 	int rs1_value;    // Source-1 Register Value
-	int rs1_valid;    // Source-1 Register Value Valid
 	int rs2_value;    // Source-2 Register Value
-	int rs2_valid;    // Source-2 Register Value Valid
-	int buffer;       // Latch to hold some value (currently used to hold literal value from decode)
+	int buffer;       // Latch to hold some value (currently used to hold literal value from fetch)
 	int mem_address;  // Computed Memory Address
-	int inst_type;		// instruction type
-	int stalled;      // Flag to indicate, stage is stalled
-	int executed;     // Flag to indicate, stage has executed or not
-	int empty;        // Flag to indicate, stage is empty
 	int stage_cycle;  // Keep count of cycle for individual stage // used to Mem stage
 	int lsq_index;		// to address lSQ entry in issue queue
+	int rob_index;		// to address ROB entry directly at writeback
+	uint8_t inst_type;		// instruction type, kept so stages do not load code memory for it
+	uint8_t rd_valid;     // Destination Register Value Valid
+	uint8_t rs1_valid;    // Source-1 Register Value Valid
+	uint8_t rs2_valid;    // Source-2 Register Value Valid
+	uint8_t stalled;      // Flag to indicate, stage is stalled
+	uint8_t executed;     // Flag to indicate, stage has executed or not
+	uint8_t empty;        // Flag to indicate, stage is empty
 } CPU_Stage;
 
+_Static_assert(sizeof(CPU_Stage) <= 64, "CPU_Stage latch must fit in one cache line");
+
 /* Model of APEX CPU */
 typedef struct APEX_CPU {
 
-	int clock;		// clock cycles elasped
+	long long clock;		// clock cycles elasped
 	int pc;		// current program counter
 	int regs[REGISTER_FILE_SIZE];		// integer register file (ARF)
 	int regs_invalid[REGISTER_FILE_SIZE];		// integer register valid file (ARF)
-	CPU_Stage stage[NUM_STAGES];		// array of CPU_Stage struct. Note: use . in struct with variable names, use -> when its a pointer
-	APEX_Instruction* code_memory;		// struct pointer where instructions are stored
+	CPU_Stage stage[NUM_STAGES][MAX_WIDTH];		// lanes of CPU_Stage struct per stage. Note: use . in struct with variable names, use -> when its a pointer
+	const APEX_Instruction* code_memory;		// struct pointer where instructions are stored, read only so machines can share it
+	int owns_code_memory;		// code memory was parsed by this cpu and is freed with it
 	int flags[NUM_FLAG];
 	int code_memory_size;
 	int data_memory[DATA_MEMORY_SIZE];		// data cache memory
-	int ins_completed;		// instruction completed count
+	long long ins_completed;		// instruction completed count
+	long long functional_ins_completed;		// inst executed in functional mode, not part of clock or IPC
+	int verbose;		// runtime verbosity level
+	int fetch_width;		// inst fetched and decoded per cycle, lanes used in F and DRF
+	int dispatch_width;		// inst dispatched to IQ, LSQ, ROB per cycle
+	int issue_width;		// inst issued from IQ to FUs per cycle
+	int commit_width;		// inst committed from ROB per cycle
+	int int_units;		// lanes used in Int FU stages
+	int mul_units;		// lanes used in Mul FU stages
+	int result_buses;		// results broadcast by writeback per cycle
+	CPU_Stage* result_queue;		// results waiting for a result bus, one per ROB entry at most
+	int result_queue_size;		// same as ROB size
+	int result_head;		// oldest waiting result
+	int result_count;		// number of waiting results
+	int zf_tag;		// phys reg of youngest decoded inst which sets ZF, -1 once it committed
+	int zf_value;		// result of youngest committed inst which sets ZF
+	int mem_latency;		// cycles a LOAD/STORE spends in Mem FU
+	int fetch_stopped;		// fetch holds so in flight inst drain out, only set while draining
+	long long ins_limit;		// run stops once ins_completed reaches it, 0 for no limit
+	long long stall_cycles[NUM_STALL];		// cycles each stall cause held back an instruction
+	int cycle_stalls;		// bit per stall cause seen in current cycle
+	unsigned long cycle_heap_allocs;		// heap allocations made inside cycle loop, expected to stay 0
+	struct APEX_Checker* checker;		// golden model checking every commit, NULL when not checking
 } APEX_CPU;
 
 
-APEX_Instruction* create_code_memory(const char* filename, int* size);
+/* Changes whenever the same text parses to different code memory, cached programs of older versions are not used */
+#define PARSER_VERSION 3
 
-APEX_CPU* APEX_cpu_init(const char* filename);
+APEX_Instruction* create_code_memory(const char* filename, int* size, int** data_memory, int* data_memory_size);
+
+APEX_CPU* APEX_cpu_init(const char* filename, int verbose, const APEX_Config* config);
+
+APEX_CPU* APEX_cpu_init_from_code(const APEX_Instruction* code_memory, int code_memory_size, int verbose, const APEX_Config* config);
 
 int simulate(APEX_CPU* cpu, int num_cycle);
 
@@ -148,7 +251,9 @@ int display(APEX_CPU* cpu, int num_cycle);
 
 void print_cpu_content(APEX_CPU* cpu);
 
-int APEX_cpu_run(APEX_CPU* cpu, int num_cycle, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, APEX_RENAME* rename_table);
+void print_run_summary(APEX_CPU* cpu, double seconds);
+
+int APEX_cpu_run(APEX_CPU* cpu, long long num_cycle, APEX_LSQ* ls_queue, APEX_IQ* issue_queue, APEX_ROB* rob, APEX_RENAME* rename_table);
 
 void APEX_cpu_stop(APEX_CPU* cpu);
 
@@ -166,7 +271,7 @@ int mul_two_stage(APEX_CPU* cpu);
 
 int mul_three_stage(APEX_CPU* cpu);
 
-int branch_stage(APEX_CPU* cpu);
+int branch_stage(APEX_CPU* cpu, APEX_ROB* rob);
 
 int mem_stage(APEX_CPU* cpu);
 
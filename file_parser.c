@@ -10,247 +10,940 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "cpu.h"
+#include "forwarding.h"
+
+/* Bytes read from a stream at once, also the smallest chunk a mapped file is split into */
+#define PARSER_CHUNK_SIZE (1 << 20)
+/* Parsing stops after this many errors, the rest of the file is likely off too */
+#define MAX_PARSE_ERRORS 20
+/* Mapped files are split into chunks of at least PARSER_CHUNK_SIZE bytes, one thread each */
+#define MAX_PARSE_THREADS 64
 
 /*
- * This function is related to parsing input file
- *
- * Note : You are not supposed to edit this function
+ * ########################################## Opcodes ##########################################
 */
 
-static int get_num_from_string(char* buffer) {
+/* Opcode string, inst type and operands in order, d is rd, 1 is rs1, 2 is rs2 and i is the literal */
+typedef struct Opcode_Format {
+	const char* name;
+	int length;
+	int type;
+	const char* operands;
+} Opcode_Format;
 
-	char str[16];
-	int j = 0;
-	for (int i = 1; buffer[i] != '\0'; ++i) {
-		str[j] = buffer[i];
-		j++;
-	}
-	str[j] = '\0';
-	return atoi(str);
-}
 /*
- * To remove \n \r from instruction
+ * Perfect hash of the opcodes, no two of them land in the same slot
+ * Note : you can edit this table to add new instructions, a new opcode must get a free slot from get_opcode_hash
  */
-static char* remove_escape_sequences(char* buffer) {
+#define OPCODE_HASH_SIZE 32
+static const Opcode_Format opcode_table[OPCODE_HASH_SIZE] = {
+	[0] = {"SUB", 3, SUB, "d12"},
+	[1] = {"DIV", 3, DIV, "d12"},
+	[2] = {"LOAD", 4, LOAD, "d1i"},
+	[5] = {"ADDL", 4, ADDL, "d1i"},
+	[6] = {"EX-OR", 5, EXOR, "d12"},
+	[9] = {"OR", 2, OR, "d12"},
+	[10] = {"HALT", 4, HALT, ""},
+	[11] = {"NOP", 3, NOP, ""},
+	[12] = {"JUMP", 4, JUMP, "1i"},		// jump location is rs1 + literal
+	[13] = {"MOVC", 4, MOVC, "di"},
+	[14] = {"MOV", 3, MOV, "d1"},
+	[16] = {"AND", 3, AND, "d12"},
+	[19] = {"LDR", 3, LDR, "d12"},		// rd is destination and Mem[rs1 + rs2] is source
+	[20] = {"ADD", 3, ADD, "d12"},
+	[21] = {"BNZ", 3, BNZ, "i"},		// literal is relative to the pc of the branch
+	[22] = {"MUL", 3, MUL, "d12"},
+	[26] = {"STR", 3, STR, "d12"},		// rd is source and Mem[rs1 + rs2] is destination
+	[28] = {"BZ", 2, BZ, "i"},
+	[29] = {"SUBL", 4, SUBL, "d1i"},
+	[30] = {"STORE", 5, STORE, "d1i"},		// rd is source and Mem[rs1 + literal] is destination
+};
+
+
+static unsigned int get_opcode_hash(const char* name, size_t length) {
+	// first, second and last char and the length, length is at least 2
+	return ((unsigned char)name[0] + 6u * (unsigned char)name[1] + 22u * (unsigned char)name[length - 1] + (unsigned int)length) & (OPCODE_HASH_SIZE - 1);
+}
+
 
-	char array[strlen(buffer)];
-	for (int i=0; i<strlen(buffer);i++){
-		array[i] = buffer[i];
+static const Opcode_Format* find_opcode(const char* name, size_t length) {
+	if (length < 2) {
+		return NULL;
 	}
-	int r = strcspn(array, "\r");
-	int n = strcspn(array, "\n");
-	if (r < n) {
-		array[strcspn(array, "\r")] = '\0';
+	const Opcode_Format* format = &opcode_table[get_opcode_hash(name, length)];
+	if ((format->name)&&((size_t)format->length == length)&&(memcmp(format->name, name, length) == 0)) {
+		return format;
 	}
-	else {
-		array[strcspn(array, "\n")] = '\0';
+	return NULL;
+}
+
+
+/*
+ * ########################################## Line Parser ##########################################
+*/
+
+struct Symbol_Table;
+
+/* Where errors are reported and how many were seen */
+typedef struct Parse_Context {
+	const char* filename;
+	int line_number;
+	int errors;
+	int quiet;		// only count errors, parallel chunks are reparsed in order to report them
+	const struct Symbol_Table* symbols;		// labels literals can name, NULL for files without labels
+	int pc_index;		// code memory index of the inst being parsed, for branch offsets to labels
+} Parse_Context;
+
+
+static void report_parse_error(Parse_Context* context, const char* format, ...) {
+	// one line per error, file:line like a compiler so editors can jump to it
+	va_list args;
+	context->errors += 1;
+	if (context->quiet) {
+		return;
+	}
+	fprintf(stderr, "APEX_Parser : %s:%d: ", context->filename, context->line_number);
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+}
+
+
+static int is_blank(char c) {
+	return ((c == ' ')||(c == '\t')||(c == '\r'));
+}
+
+
+static int parse_number(const char* text, size_t length, long long min, long long max, int* value) {
+	// optional sign then decimal digits, nothing else
+	size_t i = 0;
+	int negative = 0;
+	if ((length > 0)&&((text[0] == '-')||(text[0] == '+'))) {
+		negative = (text[0] == '-');
+		i = 1;
+	}
+	if (i == length) {
+		return FAILURE;
+	}
+	long long number = 0;
+	for (; i<length; i++) {
+		if ((text[i] < '0')||(text[i] > '9')) {
+			return FAILURE;
+		}
+		number = (number * 10) + (text[i] - '0');
+		if (number > max - min) {
+			return FAILURE;
+		}
+	}
+	number = negative ? -number : number;
+	if ((number < min)||(number > max)) {
+		return FAILURE;
 	}
-	buffer = array;
-	return buffer;
+	*value = (int)number;
+	return SUCCESS;
 }
 
+
 /*
- * This function is related to parsing input file
- *
- * Note : you can edit this function to add new instructions
- */
-static void create_APEX_instruction(APEX_Instruction* ins, char* buffer) {
-
-	if (RUNNING_IN_WINDOWS) {
-		buffer = remove_escape_sequences(buffer); // NOTE: This function should only be used while running in windows
-	}
-	char* token = strtok(buffer, ",");
-	int token_num = 0;
-	char tokens[6][128];
-	while (token != NULL) {
-		strcpy(tokens[token_num], token);
-		// strcpy(tokens[token_num], remove_escape_sequences(token));
-		token_num++;
-		token = strtok(NULL, ",");
-	}
-
-	strcpy(ins->opcode, tokens[0]);
-
-	// for STORE instruction
-	if (strcmp(ins->opcode, "STORE") == 0) {
-		ins->rd = get_num_from_string(tokens[1]); // here rs1 is source and Mem[rs2 + imm] is destination
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->imm = get_num_from_string(tokens[3]);
-		ins->type = STORE;
-	}
-	// for STR instruction
-	else if (strcmp(ins->opcode, "STR") == 0) {
-		ins->rd = get_num_from_string(tokens[1]); // here rd is source and Mem[rs1 + rs2] is destination
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->type = STR;
-	}
-	// for LOAD instruction
-	else if (strcmp(ins->opcode, "LOAD") == 0) {
-		ins->rd = get_num_from_string(tokens[1]); // here rd is destination and Mem[rs1 + imm] is source
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->imm = get_num_from_string(tokens[3]);
-		ins->type = LOAD;
-	}
-	// for LDR instruction
-	else if (strcmp(ins->opcode, "LDR") == 0) {
-		ins->rd = get_num_from_string(tokens[1]); // here rd is destination and Mem[rs1 + rs2] is source
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->type = LDR;
-	}
-	// for MOVC instruction
-	else if (strcmp(ins->opcode, "MOVC") == 0) {
-		ins->rd = get_num_from_string(tokens[1]); // this is MOV Constant to Register
-		ins->imm = get_num_from_string(tokens[2]);
-		ins->type = MOVC;
-	}
-	// for MOV instruction
-	else if (strcmp(ins->opcode, "MOV") == 0) {
-		ins->rd = get_num_from_string(tokens[1]); // this is MOV One Register value to other Register
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->type = MOV;
-	}
-	// for ADD instruction
-	else if (strcmp(ins->opcode, "ADD") == 0) {
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->type = ADD;
-	}
-	// for ADDL instruction
-	else if (strcmp(ins->opcode, "ADDL") == 0) {
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->imm = get_num_from_string(tokens[3]);
-		ins->type = ADDL;
-	}
-	// for SUB instruction
-	else if (strcmp(ins->opcode, "SUB") == 0) {
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->type = SUB;
-	}
-	// for SUBL instruction
-	else if (strcmp(ins->opcode, "SUBL") == 0) {
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->imm = get_num_from_string(tokens[3]);
-		ins->type = SUBL;
-	}
-	// for MUL instruction
-	else if (strcmp(ins->opcode, "MUL") == 0) {
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->type = MUL;
-	}
-	// for DIV instruction
-	else if (strcmp(ins->opcode, "DIV") == 0) {
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->type = DIV;
-	}
-	// for AND instruction
-	else if (strcmp(ins->opcode, "AND") == 0) {
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->type = AND;
-	}
-	// for OR instruction
-	else if (strcmp(ins->opcode, "OR") == 0) {
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->type = OR;
-	}
-	// for EX-OR instruction
-	else if (strcmp(ins->opcode, "EX-OR") == 0) {
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->type = EXOR;
-	}
-	// for BZ instruction Variation 1 only literal
-	else if (strcmp(ins->opcode, "BZ") == 0) {
-		ins->imm = get_num_from_string(tokens[1]); // while executing our pc starts from 4000 so keep a relative index. // get_code_index() can be used with modifications
-		ins->type = BZ;
-	}
-	// for BNZ instruction Variation 1 only literal
-	else if (strcmp(ins->opcode, "BNZ") == 0) {
-		ins->imm = get_num_from_string(tokens[1]); // while executing our pc starts from 4000 so keep a relative index. // get_code_index() can be used with modifications
-		ins->type = BNZ;
-	}
-	else if (strcmp(ins->opcode, "JUMP") == 0) {
-		ins->rs1 = get_num_from_string(tokens[1]); // while executing our pc starts from 4000 so keep a relative index. // get_code_index() can be used with modifications
-		ins->imm = get_num_from_string(tokens[2]); // here jump location is giving by addidng rs1 + imm
-		ins->type = JUMP;
-	}
-	else if ((strcmp(ins->opcode, "HALT") == 0)||(strcmp(ins->opcode, "HALT\n") == 0)) {
-		ins->type = HALT;
-	}
-	else if ((strcmp(ins->opcode, "NOP") == 0)||(strcmp(ins->opcode, "NOP\n") == 0)) {
-		ins->type = NOP;
+ * ########################################## Symbols ##########################################
+*/
+
+/* Label and what it stands for, name points into the assembly text */
+typedef struct Symbol {
+	const char* name;
+	int length;
+	int value;		// code memory index of a .text label, data address of a .data label
+	int is_data;
+} Symbol;
+
+/* Open addressing table of labels, capacity is a power of 2 and at least twice count */
+typedef struct Symbol_Table {
+	Symbol* symbols;
+	int capacity;
+	int count;
+} Symbol_Table;
+
+
+static size_t get_name_length(const char* text, size_t length) {
+	// a label name is a letter or _ then letters, digits or _
+	size_t i = 0;
+	while ((i < length)&&(((text[i] >= 'a')&&(text[i] <= 'z'))||((text[i] >= 'A')&&(text[i] <= 'Z'))||(text[i] == '_')||((i > 0)&&(text[i] >= '0')&&(text[i] <= '9')))) {
+		i++;
+	}
+	return i;
+}
+
+
+static Symbol* find_symbol(const Symbol_Table* table, const char* name, size_t length) {
+	// slot holding the label, or the empty slot it would go in
+	unsigned int hash = 2166136261u;
+	for (size_t i=0; i<length; i++) {
+		hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+	}
+	unsigned int mask = (unsigned int)table->capacity - 1;
+	unsigned int slot = hash & mask;
+	while ((table->symbols[slot].name)&&(((size_t)table->symbols[slot].length != length)||(memcmp(table->symbols[slot].name, name, length) != 0))) {
+		slot = (slot + 1) & mask;
+	}
+	return &table->symbols[slot];
+}
+
+
+static int add_symbol(Symbol_Table* table, const char* name, size_t length, int value, int is_data) {
+	// ERROR when the label is already defined, FAILURE when out of memory
+	if ((table->count + 1) * 2 > table->capacity) {
+		Symbol_Table grown = {.capacity = (table->capacity > 0) ? table->capacity * 2 : 64};
+		grown.symbols = apex_calloc(grown.capacity, sizeof(Symbol));
+		if (!grown.symbols) {
+			return FAILURE;
+		}
+		for (int i=0; i<table->capacity; i++) {
+			if (table->symbols[i].name) {
+				*find_symbol(&grown, table->symbols[i].name, table->symbols[i].length) = table->symbols[i];
+			}
+		}
+		grown.count = table->count;
+		free(table->symbols);
+		*table = grown;
+	}
+	Symbol* symbol = find_symbol(table, name, length);
+	if (symbol->name) {
+		return ERROR;
+	}
+	symbol->name = name;
+	symbol->length = (int)length;
+	symbol->value = value;
+	symbol->is_data = is_data;
+	table->count += 1;
+	return SUCCESS;
+}
+
+
+static int parse_symbol_value(Parse_Context* context, const char* text, size_t length, int relative, int* value) {
+	// label, label+n or label-n, a .text label is its pc and relative ones count from the pc of the inst
+	// FAILURE when text is not a label expression, ERROR once an error is reported
+	size_t name_length = get_name_length(text, length);
+	int offset = 0;
+	if ((name_length == 0)||((name_length < length)&&(((text[name_length] != '+')&&(text[name_length] != '-'))||(parse_number(text + name_length, length - name_length, INT32_MIN, INT32_MAX, &offset) != SUCCESS)))) {
+		return FAILURE;
+	}
+	const Symbol* symbol = find_symbol(context->symbols, text, name_length);
+	if (!symbol->name) {
+		report_parse_error(context, "Undefined label '%.*s'", (int)name_length, text);
+		return ERROR;
+	}
+	long long result = (symbol->is_data) ? symbol->value : 4000LL + (4LL * symbol->value);
+	if (relative) {
+		if (symbol->is_data) {
+			report_parse_error(context, "Branch to data label '%.*s'", (int)name_length, text);
+			return ERROR;
+		}
+		result -= 4000LL + (4LL * context->pc_index);
+	}
+	result += offset;
+	if ((result < INT32_MIN)||(result > INT32_MAX)) {
+		report_parse_error(context, "'%.*s' does not fit in 32 bits", (int)length, text);
+		return ERROR;
+	}
+	*value = (int)result;
+	return SUCCESS;
+}
+
+
+static int parse_operand(Parse_Context* context, const Opcode_Format* format, char kind, const char* text, size_t length, APEX_Instruction* ins) {
+	// registers are R<n> below REGISTER_FILE_SIZE, literals are #<n> in 32 bits
+	int value = 0;
+	if (kind == 'i') {
+		// in files with labels a literal can also be label, label+n or label-n with or without #,
+		// BZ and BNZ get the offset to it
+		int ret = FAILURE;
+		int skip = ((length >= 2)&&(text[0] == '#')) ? 1 : 0;
+		if (skip) {
+			ret = parse_number(text + 1, length - 1, INT32_MIN, INT32_MAX, &value);
+		}
+		if ((ret != SUCCESS)&&(context->symbols)) {
+			ret = parse_symbol_value(context, text + skip, length - skip, (format->type == BZ)||(format->type == BNZ), &value);
+		}
+		if (ret == ERROR) {
+			return FAILURE;
+		}
+		if (ret != SUCCESS) {
+			report_parse_error(context, "%s expects a literal #<number>%s, found '%.*s'", format->name, (context->symbols) ? " or a label" : "", (int)length, text);
+			return FAILURE;
+		}
+		ins->imm = value;
+		return SUCCESS;
+	}
+	if ((length < 2)||((text[0] != 'R')&&(text[0] != 'r'))||(parse_number(text + 1, length - 1, 0, REGISTER_FILE_SIZE - 1, &value) != SUCCESS)) {
+		report_parse_error(context, "%s expects a register R0 to R%d, found '%.*s'", format->name, REGISTER_FILE_SIZE - 1, (int)length, text);
+		return FAILURE;
+	}
+	if (kind == 'd') {
+		ins->rd = value;
+	}
+	else if (kind == '1') {
+		ins->rs1 = value;
 	}
 	else {
-		if (strcmp(ins->opcode, "") != 0) {
-			fprintf(stderr, "Invalid Instruction Found!\n");
-			fprintf(stderr, "Replacing %s with %s Instruction\n", ins->opcode, "NOP");
-			strcpy(ins->opcode, "NOP");
-			ins->type = NOP;
+		ins->rs2 = value;
+	}
+	return SUCCESS;
+}
+
+
+static int parse_line(Parse_Context* context, const char* line, size_t length, APEX_Instruction* ins) {
+	// OPCODE,operand,... with blanks allowed around each field
+	// in files without labels a blank line still takes a pc slot as an empty inst, so branch offsets stay as written
+	memset(ins, 0, sizeof(*ins));
+	while ((length > 0)&&(is_blank(line[length - 1]))) {
+		length--;
+	}
+	size_t pos = 0;
+	while ((pos < length)&&(is_blank(line[pos]))) {
+		pos++;
+	}
+	if (pos == length) {
+		return SUCCESS;
+	}
+
+	size_t field_start = pos;
+	while ((pos < length)&&(line[pos] != ',')&&(!is_blank(line[pos]))) {
+		pos++;
+	}
+	const Opcode_Format* format = find_opcode(line + field_start, pos - field_start);
+	if (!format) {
+		report_parse_error(context, "Unknown opcode '%.*s'", (int)(pos - field_start), line + field_start);
+		return FAILURE;
+	}
+	ins->type = format->type;
+
+	int expected = (int)strlen(format->operands);
+	for (int i=0; i<expected; i++) {
+		while ((pos < length)&&(is_blank(line[pos]))) {
+			pos++;
+		}
+		if ((pos == length)||(line[pos] != ',')) {
+			report_parse_error(context, "%s takes %d operands, found %d", format->name, expected, i);
+			return FAILURE;
+		}
+		pos++;
+		while ((pos < length)&&(is_blank(line[pos]))) {
+			pos++;
+		}
+		field_start = pos;
+		while ((pos < length)&&(line[pos] != ',')) {
+			pos++;
+		}
+		size_t field_end = pos;
+		while ((field_end > field_start)&&(is_blank(line[field_end - 1]))) {
+			field_end--;
+		}
+		if (parse_operand(context, format, format->operands[i], line + field_start, field_end - field_start, ins) != SUCCESS) {
+			return FAILURE;
 		}
 	}
+	while ((pos < length)&&(is_blank(line[pos]))) {
+		pos++;
+	}
+	if (pos != length) {
+		report_parse_error(context, "%s takes %d operands, found more", format->name, expected);
+		return FAILURE;
+	}
+	return SUCCESS;
 }
 
+
 /*
- * This function is related to parsing input file
- *
- * Note : You are not supposed to edit this function
- */
-APEX_Instruction* create_code_memory(const char* filename, int* size) {
+ * ########################################## Parallel Chunks ##########################################
+*/
 
-	if (!filename) {
+/* Lines [first_line, first_line + lines) of a mapped file, from begin up to end */
+typedef struct Parse_Chunk {
+	const char* begin;
+	const char* end;
+	long long first_line;
+	long long lines;
+	int extended;		// has a label, comment or directive, the file goes to the assembler instead
+	APEX_Instruction* code_memory;		// shared, a chunk writes only its own lines
+	Parse_Context context;
+} Parse_Chunk;
+
+
+static void* count_chunk_lines(void* arg) {
+	// every line takes a pc slot, a last line without a newline too
+	Parse_Chunk* chunk = arg;
+	const char* pos = chunk->begin;
+	chunk->lines = 0;
+	while ((pos < chunk->end)&&((pos = memchr(pos, '\n', chunk->end - pos)) != NULL)) {
+		chunk->lines += 1;
+		pos += 1;
+	}
+	if ((chunk->end > chunk->begin)&&(chunk->end[-1] != '\n')) {
+		chunk->lines += 1;
+	}
+	size_t size = (size_t)(chunk->end - chunk->begin);
+	chunk->extended = (memchr(chunk->begin, ':', size) != NULL)||(memchr(chunk->begin, ';', size) != NULL)||(memchr(chunk->begin, '.', size) != NULL);
+	return NULL;
+}
+
+
+static void* parse_chunk(void* arg) {
+	// quiet chunks stop at the first error, the file is reparsed in order to report it
+	Parse_Chunk* chunk = arg;
+	Parse_Context* context = &chunk->context;
+	const char* line = chunk->begin;
+	context->line_number = (int)chunk->first_line;
+	for (long long i=0; (i<chunk->lines)&&(context->errors<((context->quiet) ? 1 : MAX_PARSE_ERRORS)); i++) {
+		const char* newline = memchr(line, '\n', chunk->end - line);
+		size_t length = (newline) ? (size_t)(newline - line) : (size_t)(chunk->end - line);
+		context->line_number += 1;
+		parse_line(context, line, length, &chunk->code_memory[chunk->first_line + i]);
+		line += length + 1;
+	}
+	return NULL;
+}
+
+
+static void run_chunks(Parse_Chunk* chunks, int num_chunks, void* (*function)(void*)) {
+	// chunk 0 runs on the calling thread, a chunk whose thread fails to start runs there too
+	pthread_t threads[MAX_PARSE_THREADS];
+	int started[MAX_PARSE_THREADS] = {0};
+	for (int i=1; i<num_chunks; i++) {
+		started[i] = (pthread_create(&threads[i], NULL, function, &chunks[i]) == 0);
+	}
+	for (int i=0; i<num_chunks; i++) {
+		if (!started[i]) {
+			function(&chunks[i]);
+		}
+	}
+	for (int i=1; i<num_chunks; i++) {
+		if (started[i]) {
+			pthread_join(threads[i], NULL);
+		}
+	}
+}
+
+
+static int get_parse_threads(size_t file_size) {
+	// one thread per core, but no chunk smaller than PARSER_CHUNK_SIZE
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t threads = file_size / PARSER_CHUNK_SIZE;
+	if ((cores > 0)&&(threads > (size_t)cores)) {
+		threads = (size_t)cores;
+	}
+	if (threads > MAX_PARSE_THREADS) {
+		threads = MAX_PARSE_THREADS;
+	}
+	return (threads < 1) ? 1 : (int)threads;
+}
+
+
+static APEX_Instruction* assemble_text(const char* filename, const char* text, size_t text_size, int* size, int** data_memory, int* data_memory_size);
+
+static APEX_Instruction* parse_text(const char* filename, const char* text, size_t text_size, int* size, int** data_memory, int* data_memory_size) {
+	// chunks end right after a newline, so lines are counted per chunk, code memory is allocated once
+	// and each chunk parses into its own range, the result does not depend on the thread count
+	// a file with labels, comments or directives is assembled in two passes on one thread instead
+	Parse_Chunk chunks[MAX_PARSE_THREADS];
+	int num_chunks = get_parse_threads(text_size);
+	const char* begin = text;
+	const char* text_end = text + text_size;
+	int used = 0;
+	for (int i=0; (i<num_chunks)&&(begin<text_end); i++) {
+		const char* end = (i == num_chunks - 1) ? text_end : text + (text_size / num_chunks) * (i + 1);
+		if (end < begin) {
+			end = begin;
+		}
+		const char* newline = memchr(end, '\n', text_end - end);
+		end = ((newline)&&(i < num_chunks - 1)) ? newline + 1 : text_end;
+		memset(&chunks[i], 0, sizeof(chunks[i]));
+		chunks[i].begin = begin;
+		chunks[i].end = end;
+		chunks[i].context.filename = filename;
+		chunks[i].context.quiet = 1;
+		begin = end;
+		used++;
+	}
+	num_chunks = used;
+	run_chunks(chunks, num_chunks, count_chunk_lines);
+	for (int i=0; i<num_chunks; i++) {
+		if (chunks[i].extended) {
+			return assemble_text(filename, text, text_size, size, data_memory, data_memory_size);
+		}
+	}
+
+	long long total_lines = 0;
+	for (int i=0; i<num_chunks; i++) {
+		chunks[i].first_line = total_lines;
+		total_lines += chunks[i].lines;
+	}
+	if ((total_lines < 1)||(total_lines > INT32_MAX)) {
+		fprintf(stderr, "APEX_Parser : %s: %lld lines, must be 1 to %d\n", filename, total_lines, INT32_MAX);
 		return NULL;
 	}
+	APEX_Instruction* code_memory = apex_malloc(sizeof(*code_memory) * (size_t)total_lines);
+	if (!code_memory) {
+		fprintf(stderr, "APEX_Parser : %s: Out of memory for %lld inst\n", filename, total_lines);
+		return NULL;
+	}
+	for (int i=0; i<num_chunks; i++) {
+		chunks[i].code_memory = code_memory;
+	}
+	run_chunks(chunks, num_chunks, parse_chunk);
 
-	FILE* fp = fopen(filename, "r");
-	if (!fp) {
+	int errors = 0;
+	for (int i=0; i<num_chunks; i++) {
+		errors += chunks[i].context.errors;
+	}
+	if (errors > 0) {
+		// slow path, the whole file again on one thread so errors print in line order
+		Parse_Chunk whole = {.begin = text, .end = text_end, .lines = total_lines, .code_memory = code_memory};
+		whole.context.filename = filename;
+		parse_chunk(&whole);
+		if (whole.context.errors >= MAX_PARSE_ERRORS) {
+			fprintf(stderr, "APEX_Parser : %s: Stopped after %d errors\n", filename, whole.context.errors);
+		}
+		free(code_memory);
 		return NULL;
 	}
+	*size = (int)total_lines;
+	return code_memory;
+}
 
-	char* line = NULL; // the address of the first character position where the input string will be stored.
-	size_t len = 0; // size_t is an unsigned integral data type
-	ssize_t nread; // ssize_t same as size_t but signed
-	int code_memory_size = 0; // for number of lines in a input files
 
-	while ((nread = getline(&line, &len, fp)) != -1) {
-		code_memory_size++;
-	}
-	*size = code_memory_size;
-	if (!code_memory_size) {
-		fclose(fp);
+
+
+/*
+ * ########################################## Assembler ##########################################
+*/
+
+/* .rept blocks nest this deep */
+#define MAX_REPT_DEPTH 16
+/* Lines walked with .rept blocks expanded, more is taken as a runaway .rept */
+#define MAX_ASSEMBLED_LINES (1LL << 28)
+
+/* Inst line kept by the first pass, without its label and comment */
+typedef struct Code_Line {
+	const char* text;
+	int length;
+	int line_number;
+} Code_Line;
+
+/* .word value naming a label, filled in once every label is known */
+typedef struct Data_Fixup {
+	const char* text;
+	int length;
+	int line_number;
+	int address;
+} Data_Fixup;
+
+/* Open .rept block, its body is walked again till remaining reaches 1, a skipped block has remaining 0 */
+typedef struct Rept_Frame {
+	const char* body;		// first byte after the .rept line
+	int line_number;		// of the .rept line
+	int remaining;
+} Rept_Frame;
+
+/* First pass state of a file with labels, comments or directives */
+typedef struct Assembler {
+	Parse_Context context;
+	Symbol_Table symbols;
+	Code_Line* code_lines;
+	int code_lines_size;
+	int code_lines_capacity;
+	Data_Fixup* fixups;
+	int fixups_size;
+	int fixups_capacity;
+	int* data_memory;		// DATA_MEMORY_SIZE words
+	int data_memory_size;
+	int in_data;		// between .data and the next .text
+	Rept_Frame rept[MAX_REPT_DEPTH];
+	int rept_depth;
+} Assembler;
+
+
+static void* grow_array(void* array, int* capacity, size_t item_size) {
+	// doubles capacity, NULL leaves array and capacity as they were
+	if (*capacity > INT32_MAX / 2) {
 		return NULL;
 	}
+	int new_capacity = (*capacity > 0) ? *capacity * 2 : 256;
+	void* grown = apex_realloc(array, item_size * (size_t)new_capacity);
+	if (grown) {
+		*capacity = new_capacity;
+	}
+	return grown;
+}
 
-	APEX_Instruction* code_memory = malloc(sizeof(*code_memory) * code_memory_size);  // APEX_Instruction struct pointer code_memory
-	if (!code_memory) {
-		fclose(fp);
+
+static size_t trim_blanks(const char** text, size_t length) {
+	while ((length > 0)&&(is_blank(**text))) {
+		(*text)++;
+		length--;
+	}
+	while ((length > 0)&&(is_blank((*text)[length - 1]))) {
+		length--;
+	}
+	return length;
+}
+
+
+static int is_directive(const char* name, size_t length, const char* directive) {
+	return (length == strlen(directive))&&(memcmp(name, directive, length) == 0);
+}
+
+
+static void define_label(Assembler* as, const char* name, size_t length) {
+	// a .text label is the index of the next inst, a .data label the address of the next data word
+	int value = (as->in_data) ? as->data_memory_size : as->code_lines_size;
+	int ret = add_symbol(&as->symbols, name, length, value, as->in_data);
+	if (ret == ERROR) {
+		report_parse_error(&as->context, "Label '%.*s' is already defined", (int)length, name);
+	}
+	else if (ret != SUCCESS) {
+		report_parse_error(&as->context, "Out of memory for label '%.*s'", (int)length, name);
+	}
+}
+
+
+static void add_code_line(Assembler* as, const char* text, size_t length) {
+	if (as->code_lines_size == as->code_lines_capacity) {
+		Code_Line* grown = grow_array(as->code_lines, &as->code_lines_capacity, sizeof(Code_Line));
+		if (!grown) {
+			report_parse_error(&as->context, "Out of memory for %d inst", as->code_lines_size + 1);
+			return;
+		}
+		as->code_lines = grown;
+	}
+	Code_Line* code_line = &as->code_lines[as->code_lines_size++];
+	code_line->text = text;
+	code_line->length = (int)length;
+	code_line->line_number = as->context.line_number;
+}
+
+
+static int add_data_word(Assembler* as, const char* text, size_t length) {
+	// a number, or a label which is looked up after the first pass
+	int value = 0;
+	if (as->data_memory_size == DATA_MEMORY_SIZE) {
+		report_parse_error(&as->context, "More than %d data words", DATA_MEMORY_SIZE);
+		return FAILURE;
+	}
+	if (parse_number(text, length, INT32_MIN, INT32_MAX, &value) != SUCCESS) {
+		if (get_name_length(text, length) == 0) {
+			report_parse_error(&as->context, ".word expects a number or a label, found '%.*s'", (int)length, text);
+			return FAILURE;
+		}
+		if (as->fixups_size == as->fixups_capacity) {
+			Data_Fixup* grown = grow_array(as->fixups, &as->fixups_capacity, sizeof(Data_Fixup));
+			if (!grown) {
+				report_parse_error(&as->context, "Out of memory for '%.*s'", (int)length, text);
+				return FAILURE;
+			}
+			as->fixups = grown;
+		}
+		Data_Fixup* fixup = &as->fixups[as->fixups_size++];
+		fixup->text = text;
+		fixup->length = (int)length;
+		fixup->line_number = as->context.line_number;
+		fixup->address = as->data_memory_size;
+	}
+	as->data_memory[as->data_memory_size++] = value;
+	return SUCCESS;
+}
+
+
+static void run_directive(Assembler* as, const char* line, size_t length, const char** pos, int* line_number) {
+	// .rept and .endr move pos back to the start of the block to walk it again
+	size_t name_length = 1;
+	while ((name_length < length)&&(!is_blank(line[name_length]))) {
+		name_length++;
+	}
+	const char* args = line + name_length;
+	size_t args_length = trim_blanks(&args, length - name_length);
+	Rept_Frame* top = (as->rept_depth > 0) ? &as->rept[as->rept_depth - 1] : NULL;
+	int skipping = (top)&&(top->remaining == 0);
+	int value = 0;
+
+	if (is_directive(line, name_length, ".rept")) {
+		if (as->rept_depth == MAX_REPT_DEPTH) {
+			report_parse_error(&as->context, "More than %d nested .rept blocks", MAX_REPT_DEPTH);
+		}
+		else if ((!skipping)&&(parse_number(args, args_length, 0, INT32_MAX, &value) != SUCCESS)) {
+			report_parse_error(&as->context, ".rept expects a count of 0 or more, found '%.*s'", (int)args_length, args);
+		}
+		else {
+			Rept_Frame* frame = &as->rept[as->rept_depth++];
+			frame->body = *pos;
+			frame->line_number = *line_number;
+			frame->remaining = value;
+		}
+	}
+	else if (is_directive(line, name_length, ".endr")) {
+		if (!top) {
+			report_parse_error(&as->context, ".endr without .rept");
+		}
+		else if (top->remaining > 1) {
+			top->remaining--;
+			*pos = top->body;
+			*line_number = top->line_number;
+		}
+		else {
+			as->rept_depth--;
+		}
+	}
+	else if (skipping) {
+		// inside .rept 0
+	}
+	else if ((is_directive(line, name_length, ".text"))||(is_directive(line, name_length, ".data"))) {
+		if (args_length > 0) {
+			report_parse_error(&as->context, "%.*s takes no operands", (int)name_length, line);
+		}
+		as->in_data = (line[1] == 'd');
+	}
+	else if ((!is_directive(line, name_length, ".word"))&&(!is_directive(line, name_length, ".fill"))) {
+		report_parse_error(&as->context, "Unknown directive '%.*s'", (int)name_length, line);
+	}
+	else if (!as->in_data) {
+		report_parse_error(&as->context, "%.*s goes after .data", (int)name_length, line);
+	}
+	else if (line[1] == 'w') {
+		// .word value,value,...
+		while (1) {
+			const char* comma = memchr(args, ',', args_length);
+			const char* field = args;
+			size_t field_length = trim_blanks(&field, (comma) ? (size_t)(comma - args) : args_length);
+			if (add_data_word(as, field, field_length) != SUCCESS) {
+				return;
+			}
+			if (!comma) {
+				return;
+			}
+			args_length -= (size_t)(comma + 1 - args);
+			args = comma + 1;
+		}
+	}
+	else {
+		// .fill count[,value]
+		const char* comma = memchr(args, ',', args_length);
+		const char* field = args;
+		size_t count_length = trim_blanks(&field, (comma) ? (size_t)(comma - args) : args_length);
+		int count = 0;
+		if (parse_number(field, count_length, 0, DATA_MEMORY_SIZE, &count) != SUCCESS) {
+			report_parse_error(&as->context, ".fill expects a count of 0 to %d, found '%.*s'", DATA_MEMORY_SIZE, (int)count_length, field);
+			return;
+		}
+		const char* value_text = "0";
+		size_t value_length = 1;
+		if (comma) {
+			value_text = comma + 1;
+			value_length = trim_blanks(&value_text, args_length - (size_t)(comma + 1 - args));
+		}
+		for (int i=0; i<count; i++) {
+			if (add_data_word(as, value_text, value_length) != SUCCESS) {
+				return;
+			}
+		}
+	}
+}
+
+
+static void scan_text(Assembler* as, const char* text, size_t text_size) {
+	// first pass, labels get their inst index or data address and inst lines are kept for the second pass
+	// blank, comment, label only and directive lines take no pc slot
+	const char* pos = text;
+	const char* text_end = text + text_size;
+	int line_number = 0;
+	long long walked = 0;
+	while ((pos < text_end)&&(as->context.errors < MAX_PARSE_ERRORS)) {
+		const char* line = pos;
+		const char* newline = memchr(pos, '\n', text_end - pos);
+		size_t length = (newline) ? (size_t)(newline - pos) : (size_t)(text_end - pos);
+		pos = (newline) ? newline + 1 : text_end;
+		line_number += 1;
+		as->context.line_number = line_number;
+		if (++walked > MAX_ASSEMBLED_LINES) {
+			report_parse_error(&as->context, "More than %lld lines with .rept blocks expanded", MAX_ASSEMBLED_LINES);
+			return;
+		}
+
+		const char* comment = memchr(line, ';', length);
+		if (comment) {
+			length = (size_t)(comment - line);
+		}
+		length = trim_blanks(&line, length);
+		int skipping = (as->rept_depth > 0)&&(as->rept[as->rept_depth - 1].remaining == 0);
+		size_t name_length = get_name_length(line, length);
+		if ((name_length > 0)&&(name_length < length)&&(line[name_length] == ':')) {
+			if (!skipping) {
+				define_label(as, line, name_length);
+			}
+			line += name_length + 1;
+			length = trim_blanks(&line, length - name_length - 1);
+		}
+		if (length == 0) {
+			continue;
+		}
+		if (line[0] == '.') {
+			run_directive(as, line, length, &pos, &line_number);
+		}
+		else if (skipping) {
+			// inside .rept 0
+		}
+		else if (as->in_data) {
+			report_parse_error(&as->context, "Inst in .data, add .text before it");
+		}
+		else {
+			add_code_line(as, line, length);
+		}
+	}
+	if ((as->rept_depth > 0)&&(as->context.errors < MAX_PARSE_ERRORS)) {
+		as->context.line_number = as->rept[as->rept_depth - 1].line_number;
+		report_parse_error(&as->context, ".rept without .endr");
+	}
+}
+
+
+static APEX_Instruction* assemble_text(const char* filename, const char* text, size_t text_size, int* size, int** data_memory, int* data_memory_size) {
+	// the first pass finds labels, data words and inst lines, the second parses inst lines with every label known
+	Assembler as;
+	memset(&as, 0, sizeof(as));
+	as.context.filename = filename;
+	as.symbols.capacity = 64;
+	as.symbols.symbols = apex_calloc(as.symbols.capacity, sizeof(Symbol));
+	as.data_memory = apex_calloc(DATA_MEMORY_SIZE, sizeof(int));
+	APEX_Instruction* code_memory = NULL;
+	if ((as.symbols.symbols)&&(as.data_memory)) {
+		scan_text(&as, text, text_size);
+		if ((as.context.errors == 0)&&(as.code_lines_size == 0)) {
+			fprintf(stderr, "APEX_Parser : %s: No inst in .text\n", filename);
+			as.context.errors += 1;
+		}
+		if (as.context.errors == 0) {
+			code_memory = apex_malloc(sizeof(*code_memory) * (size_t)as.code_lines_size);
+			as.context.errors += (code_memory) ? 0 : 1;
+		}
+	}
+	else {
+		as.context.errors += 1;
+	}
+
+	as.context.symbols = &as.symbols;
+	for (int i=0; (code_memory)&&(i<as.code_lines_size)&&(as.context.errors<MAX_PARSE_ERRORS); i++) {
+		as.context.line_number = as.code_lines[i].line_number;
+		as.context.pc_index = i;
+		parse_line(&as.context, as.code_lines[i].text, as.code_lines[i].length, &code_memory[i]);
+	}
+	for (int i=0; (code_memory)&&(i<as.fixups_size)&&(as.context.errors<MAX_PARSE_ERRORS); i++) {
+		const Data_Fixup* fixup = &as.fixups[i];
+		as.context.line_number = fixup->line_number;
+		if (parse_symbol_value(&as.context, fixup->text, fixup->length, 0, &as.data_memory[fixup->address]) == FAILURE) {
+			report_parse_error(&as.context, ".word expects a number or a label, found '%.*s'", fixup->length, fixup->text);
+		}
+	}
+	if (as.context.errors >= MAX_PARSE_ERRORS) {
+		fprintf(stderr, "APEX_Parser : %s: Stopped after %d errors\n", filename, as.context.errors);
+	}
+
+	free(as.symbols.symbols);
+	free(as.code_lines);
+	free(as.fixups);
+	if (as.context.errors > 0) {
+		free(code_memory);
+		free(as.data_memory);
 		return NULL;
 	}
+	if ((data_memory)&&(as.data_memory_size > 0)) {
+		*data_memory = as.data_memory;
+		*data_memory_size = as.data_memory_size;
+	}
+	else {
+		free(as.data_memory);
+	}
+	*size = as.code_lines_size;
+	return code_memory;
+}
+
 
-	rewind(fp); // fb is not closed yet, rewind sets the file position to the beginning of the file
-	int current_instruction = 0;
-	while ((nread = getline(&line, &len, fp)) != -1) {
-		create_APEX_instruction(&code_memory[current_instruction], line);
-		current_instruction++;
+/*
+ * ########################################## Code Memory ##########################################
+*/
+
+static char* read_stream(FILE* fp, size_t* text_size) {
+	// a file which cannot be mapped, eg: a pipe, is read whole and then parsed like a mapped one
+	size_t capacity = PARSER_CHUNK_SIZE;
+	char* text = apex_malloc(capacity);
+	*text_size = 0;
+	while (text) {
+		*text_size += fread(text + *text_size, 1, capacity - *text_size, fp);
+		if (*text_size < capacity) {
+			break;
+		}
+		char* grown = apex_realloc(text, capacity * 2);
+		if (!grown) {
+			free(text);
+		}
+		text = grown;
+		capacity *= 2;
+	}
+	if ((text)&&(ferror(fp))) {
+		fprintf(stderr, "APEX_Parser : Read error\n");
+		free(text);
+		text = NULL;
 	}
+	return text;
+}
 
-	free(line);
+
+APEX_Instruction* create_code_memory(const char* filename, int* size, int** data_memory, int* data_memory_size) {
+	// regular files are mapped, anything else is read whole, any error fails the whole file
+	// data_memory gets the words of a .data section, NULL when there is none or data_memory is NULL
+	*size = 0;
+	if (data_memory) {
+		*data_memory = NULL;
+		*data_memory_size = 0;
+	}
+	if (!filename) {
+		return NULL;
+	}
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	struct stat file_stat;
+	if ((fstat(fd, &file_stat) == 0)&&(S_ISREG(file_stat.st_mode))) {
+		size_t file_size = (size_t)file_stat.st_size;
+		void* text = (file_size > 0) ? mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		close(fd);
+		if (text == MAP_FAILED) {
+			return NULL;
+		}
+		APEX_Instruction* code_memory = parse_text(filename, text, file_size, size, data_memory, data_memory_size);
+		munmap(text, file_size);
+		return code_memory;
+	}
+	FILE* fp = fdopen(fd, "r");
+	if (!fp) {
+		close(fd);
+		return NULL;
+	}
+	size_t text_size = 0;
+	char* text = read_stream(fp, &text_size);
 	fclose(fp);
+	if (!text) {
+		return NULL;
+	}
+	APEX_Instruction* code_memory = parse_text(filename, text, text_size, size, data_memory, data_memory_size);
+	free(text);
 	return code_memory;
 }
@@ -14,140 +14,161 @@
 #include "forwarding.h"
 
 
+__thread unsigned long apex_heap_allocs = 0;  // per thread so concurrent machines count only their own
 
-void get_inst_name(int inst_type, char* inst_type_str) {
+
+void* apex_malloc(size_t size) {
+	apex_heap_allocs += 1;
+	return malloc(size);
+}
+
+
+void* apex_calloc(size_t count, size_t size) {
+	apex_heap_allocs += 1;
+	return calloc(count, size);
+}
+
+
+void* apex_realloc(void* ptr, size_t size) {
+	apex_heap_allocs += 1;
+	return realloc(ptr, size);
+}
+
+
+const char* get_inst_name(int inst_type) {
 
 	switch (inst_type) {
 
 		case STORE:
-			strcpy(inst_type_str, "STORE");
-			break;
+			return "STORE";
 		case STR:
-			strcpy(inst_type_str, "STR");
-			break;
+			return "STR";
 		case LOAD:
-			strcpy(inst_type_str, "LOAD");
-			break;
+			return "LOAD";
 		case LDR:
-			strcpy(inst_type_str, "LDR");
-			break;
+			return "LDR";
 		case MOVC:
-			strcpy(inst_type_str, "MOVC");
-			break;
+			return "MOVC";
 		case MOV:
-			strcpy(inst_type_str, "MOV");
-			break;
+			return "MOV";
 		case ADD:
-			strcpy(inst_type_str, "ADD");
-			break;
+			return "ADD";
 		case ADDL:
-			strcpy(inst_type_str, "ADDL");
-			break;
+			return "ADDL";
 		case SUB:
-			strcpy(inst_type_str, "SUB");
-			break;
+			return "SUB";
 		case SUBL:
-			strcpy(inst_type_str, "SUBL");
-			break;
+			return "SUBL";
 		case MUL:
-			strcpy(inst_type_str, "MUL");
-			break;
+			return "MUL";
 		case DIV:
-			strcpy(inst_type_str, "DIV");
-			break;
+			return "DIV";
 		case AND:
-			strcpy(inst_type_str, "AND");
-			break;
+			return "AND";
 		case OR:
-			strcpy(inst_type_str, "OR");
-			break;
+			return "OR";
 		case EXOR:
-			strcpy(inst_type_str, "EX-OR");
-			break;
+			return "EX-OR";
 		case BZ:
-			strcpy(inst_type_str, "BZ");
-			break;
+			return "BZ";
 		case BNZ:
-			strcpy(inst_type_str, "BNZ");
-			break;
+			return "BNZ";
 		case JUMP:
-			strcpy(inst_type_str, "JUMP");
-			break;
+			return "JUMP";
 		case HALT:
-			strcpy(inst_type_str, "HALT");
-			break;
+			return "HALT";
 		case NOP:
-			strcpy(inst_type_str, "NOP");
-			break;
+			return "NOP";
 		default:
-			strcpy(inst_type_str, "INVALID");
-			break;
+			return "INVALID";
 	}
 }
 
 
-void clear_stage_entry(APEX_CPU* cpu, int stage_index){
+void clear_stage_lane(CPU_Stage* stage) {
 	// this is to clear any previous entries in stage and avoid conflicts between diff instructions
-	cpu->stage[stage_index].rd = INVALID;
-	cpu->stage[stage_index].rd_valid = INVALID;;
-	cpu->stage[stage_index].rs1 = INVALID;
-	cpu->stage[stage_index].rs1_valid = INVALID;
-	cpu->stage[stage_index].rs2 = INVALID;
-	cpu->stage[stage_index].rs2_valid = INVALID;
-	cpu->stage[stage_index].inst_type = INVALID;
-	cpu->stage[stage_index].pc = INVALID;
-	cpu->stage[stage_index].empty = VALID;
-	cpu->stage[stage_index].stage_cycle = INVALID;
-	strcpy(cpu->stage[stage_index].opcode, "");
+	stage->rd = INVALID;
+	stage->rd_valid = INVALID;
+	stage->rs1 = INVALID;
+	stage->rs1_valid = INVALID;
+	stage->rs2 = INVALID;
+	stage->rs2_valid = INVALID;
+	stage->inst_type = INVALID;
+	stage->pc = INVALID;
+	stage->empty = VALID;
+	stage->stage_cycle = INVALID;
+	stage->rob_index = INVALID;
+}
+
+
+void clear_stage_entry(APEX_CPU* cpu, int stage_index){
+	// clear every lane of the stage
+	for (int lane=0; lane<MAX_WIDTH; lane++) {
+		clear_stage_lane(&cpu->stage[stage_index][lane]);
+	}
 }
 
 
 void add_bubble_to_stage(APEX_CPU* cpu, int stage_index) {
 	// Add bubble to cpu stage
 	clear_stage_entry(cpu, stage_index);
-	strcpy(cpu->stage[stage_index].opcode, "NOP"); // add a Bubble
-	cpu->stage[stage_index].inst_type = NOP;
+	cpu->stage[stage_index][0].inst_type = NOP; // add a Bubble
 	cpu->code_memory_size = cpu->code_memory_size + 1;
-	cpu->stage[stage_index].empty = 0;
+	cpu->stage[stage_index][0].empty = 0;
+}
+
+
+static int is_stage_group_empty(APEX_CPU* cpu, int stage_index) {
+	for (int lane=0; lane<MAX_WIDTH; lane++) {
+		if (!cpu->stage[stage_index][lane].empty) {
+			return 0;
+		}
+	}
+	return 1;
 }
 
 
 void push_func_unit_stages(APEX_CPU* cpu, int after_iq){
 
 	if (after_iq) {
-		cpu->stage[MUL_THREE] = cpu->stage[MUL_TWO];
-		cpu->stage[MUL_TWO] = cpu->stage[MUL_ONE];
-		// and empty the MUL_ONE stage
-		clear_stage_entry(cpu, MUL_ONE);
+		for (int lane=0; lane<cpu->mul_units; lane++) {
+			cpu->stage[MUL_THREE][lane] = cpu->stage[MUL_TWO][lane];
+			cpu->stage[MUL_TWO][lane] = cpu->stage[MUL_ONE][lane];
+			// and empty the MUL_ONE stage
+			clear_stage_lane(&cpu->stage[MUL_ONE][lane]);
+		}
 
-		cpu->stage[INT_TWO] = cpu->stage[INT_ONE];
-		// and empty the MUL_ONE stage
-		clear_stage_entry(cpu, INT_ONE);
+		for (int lane=0; lane<cpu->int_units; lane++) {
+			cpu->stage[INT_TWO][lane] = cpu->stage[INT_ONE][lane];
+			// and empty the INT_ONE stage
+			clear_stage_lane(&cpu->stage[INT_ONE][lane]);
+		}
 
-		if ((cpu->stage[MEM].executed)&&(cpu->stage[MEM].stage_cycle>=3)) {
+		if ((cpu->stage[MEM][0].executed)&&(cpu->stage[MEM][0].stage_cycle>=cpu->mem_latency)) {
 			// and empty the MEM stage
 			clear_stage_entry(cpu, MEM);
 		}
 
-		if (cpu->stage[BRANCH].executed) {
+		if (cpu->stage[BRANCH][0].executed) {
 			// and empty the BRANCH stage
 			clear_stage_entry(cpu, BRANCH);
 		}
 
 	}
 	else {
-		if (!cpu->stage[F].stalled) {
-			clear_stage_entry(cpu, DRF);
-			cpu->stage[DRF] = cpu->stage[F];
-			cpu->stage[DRF].executed = 0;
-		}
-		else if (cpu->stage[F].stalled) {
-			if (cpu->stage[BRANCH].empty) {
-				cpu->stage[F].stalled = INVALID;
+		if (!cpu->stage[F][0].stalled) {
+			// whole fetch group moves only once every DRF lane is dispatched
+			if (is_stage_group_empty(cpu, DRF)) {
+				for (int lane=0; lane<MAX_WIDTH; lane++) {
+					cpu->stage[DRF][lane] = cpu->stage[F][lane];
+					cpu->stage[DRF][lane].executed = 0;
+				}
+				clear_stage_entry(cpu, F);
 			}
 		}
-		else {
-			add_bubble_to_stage(cpu, DRF);
+		else if ((cpu->stage[BRANCH][0].empty)&&(!cpu->flags[IF])) {
+			// branch redirect is done, HALT keeps fetch stalled
+			cpu->stage[F][0].stalled = INVALID;
 		}
 	}
 }
@@ -164,7 +185,7 @@ int get_reg_values(APEX_CPU* cpu, int src_reg) {
 int get_reg_status(APEX_CPU* cpu, int reg_number) {
 	// Get Reg Status function
 	int status = 1; // 1 is invalid and 0 is valid
-	if (reg_number > REGISTER_FILE_SIZE) {
+	if ((reg_number < 0)||(reg_number >= REGISTER_FILE_SIZE)) {
 		// Segmentation fault
 		fprintf(stderr, "Segmentation fault for Register location :: %d\n", reg_number);
 	}
@@ -178,7 +199,7 @@ int get_reg_status(APEX_CPU* cpu, int reg_number) {
 void set_reg_status(APEX_CPU* cpu, int reg_number, int status) {
 	// Set Reg Status function
 	// NOTE: insted of set inc or dec regs_invalid
-	if (reg_number > REGISTER_FILE_SIZE) {
+	if ((reg_number < 0)||(reg_number >= REGISTER_FILE_SIZE)) {
 		// Segmentation fault
 		fprintf(stderr, "Segmentation fault for Register location :: %d\n", reg_number);
 	}
@@ -193,20 +214,19 @@ int previous_arithmetic_check(APEX_CPU* cpu, int func_unit) {
 	int status = 0;
 	int a = 0;
 	for (int i=a;i<func_unit; i++) {
-		if (strcmp(cpu->stage[i].opcode, "NOP") != 0) {
+		if (cpu->stage[i][0].inst_type != NOP) {
 			a = i;
 			break;
 		}
 	}
 
 	if (a!=0){
-		if ((strcmp(cpu->stage[a].opcode, "ADD") == 0) ||
-			(strcmp(cpu->stage[a].opcode, "ADDL") == 0) ||
-			(strcmp(cpu->stage[a].opcode, "SUB") == 0) ||
-			(strcmp(cpu->stage[a].opcode, "SUBL") == 0) ||
-			(strcmp(cpu->stage[a].opcode, "MUL") == 0) || (strcmp(cpu->stage[a].opcode, "DIV") == 0)) {
-
-			status = 1;
+		switch (cpu->stage[a][0].inst_type) {
+			case ADD: case ADDL: case SUB: case SUBL: case MUL: case DIV:
+				status = 1;
+				break;
+			default:
+				break;
 		}
 	}
 
@@ -10,6 +10,8 @@
 */
 
 
+#include <stddef.h>
+
 #include "cpu.h"
 
 /* Format of an APEX Forward mechanism  */
@@ -21,7 +23,14 @@ typedef struct APEX_Forward {
 	int unstall;
 } APEX_Forward;
 
-void get_inst_name(int inst_type, char* inst_type_str);
+/* Every heap allocation of the simulator goes through these, so the cycle loop can be checked to make none */
+extern __thread unsigned long apex_heap_allocs;
+void* apex_malloc(size_t size);
+void* apex_calloc(size_t count, size_t size);
+void* apex_realloc(void* ptr, size_t size);
+
+const char* get_inst_name(int inst_type);
+void clear_stage_lane(CPU_Stage* stage);
 void clear_stage_entry(APEX_CPU* cpu, int stage_index);
 void add_bubble_to_stage(APEX_CPU* cpu, int stage_index);
 void push_func_unit_stages(APEX_CPU* cpu, int after_iq);
@@ -0,0 +1,262 @@
+/*
+ *  functional.c
+ *  Contains APEX functional (ISA only) execution, no IQ, LSQ, ROB or rename
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "cpu.h"
+#include "functional.h"
+#include "forwarding.h"
+
+/*
+ * ########################################## Code Check ##########################################
+*/
+
+int APEX_functional_check(const APEX_CPU* cpu) {
+	// reg numbers index the arch reg file directly, so they are checked once before running
+	for (int i=0; i<cpu->code_memory_size; i++) {
+		const APEX_Instruction* ins = &cpu->code_memory[i];
+		if ((ins->rd >= REGISTER_FILE_SIZE)||(ins->rs1 >= REGISTER_FILE_SIZE)||(ins->rs2 >= REGISTER_FILE_SIZE)) {
+			fprintf(stderr, "Functional Invalid Register in %s at pc(%d)\n", get_inst_name(ins->type), 4000 + (i * 4));
+			return ERROR;
+		}
+	}
+	return SUCCESS;
+}
+
+
+/*
+ * ########################################## Functional Run ##########################################
+*/
+
+int APEX_functional_run(APEX_CPU* cpu, long long max_instructions) {
+	// executes in program order on arch regs, flags, data memory and pc with the same semantics
+	// as the Int, Mul, Branch and Mem FUs, ZF for BZ and BNZ is the result of the last inst which sets it
+	// returns HALT once HALT executes, SUCCESS after max_instructions, EMPTY when pc leaves code memory
+	if (APEX_functional_check(cpu) != SUCCESS) {
+		return ERROR;
+	}
+	return APEX_functional_run_checked(cpu, max_instructions);
+}
+
+
+int APEX_functional_run_checked(APEX_CPU* cpu, long long max_instructions) {
+	// same as APEX_functional_run for code memory which already passed APEX_functional_check
+	// cheap enough to be called for a single inst
+
+	// one label per inst type, each handler jumps straight to the handler of the next inst
+	static const void* const dispatch_table[] = {
+		[0] = &&op_end, [STORE] = &&op_store, [STR] = &&op_str, [LOAD] = &&op_load, [LDR] = &&op_ldr,
+		[MOVC] = &&op_movc, [MOV] = &&op_mov, [ADD] = &&op_add, [ADDL] = &&op_addl, [SUB] = &&op_sub,
+		[SUBL] = &&op_subl, [MUL] = &&op_mul, [DIV] = &&op_div, [AND] = &&op_and, [OR] = &&op_or,
+		[EXOR] = &&op_exor, [BZ] = &&op_bz, [BNZ] = &&op_bnz, [JUMP] = &&op_jump, [HALT] = &&op_halt,
+		[NOP] = &&op_nop};
+	_Static_assert(NOP < 255, "inst type must fit the dispatch table");
+
+	const APEX_Instruction* code = cpu->code_memory;
+	const int code_size = cpu->code_memory_size;
+	const APEX_Instruction* ins = NULL;
+	int* regs = cpu->regs;
+	int* data_memory = cpu->data_memory;
+	int zf_value = cpu->zf_value;
+	long long executed = 0;
+	int ret = SUCCESS;
+	int pc = cpu->pc;
+	int new_pc = 0;
+	int address = 0;
+	int value = 0;
+
+	// pc stays a byte address so branch targets are checked the same way as in Branch FU
+#define FUNC_NEXT() \
+	do { \
+		pc += 4; \
+		FUNC_DISPATCH(); \
+	} while (0)
+#define FUNC_DISPATCH() \
+	do { \
+		if ((pc < 4000)||(((pc - 4000) >> 2) >= code_size)) { \
+			goto op_end; \
+		} \
+		ins = code + ((pc - 4000) >> 2); \
+		if (executed == max_instructions) { \
+			goto op_limit; \
+		} \
+		if (ins->type > NOP) { \
+			goto op_end; \
+		} \
+		goto *dispatch_table[ins->type]; \
+	} while (0)
+#define FUNC_SET_ZF(result) \
+	do { \
+		zf_value = (result); \
+		cpu->flags[ZF] = (zf_value == 0) ? 1 : 0; \
+	} while (0)
+
+	FUNC_DISPATCH();
+
+op_store:
+	address = regs[ins->rs1] + ins->imm;
+	value = regs[ins->rd];
+	goto mem_write;
+op_str:
+	address = regs[ins->rs1] + regs[ins->rs2];
+	value = regs[ins->rd];
+mem_write:
+	executed++;
+	if ((address < 0)||(address >= DATA_MEMORY_SIZE)) {
+		fprintf(stderr, "Segmentation fault for writing memory location :: %d\n", address);
+	}
+	else {
+		data_memory[address] = value;
+	}
+	FUNC_NEXT();
+op_load:
+	address = regs[ins->rs1] + ins->imm;
+	goto mem_read;
+op_ldr:
+	address = regs[ins->rs1] + regs[ins->rs2];
+mem_read:
+	executed++;
+	if ((address < 0)||(address >= DATA_MEMORY_SIZE)) {
+		fprintf(stderr, "Segmentation fault for accessing memory location :: %d\n", address);
+	}
+	else {
+		regs[ins->rd] = data_memory[address];
+	}
+	FUNC_NEXT();
+op_movc:
+	executed++;
+	regs[ins->rd] = ins->imm;
+	FUNC_NEXT();
+op_mov:
+	executed++;
+	regs[ins->rd] = regs[ins->rs1];
+	FUNC_NEXT();
+op_add:
+	value = regs[ins->rs2];
+	goto add_value;
+op_addl:
+	value = ins->imm;
+add_value:
+	executed++;
+	if (__builtin_add_overflow(regs[ins->rs1], value, &value)) {
+		// like Int FU the result is dropped, rd and ZF keep their values
+		cpu->flags[OF] = 1;
+	}
+	else {
+		cpu->flags[OF] = 0;
+		regs[ins->rd] = value;
+		FUNC_SET_ZF(value);
+	}
+	FUNC_NEXT();
+op_sub:
+	value = regs[ins->rs2];
+	goto sub_value;
+op_subl:
+	value = ins->imm;
+sub_value:
+	executed++;
+	// carry is set when subtrahend is larger, ZF is only updated without carry like Int FU
+	if (value > regs[ins->rs1]) {
+		cpu->flags[CF] = 1;
+		value = (int)((unsigned int)regs[ins->rs1] - (unsigned int)value);
+		zf_value = value;
+	}
+	else {
+		cpu->flags[CF] = 0;
+		value = (int)((unsigned int)regs[ins->rs1] - (unsigned int)value);
+		FUNC_SET_ZF(value);
+	}
+	regs[ins->rd] = value;
+	FUNC_NEXT();
+op_mul:
+	executed++;
+	value = (int)((unsigned int)regs[ins->rs1] * (unsigned int)regs[ins->rs2]);
+	regs[ins->rd] = value;
+	FUNC_SET_ZF(value);
+	FUNC_NEXT();
+op_div:
+	executed++;
+	if (regs[ins->rs2] == 0) {
+		// division by zero gives zero, ZF flag is left as it was
+		value = 0;
+		zf_value = 0;
+	}
+	else {
+		value = ((regs[ins->rs1] == INT_MIN)&&(regs[ins->rs2] == -1)) ? INT_MIN : regs[ins->rs1] / regs[ins->rs2];
+		FUNC_SET_ZF(value);
+	}
+	regs[ins->rd] = value;
+	FUNC_NEXT();
+op_and:
+	executed++;
+	regs[ins->rd] = regs[ins->rs1] & regs[ins->rs2];
+	FUNC_NEXT();
+op_or:
+	executed++;
+	regs[ins->rd] = regs[ins->rs1] | regs[ins->rs2];
+	FUNC_NEXT();
+op_exor:
+	executed++;
+	regs[ins->rd] = regs[ins->rs1] ^ regs[ins->rs2];
+	FUNC_NEXT();
+op_bz:
+	executed++;
+	if (zf_value != 0) {
+		FUNC_NEXT();
+	}
+	goto branch_target;
+op_bnz:
+	executed++;
+	if (zf_value == 0) {
+		FUNC_NEXT();
+	}
+branch_target:
+	new_pc = pc + ins->imm;
+	if ((new_pc < 4000)||(new_pc > ((cpu->code_memory_size*4)+4000))) {
+		fprintf(stderr, "Instruction %s Invalid Relative Address %d\n", get_inst_name(ins->type), new_pc);
+		FUNC_NEXT();
+	}
+	pc = new_pc;
+	FUNC_DISPATCH();
+op_jump:
+	executed++;
+	new_pc = regs[ins->rs1] + ins->imm;
+	if ((new_pc < 4000)||(new_pc > ((cpu->code_memory_size*4)+4000))) {
+		fprintf(stderr, "Instruction %s Invalid Address %d\n", get_inst_name(ins->type), new_pc);
+		FUNC_NEXT();
+	}
+	pc = new_pc;
+	FUNC_DISPATCH();
+op_nop:
+	// NOP never gets a ROB entry so it is not counted as completed
+	FUNC_NEXT();
+op_halt:
+	executed++;
+	pc += 4;
+	ret = HALT;
+	goto op_done;
+op_end:
+	ret = EMPTY;
+	goto op_done;
+op_limit:
+	ret = SUCCESS;
+op_done:
+
+#undef FUNC_NEXT
+#undef FUNC_DISPATCH
+#undef FUNC_SET_ZF
+
+	cpu->pc = pc;
+	cpu->zf_value = zf_value;
+	cpu->functional_ins_completed += executed;
+	return ret;
+}
@@ -0,0 +1,18 @@
+#ifndef _APEX_FUNCTIONAL_H_
+#define _APEX_FUNCTIONAL_H_
+/*
+ *  functional.h
+ *  Contains APEX functional (ISA only) execution, no IQ, LSQ, ROB or rename
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include "cpu.h"
+
+int APEX_functional_check(const APEX_CPU* cpu);
+int APEX_functional_run(APEX_CPU* cpu, long long max_instructions);
+int APEX_functional_run_checked(APEX_CPU* cpu, long long max_instructions);
+
+#endif
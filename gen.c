@@ -0,0 +1,369 @@
+/*
+ *  gen.c
+ *  Contains apex_gen, writes synthetic APEX programs with a chosen dependency, mix, branch and memory behavior
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+/*
+ * Reg usage of generated programs, the fixed regs sit at the top of the reg file
+ * R0 .. R(ilp-1) are the dependency chains, every op reads and writes one chain reg
+ */
+#define ZERO_REG (REGISTER_FILE_SIZE - 1)		// 0, base of every memory address
+#define ONE_REG (REGISTER_FILE_SIZE - 2)		// 1, MUL and DIV operand, keeps chain values small
+#define THREE_REG (REGISTER_FILE_SIZE - 3)		// 3, operand of the other ops
+#define LOOP_REG (REGISTER_FILE_SIZE - 4)		// iterations left
+#define FLAG_REG (REGISTER_FILE_SIZE - 5)		// set right before a branch so its direction is known
+#define MAX_CHAINS (REGISTER_FILE_SIZE - 5)
+
+// ops the mix can hold, in --mix name order
+enum {
+	GEN_ADD,
+	GEN_SUB,
+	GEN_MUL,
+	GEN_DIV,
+	GEN_AND,
+	GEN_OR,
+	GEN_EXOR,
+	GEN_LOAD,
+	GEN_STORE,
+	NUM_GEN_OPS
+};
+
+static const char* gen_op_names[NUM_GEN_OPS] = {"add", "sub", "mul", "div", "and", "or", "exor", "load", "store"};
+
+/* Knobs of a generated program */
+typedef struct Gen_Options {
+	long long size;		// inst in the body, setup and loop inst not counted
+	long long loop;		// times the body runs, 1 is straight line code
+	int ilp;		// independent dependency chains, ops go to them round robin
+	int chain;		// ops on a chain before it is reseeded by MOVC, 0 never reseeds
+	int mix[NUM_GEN_OPS];		// relative weight of each op
+	int branch;		// percent of body ops which are a branch
+	int taken;		// percent of branches which are taken, a taken branch skips one op
+	int footprint;		// data memory words touched, from address 0
+	int stride;		// words between consecutive memory ops
+	unsigned long long seed;
+} Gen_Options;
+
+/* Generator state while writing the body */
+typedef struct Gen_State {
+	FILE* fp;
+	const Gen_Options* options;
+	uint64_t random;
+	long long emitted;		// inst written so far, pc of the next one is 4000 + 4 * emitted
+	int next_chain;
+	int* chain_ops;		// ops on each chain since its last seed
+	long long mem_ops;		// memory ops so far, the n'th one uses (n * stride) % footprint
+	int mix_total;
+} Gen_State;
+
+
+/*
+ * ########################################## Random ##########################################
+*/
+
+static uint64_t get_random(Gen_State* state) {
+	// splitmix64, same seed gives the same program on every machine
+	uint64_t z = (state->random += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+
+static int get_percent_hit(Gen_State* state, int percent) {
+	return (int)(get_random(state) % 100) < percent;
+}
+
+
+/*
+ * ########################################## Body ##########################################
+*/
+
+static void emit(Gen_State* state, const char* format, ...) {
+	// one inst per line
+	va_list args;
+	va_start(args, format);
+	vfprintf(state->fp, format, args);
+	va_end(args);
+	fputc('\n', state->fp);
+	state->emitted += 1;
+}
+
+
+static void emit_seed(Gen_State* state, int chain) {
+	// a fresh value breaks the dependency on everything before it
+	emit(state, "MOVC,R%d,#%d", chain, chain + 1);
+	state->chain_ops[chain] = 0;
+}
+
+
+static void emit_op(Gen_State* state) {
+	// one op of the mix on the next chain, reseeding the chain first once it is chain ops long
+	const Gen_Options* options = state->options;
+	int chain = state->next_chain;
+	state->next_chain = (state->next_chain + 1) % options->ilp;
+	if ((options->chain > 0)&&(state->chain_ops[chain] >= options->chain)) {
+		emit_seed(state, chain);
+		return;
+	}
+	state->chain_ops[chain] += 1;
+
+	int pick = (int)(get_random(state) % (uint64_t)state->mix_total);
+	int op = 0;
+	while (pick >= options->mix[op]) {
+		pick -= options->mix[op];
+		op++;
+	}
+	int address = (int)((state->mem_ops * options->stride) % options->footprint);
+	switch (op) {
+		case GEN_ADD:
+			emit(state, "ADD,R%d,R%d,R%d", chain, chain, THREE_REG);
+			break;
+		case GEN_SUB:
+			emit(state, "SUB,R%d,R%d,R%d", chain, chain, THREE_REG);
+			break;
+		case GEN_MUL:
+			emit(state, "MUL,R%d,R%d,R%d", chain, chain, ONE_REG);
+			break;
+		case GEN_DIV:
+			emit(state, "DIV,R%d,R%d,R%d", chain, chain, ONE_REG);
+			break;
+		case GEN_AND:
+			emit(state, "AND,R%d,R%d,R%d", chain, chain, THREE_REG);
+			break;
+		case GEN_OR:
+			emit(state, "OR,R%d,R%d,R%d", chain, chain, THREE_REG);
+			break;
+		case GEN_EXOR:
+			emit(state, "EX-OR,R%d,R%d,R%d", chain, chain, THREE_REG);
+			break;
+		case GEN_LOAD:
+			// the loaded value continues the chain
+			emit(state, "LOAD,R%d,R%d,#%d", chain, ZERO_REG, address);
+			state->mem_ops += 1;
+			break;
+		case GEN_STORE:
+			emit(state, "STORE,R%d,R%d,#%d", chain, ZERO_REG, address);
+			state->mem_ops += 1;
+			break;
+	}
+}
+
+
+static void emit_branch(Gen_State* state) {
+	// ZF comes from the ADDL right before, so direction is chosen here, a taken branch skips the op after it
+	int taken = get_percent_hit(state, state->options->taken);
+	int zero = (int)(get_random(state) & 1);
+	emit(state, "ADDL,R%d,R%d,#%d", FLAG_REG, ZERO_REG, (zero) ? 0 : 1);
+	// BZ is taken when the result was 0, BNZ when it was not
+	emit(state, "%s,#8", (zero == taken) ? "BZ" : "BNZ");
+	emit_op(state);
+}
+
+
+static void write_program(Gen_State* state) {
+	const Gen_Options* options = state->options;
+	emit(state, "MOVC,R%d,#0", ZERO_REG);
+	emit(state, "MOVC,R%d,#1", ONE_REG);
+	emit(state, "MOVC,R%d,#3", THREE_REG);
+	if (options->loop > 1) {
+		emit(state, "MOVC,R%d,#%lld", LOOP_REG, options->loop);
+	}
+	long long loop_top = state->emitted;
+	long long body_end = state->emitted + options->size;
+	for (int i=0; i<options->ilp; i++) {
+		emit_seed(state, i);
+	}
+	while (state->emitted < body_end) {
+		// a branch takes 3 inst, it only goes where it fits
+		if ((body_end - state->emitted >= 3)&&(get_percent_hit(state, options->branch))) {
+			emit_branch(state);
+		}
+		else {
+			emit_op(state);
+		}
+	}
+	if (options->loop > 1) {
+		emit(state, "SUBL,R%d,R%d,#1", LOOP_REG, LOOP_REG);
+		emit(state, "BNZ,#%lld", (loop_top - state->emitted) * 4);
+	}
+	emit(state, "HALT");
+}
+
+
+/*
+ * ########################################## Options ##########################################
+*/
+
+static int parse_mix(const char* text, Gen_Options* options) {
+	// name:weight pairs separated by commas, ops not named get weight 0
+	memset(options->mix, 0, sizeof(options->mix));
+	const char* pos = text;
+	while (*pos != '\0') {
+		int op = 0;
+		for (; op<NUM_GEN_OPS; op++) {
+			size_t length = strlen(gen_op_names[op]);
+			if ((strncmp(pos, gen_op_names[op], length) == 0)&&(pos[length] == ':')) {
+				pos += length + 1;
+				break;
+			}
+		}
+		char* end = NULL;
+		long weight = (op < NUM_GEN_OPS) ? strtol(pos, &end, 10) : -1;
+		if ((weight < 0)||(weight > 1000000)||(end == pos)||((*end != ',')&&(*end != '\0'))) {
+			return FAILURE;
+		}
+		options->mix[op] = (int)weight;
+		pos = (*end == ',') ? end + 1 : end;
+	}
+	return SUCCESS;
+}
+
+
+static int parse_gen_option(const char* option, Gen_Options* options) {
+	char* end = NULL;
+	long long value = 0;
+	if (strncmp(option, "--mix=", 6) == 0) {
+		return parse_mix(option + 6, options);
+	}
+	const char* equal = strchr(option, '=');
+	if (!equal) {
+		return FAILURE;
+	}
+	value = strtoll(equal + 1, &end, 10);
+	if ((end == equal + 1)||(*end != '\0')) {
+		return FAILURE;
+	}
+	size_t length = (size_t)(equal - option);
+	if ((length == 6)&&(strncmp(option, "--size", length) == 0)) {
+		options->size = value;
+	}
+	else if ((length == 6)&&(strncmp(option, "--loop", length) == 0)) {
+		options->loop = value;
+	}
+	else if ((length == 5)&&(strncmp(option, "--ilp", length) == 0)) {
+		options->ilp = (int)value;
+	}
+	else if ((length == 7)&&(strncmp(option, "--chain", length) == 0)) {
+		options->chain = (int)value;
+	}
+	else if ((length == 8)&&(strncmp(option, "--branch", length) == 0)) {
+		options->branch = (int)value;
+	}
+	else if ((length == 7)&&(strncmp(option, "--taken", length) == 0)) {
+		options->taken = (int)value;
+	}
+	else if ((length == 11)&&(strncmp(option, "--footprint", length) == 0)) {
+		options->footprint = (int)value;
+	}
+	else if ((length == 8)&&(strncmp(option, "--stride", length) == 0)) {
+		options->stride = (int)value;
+	}
+	else if ((length == 6)&&(strncmp(option, "--seed", length) == 0)) {
+		options->seed = (unsigned long long)value;
+	}
+	else {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+
+static int check_gen_options(const Gen_Options* options) {
+	// code memory is int indexed and the loop count must fit a MOVC literal
+	int mix_total = 0;
+	for (int i=0; i<NUM_GEN_OPS; i++) {
+		mix_total += options->mix[i];
+	}
+	if ((options->ilp < 1)||(options->ilp > MAX_CHAINS)) {
+		fprintf(stderr, "APEX_Gen : --ilp must be 1 to %d\n", MAX_CHAINS);
+		return FAILURE;
+	}
+	if ((options->size < options->ilp)||(options->size > INT32_MAX / 2)) {
+		fprintf(stderr, "APEX_Gen : --size must be at least --ilp and below %d\n", INT32_MAX / 2);
+		return FAILURE;
+	}
+	if ((options->loop < 1)||(options->loop > INT32_MAX)) {
+		fprintf(stderr, "APEX_Gen : --loop must be 1 to %d\n", INT32_MAX);
+		return FAILURE;
+	}
+	if ((options->chain < 0)||(options->branch < 0)||(options->branch > 100)||(options->taken < 0)||(options->taken > 100)) {
+		fprintf(stderr, "APEX_Gen : --chain must be 0 or more, --branch and --taken 0 to 100\n");
+		return FAILURE;
+	}
+	if ((options->footprint < 1)||(options->footprint > DATA_MEMORY_SIZE)||(options->stride < 0)) {
+		fprintf(stderr, "APEX_Gen : --footprint must be 1 to %d words and --stride 0 or more\n", DATA_MEMORY_SIZE);
+		return FAILURE;
+	}
+	if (mix_total < 1) {
+		fprintf(stderr, "APEX_Gen : --mix needs at least one op with a weight above 0\n");
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+
+static void print_usage(const char* program) {
+	fprintf(stderr, "APEX_Help : Usage %s <output_file> [--size=<n>] [--loop=<n>] [--ilp=<n>] [--chain=<n>] [--mix=<op>:<weight>,...]\n", program);
+	fprintf(stderr, "APEX_Help :     [--branch=<percent>] [--taken=<percent>] [--footprint=<words>] [--stride=<words>] [--seed=<n>]\n");
+	fprintf(stderr, "APEX_Help : mix ops are add, sub, mul, div, and, or, exor, load and store, output_file - writes to stdout, other names starting with - are taken as options (use ./-name)\n");
+}
+
+
+int main(int argc, char const* argv[]) {
+
+	// output file comes first, a name starting with - is an option (eg: --help) put in its place, - alone is stdout
+	if ((argc < 2)||((argv[1][0] == '-')&&(argv[1][1] != '\0'))) {
+		print_usage(argv[0]);
+		exit(1);
+	}
+	Gen_Options options = {.size = 1000, .loop = 1, .ilp = 4, .taken = 50, .footprint = 1024, .stride = 1, .seed = 1};
+	options.mix[GEN_ADD] = 40;
+	options.mix[GEN_MUL] = 20;
+	options.mix[GEN_DIV] = 5;
+	options.mix[GEN_LOAD] = 20;
+	options.mix[GEN_STORE] = 15;
+	for (int i=2; i<argc; i++) {
+		if (parse_gen_option(argv[i], &options) != SUCCESS) {
+			fprintf(stderr, "APEX_Gen : Invalid option '%s'\n", argv[i]);
+			print_usage(argv[0]);
+			exit(1);
+		}
+	}
+	if (check_gen_options(&options) != SUCCESS) {
+		exit(1);
+	}
+
+	int to_stdout = (strcmp(argv[1], "-") == 0);
+	FILE* fp = (to_stdout) ? stdout : fopen(argv[1], "w");
+	if (!fp) {
+		fprintf(stderr, "APEX_Gen : Unable to open %s\n", argv[1]);
+		exit(1);
+	}
+	int chain_ops[MAX_CHAINS] = {0};
+	Gen_State state = {.fp = fp, .options = &options, .random = options.seed, .chain_ops = chain_ops};
+	for (int i=0; i<NUM_GEN_OPS; i++) {
+		state.mix_total += options.mix[i];
+	}
+	write_program(&state);
+	if ((ferror(fp))||((!to_stdout)&&(fclose(fp) != 0))) {
+		fprintf(stderr, "APEX_Gen : Unable to write %s\n", argv[1]);
+		exit(1);
+	}
+	if (!to_stdout) {
+		printf("Wrote %s, %lld inst, about %lld inst executed\n", argv[1], state.emitted, options.size * options.loop);
+	}
+	return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ *  image.c
+ *  Contains APEX program image, predecoded code memory and initial data memory in a binary file
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "image.h"
+#include "forwarding.h"
+
+_Static_assert(sizeof(Image_Header) % 8 == 0, "Image_Header must keep 8 byte aligned sections table");
+_Static_assert(IMAGE_ALIGN % sizeof(APEX_Instruction) == 0, "mapped code memory must stay aligned for APEX_Instruction");
+
+/*
+ * ########################################## Save ##########################################
+*/
+
+static uint64_t get_aligned_offset(uint64_t offset) {
+	return (offset + IMAGE_ALIGN - 1) / IMAGE_ALIGN * IMAGE_ALIGN;
+}
+
+
+static int write_section(FILE* fp, const void* data, uint64_t size, uint64_t offset, uint64_t* position) {
+	// zero padding up to the section offset, then the section itself
+	static const char padding[IMAGE_ALIGN];
+	while (*position < offset) {
+		size_t pad = ((offset - *position) < sizeof(padding)) ? (size_t)(offset - *position) : sizeof(padding);
+		if (fwrite(padding, 1, pad, fp) != pad) {
+			return FAILURE;
+		}
+		*position += pad;
+	}
+	if ((size > 0)&&(fwrite(data, 1, size, fp) != size)) {
+		return FAILURE;
+	}
+	*position += size;
+	return SUCCESS;
+}
+
+
+int write_program_image(const char* filename, const APEX_Instruction* code_memory, int code_memory_size, const int* data_memory, int data_memory_size) {
+	// written to <filename>.<pid>.tmp first and renamed, so a machine mapping the old image never sees a partial one
+	// and two processes saving the same image do not write into one file
+	if ((code_memory_size < 1)||(data_memory_size < 0)||(data_memory_size > DATA_MEMORY_SIZE)) {
+		return FAILURE;
+	}
+	Image_Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+	header.version = IMAGE_VERSION;
+	header.byte_order = IMAGE_BYTE_ORDER;
+	header.header_size = sizeof(header);
+	header.instruction_size = sizeof(APEX_Instruction);
+	header.code_size = (uint32_t)code_memory_size;
+	header.data_size = (uint32_t)data_memory_size;
+	header.sections[IMAGE_CODE].size = (uint64_t)code_memory_size * sizeof(APEX_Instruction);
+	header.sections[IMAGE_DATA].size = (uint64_t)data_memory_size * sizeof(int);
+	uint64_t offset = get_aligned_offset(sizeof(header));
+	for (int i=0; i<NUM_IMAGE_SECTIONS; i++) {
+		header.sections[i].offset = offset;
+		offset = get_aligned_offset(offset + header.sections[i].size);
+	}
+	const void* section_data[NUM_IMAGE_SECTIONS] = {code_memory, data_memory};
+
+	size_t name_size = strlen(filename) + 32;
+	char* temp_name = apex_malloc(name_size);
+	if (!temp_name) {
+		return FAILURE;
+	}
+	snprintf(temp_name, name_size, "%s.%ld.tmp", filename, (long)getpid());
+
+	int ret = FAILURE;
+	FILE* fp = fopen(temp_name, "wb");
+	if (!fp) {
+		fprintf(stderr, "APEX_Image : Unable to open %s\n", temp_name);
+	}
+	else {
+		uint64_t position = 0;
+		ret = write_section(fp, &header, sizeof(header), 0, &position);
+		for (int i=0; (i<NUM_IMAGE_SECTIONS)&&(ret==SUCCESS); i++) {
+			ret = write_section(fp, section_data[i], header.sections[i].size, header.sections[i].offset, &position);
+		}
+		if ((fclose(fp) != 0)||(ret != SUCCESS)) {
+			fprintf(stderr, "APEX_Image : Unable to write %s\n", temp_name);
+			remove(temp_name);
+			ret = FAILURE;
+		}
+		else if (rename(temp_name, filename) != 0) {
+			fprintf(stderr, "APEX_Image : Unable to rename %s to %s\n", temp_name, filename);
+			remove(temp_name);
+			ret = FAILURE;
+		}
+	}
+	free(temp_name);
+	return ret;
+}
+
+
+/*
+ * ########################################## Load ##########################################
+*/
+
+int is_program_image(const char* filename) {
+	// only the magic of a regular file is read, anything else is taken as assembly text
+	// reading a pipe or a terminal would eat the text before the parser sees it
+	char magic[sizeof(((Image_Header*)0)->magic)];
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+	struct stat file_stat;
+	int ret = (fstat(fd, &file_stat) == 0)&&(S_ISREG(file_stat.st_mode));
+	ret = (ret)&&(read(fd, magic, sizeof(magic)) == (ssize_t)sizeof(magic))&&(memcmp(magic, IMAGE_MAGIC, sizeof(magic)) == 0);
+	close(fd);
+	return ret;
+}
+
+
+static int check_image_header(const Image_Header* header, size_t file_size, const char* filename) {
+	if ((header->byte_order != IMAGE_BYTE_ORDER)||(header->version != IMAGE_VERSION)||(header->header_size != sizeof(*header))||(header->instruction_size != sizeof(APEX_Instruction))) {
+		fprintf(stderr, "APEX_Image : %s is version %u, this build reads version %u\n", filename, header->version, IMAGE_VERSION);
+		return FAILURE;
+	}
+	if ((header->code_size < 1)||(header->code_size > INT32_MAX / sizeof(APEX_Instruction))||(header->data_size > DATA_MEMORY_SIZE)) {
+		fprintf(stderr, "APEX_Image : %s has %u inst and %u data words\n", filename, header->code_size, header->data_size);
+		return FAILURE;
+	}
+	if ((header->sections[IMAGE_CODE].size != (uint64_t)header->code_size * sizeof(APEX_Instruction))||(header->sections[IMAGE_DATA].size != (uint64_t)header->data_size * sizeof(int))) {
+		fprintf(stderr, "APEX_Image : %s section sizes do not match its counts\n", filename);
+		return FAILURE;
+	}
+	for (int i=0; i<NUM_IMAGE_SECTIONS; i++) {
+		const Image_Section* section = &header->sections[i];
+		if ((section->offset % IMAGE_ALIGN != 0)||(section->offset > file_size)||(section->size > file_size - section->offset)) {
+			fprintf(stderr, "APEX_Image : %s is truncated\n", filename);
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+
+static int check_image_code(const APEX_Instruction* code_memory, int code_memory_size, const char* filename) {
+	// every inst is checked once here, pipeline and functional mode index tables and reg files with these
+	// type 0 is the empty inst of a blank line, same as the parser writes
+	for (int i=0; i<code_memory_size; i++) {
+		const APEX_Instruction* ins = &code_memory[i];
+		if (ins->type > NOP) {
+			fprintf(stderr, "APEX_Error : %s has unknown inst type %u at pc(%d)\n", filename, ins->type, 4000 + (i * 4));
+			return FAILURE;
+		}
+		if ((ins->rd >= REGISTER_FILE_SIZE)||(ins->rs1 >= REGISTER_FILE_SIZE)||(ins->rs2 >= REGISTER_FILE_SIZE)) {
+			fprintf(stderr, "APEX_Error : %s has an invalid register in %s at pc(%d)\n", filename, get_inst_name(ins->type), 4000 + (i * 4));
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+
+int map_program_image(const char* filename, Program_Image* image) {
+	// whole file is mapped read only and code memory is used in place, checking the inst reads every code page once
+	memset(image, 0, sizeof(*image));
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "APEX_Image : Unable to open %s\n", filename);
+		return FAILURE;
+	}
+	struct stat file_stat;
+	void* data = MAP_FAILED;
+	size_t size = 0;
+	if ((fstat(fd, &file_stat) == 0)&&(file_stat.st_size >= (off_t)sizeof(Image_Header))) {
+		size = (size_t)file_stat.st_size;
+		data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "APEX_Image : %s is not a program image\n", filename);
+		return FAILURE;
+	}
+	const Image_Header* header = (const Image_Header*)data;
+	if ((memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) != 0)||(check_image_header(header, size, filename) != SUCCESS)) {
+		munmap(data, size);
+		return FAILURE;
+	}
+	const APEX_Instruction* code_memory = (const APEX_Instruction*)((const unsigned char*)data + header->sections[IMAGE_CODE].offset);
+	if (check_image_code(code_memory, (int)header->code_size, filename) != SUCCESS) {
+		munmap(data, size);
+		return FAILURE;
+	}
+	image->mapping = data;
+	image->mapping_size = size;
+	image->code_memory = code_memory;
+	image->code_memory_size = (int)header->code_size;
+	image->data_memory = (header->data_size > 0) ? (const int*)((const unsigned char*)data + header->sections[IMAGE_DATA].offset) : NULL;
+	image->data_memory_size = (int)header->data_size;
+	return SUCCESS;
+}
+
+
+void unmap_program_image(Program_Image* image) {
+	if (image->mapping) {
+		munmap(image->mapping, image->mapping_size);
+	}
+	memset(image, 0, sizeof(*image));
+}
@@ -0,0 +1,64 @@
+#ifndef _APEX_IMAGE_H_
+#define _APEX_IMAGE_H_
+/*
+ *  image.h
+ *  Contains APEX program image, predecoded code memory and initial data memory in a binary file
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+/* File starts with this magic, version changes whenever the layout or APEX_Instruction changes */
+#define IMAGE_MAGIC "APEXPROG"
+#define IMAGE_VERSION 1
+#define IMAGE_BYTE_ORDER 0x01020304u
+// every section starts at a multiple of this, so mapped code memory is used in place
+#define IMAGE_ALIGN 64
+
+// sections of an image file, in file order
+enum {
+	IMAGE_CODE,		// code_size APEX_Instruction records
+	IMAGE_DATA,		// data_size ints, data memory from address 0, can be empty
+	NUM_IMAGE_SECTIONS
+};
+
+typedef struct Image_Section {
+	uint64_t offset;			// from start of file
+	uint64_t size;				// bytes, without padding
+} Image_Section;
+
+/* Fixed size header at offset 0 */
+typedef struct Image_Header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;		// IMAGE_BYTE_ORDER as written by the assembling machine
+	uint32_t header_size;
+	uint32_t instruction_size;		// sizeof(APEX_Instruction)
+	uint32_t code_size;			// inst in code memory
+	uint32_t data_size;			// words of initial data memory
+	Image_Section sections[NUM_IMAGE_SECTIONS];
+} Image_Header;
+
+/* Mapped image, code and data point into the mapping */
+typedef struct Program_Image {
+	void* mapping;
+	size_t mapping_size;
+	const APEX_Instruction* code_memory;
+	int code_memory_size;
+	const int* data_memory;
+	int data_memory_size;
+} Program_Image;
+
+
+int is_program_image(const char* filename);
+int write_program_image(const char* filename, const APEX_Instruction* code_memory, int code_memory_size, const int* data_memory, int data_memory_size);
+int map_program_image(const char* filename, Program_Image* image);
+void unmap_program_image(Program_Image* image);
+
+#endif
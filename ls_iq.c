@@ -31,212 +31,344 @@
  *  Get ROB entry, Point RAT to rob ROB entry
 */
 
-APEX_IQ* init_issue_queue() {
+static inline void set_mask_bit(uint64_t* mask, int index) {
+	mask[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+static inline void clear_mask_bit(uint64_t* mask, int index) {
+	mask[index / 64] &= ~((uint64_t)1 << (index % 64));
+}
+
+
+static inline uint64_t* get_age_row(APEX_IQ* issue_queue, int index) {
+	return issue_queue->age_matrix + (size_t)index * issue_queue->mask_words;
+}
+
+static inline uint64_t* get_tag_waiters(APEX_IQ* issue_queue, int tag) {
+	return issue_queue->tag_waiters + (size_t)tag * issue_queue->mask_words;
+}
 
-	APEX_IQ* issue_queue = malloc(sizeof(*issue_queue));
+
+APEX_IQ* init_issue_queue(int iq_size, int tag_count) {
+
+	if ((iq_size < 1)||(tag_count < 1)) {
+		return NULL;
+	}
+	APEX_IQ* issue_queue = apex_malloc(sizeof(*issue_queue));
 
 	if (!issue_queue) {
 		return NULL;
 	}
 
-	memset(issue_queue->iq_entries, 0, sizeof(IQ_FORMAT)*IQ_SIZE);  // all issue entry set to 0
+	issue_queue->size = iq_size;
+	issue_queue->mask_words = (iq_size + 63) / 64;
+	issue_queue->tag_count = tag_count;
+	issue_queue->iq_entries = apex_calloc(iq_size, sizeof(IQ_FORMAT));  // all issue entry set to 0
+	issue_queue->mask_storage = apex_calloc(1, get_issue_queue_mask_bytes(issue_queue));  // all masks set to 0
+	if ((!issue_queue->iq_entries)||(!issue_queue->mask_storage)) {
+		deinit_issue_queue(issue_queue);
+		return NULL;
+	}
+	uint64_t* row = issue_queue->mask_storage;
+	issue_queue->valid_mask = row;
+	row += issue_queue->mask_words;
+	issue_queue->ready_mask = row;
+	row += issue_queue->mask_words;
+	issue_queue->candidates = row;
+	row += issue_queue->mask_words;
+	for (int fu=0; fu<NUM_IQ_FU; fu++) {
+		issue_queue->fu_mask[fu] = row;
+		row += issue_queue->mask_words;
+	}
+	issue_queue->age_matrix = row;
+	row += (size_t)iq_size * issue_queue->mask_words;
+	issue_queue->tag_waiters = row;
 
 	return issue_queue;
 }
 
+size_t get_issue_queue_mask_bytes(const APEX_IQ* issue_queue) {
+	// valid, ready, candidates, fu masks, age matrix and tag waiter rows
+	size_t mask_rows = 3 + NUM_IQ_FU + (size_t)issue_queue->size + (size_t)issue_queue->tag_count;
+	return mask_rows * issue_queue->mask_words * sizeof(uint64_t);
+}
+
 void deinit_issue_queue(APEX_IQ* issue_queue) {
+	free(issue_queue->iq_entries);
+	free(issue_queue->mask_storage);
 	free(issue_queue);
 }
 
 int can_add_entry_in_issue_queue(APEX_IQ* issue_queue) {
-	int add_position = -1;
-	for (int i=0; i<IQ_SIZE; i++) {
-		if (issue_queue->iq_entries[i].status == INVALID) {
-			add_position = i;
-			break;
-		}
+	if (get_issue_queue_count(issue_queue)<issue_queue->size) {
+		return SUCCESS;
 	}
-	if (add_position<0) {
+	else {
 		return FAILURE;
 	}
-	else {
-		return SUCCESS;
+}
+
+
+static int get_issue_queue_fu_type(int inst_type) {
+	// func unit issue_instruction sends the inst to
+	switch (inst_type) {
+
+		case STORE: case STR: case LOAD: case LDR: case MOVC: case MOV: case ADD: case ADDL: case SUB: case SUBL: case DIV: case AND: case OR: case EXOR:
+			return IQ_FU_INT;
+
+		case MUL:
+			return IQ_FU_MUL;
+
+		case BZ: case BNZ: case JUMP:
+			return IQ_FU_BRANCH;
+
+		default:
+			return IQ_FU_NONE;
+	}
+}
+
+
+static int is_issue_queue_entry_ready(IQ_FORMAT* iq_entry) {
+	// check if src regs required by the instruction type are ready
+	switch (iq_entry->inst_type) {
+
+		// check no src reg instructions
+		case MOVC:
+			return VALID;
+
+		// check single src reg instructions
+		// Store rd is checked in LSQ before its issued from LSQ to Mem stage
+		// BZ BNZ rs1 is the result ZF is taken from
+		case STORE: case LOAD: case MOV: case ADDL: case SUBL: case JUMP: case BZ: case BNZ:
+			return (iq_entry->rs1_ready) ? VALID : INVALID;
+
+		// check two src reg instructions
+		case STR: case LDR: case ADD: case SUB: case MUL: case DIV: case AND: case OR: case EXOR:
+			return ((iq_entry->rs1_ready)&&(iq_entry->rs2_ready)) ? VALID : INVALID;
+
+		default:
+			return INVALID;
+	}
+}
+
+
+static void add_issue_queue_tag_waiter(APEX_IQ* issue_queue, int tag, int index) {
+	// only phys reg tags are broadcast, anything else can never wake up the entry
+	if ((tag>=0)&&(tag<issue_queue->tag_count)) {
+		set_mask_bit(get_tag_waiters(issue_queue, tag), index);
 	}
 }
 
-int add_issue_queue_entry(APEX_IQ* issue_queue, LS_IQ_Entry ls_iq_entry, int* lsq_index) {
+
+static void remove_issue_queue_tag_waiter(APEX_IQ* issue_queue, int tag, int index) {
+	if ((tag>=0)&&(tag<issue_queue->tag_count)) {
+		clear_mask_bit(get_tag_waiters(issue_queue, tag), index);
+	}
+}
+
+
+int add_issue_queue_entry(APEX_IQ* issue_queue, const LS_IQ_Entry* ls_iq_entry, int* lsq_index) {
 	// if instruction sucessfully added then only pass the instruction to function units
 	int add_position = -1;
-	if (!ls_iq_entry.executed) {
+	if (!ls_iq_entry->executed) {
 		return FAILURE;
 	}
 	else {
-		for (int i=0; i<IQ_SIZE; i++) {
-			if (issue_queue->iq_entries[i].status == INVALID) {
-				add_position = i;
+		// first free entry is the lowest clear bit of valid mask
+		for (int w=0; w<issue_queue->mask_words; w++) {
+			uint64_t free_bits = ~issue_queue->valid_mask[w];
+			if (free_bits) {
+				add_position = w*64 + __builtin_ctzll(free_bits);
 				break;
 			}
 		}
-		if (add_position<0) {
+		if ((add_position<0)||(add_position>=issue_queue->size)) {
 			return FAILURE;
 		}
 		else {
-			issue_queue->iq_entries[add_position].status = VALID;
-			issue_queue->iq_entries[add_position].inst_type = ls_iq_entry.inst_type;
-			issue_queue->iq_entries[add_position].inst_ptr = ls_iq_entry.pc;
-			issue_queue->iq_entries[add_position].rd = ls_iq_entry.rd;
-			issue_queue->iq_entries[add_position].rd_value = ls_iq_entry.rd_value;
-			issue_queue->iq_entries[add_position].rd_ready = ls_iq_entry.rd_valid;
-			issue_queue->iq_entries[add_position].rs1 = ls_iq_entry.rs1;
-			issue_queue->iq_entries[add_position].rs1_value = ls_iq_entry.rs1_value;
-			issue_queue->iq_entries[add_position].rs1_ready = ls_iq_entry.rs1_valid;
-			issue_queue->iq_entries[add_position].rs2 = ls_iq_entry.rs2;
-			issue_queue->iq_entries[add_position].rs2_value = ls_iq_entry.rs2_value;
-			issue_queue->iq_entries[add_position].rs2_ready = ls_iq_entry.rs2_valid;
-			issue_queue->iq_entries[add_position].literal = ls_iq_entry.buffer;
-			issue_queue->iq_entries[add_position].stage_cycle = INVALID;
-			issue_queue->iq_entries[add_position].lsq_index = *lsq_index;
+			IQ_FORMAT* iq_entry = &issue_queue->iq_entries[add_position];
+			iq_entry->status = VALID;
+			iq_entry->inst_type = ls_iq_entry->inst_type;
+			iq_entry->inst_ptr = ls_iq_entry->pc;
+			iq_entry->rd = ls_iq_entry->rd;
+			iq_entry->rd_value = ls_iq_entry->rd_value;
+			iq_entry->rd_ready = ls_iq_entry->rd_valid;
+			iq_entry->rs1 = ls_iq_entry->rs1;
+			iq_entry->rs1_value = ls_iq_entry->rs1_value;
+			iq_entry->rs1_ready = ls_iq_entry->rs1_valid;
+			iq_entry->rs2 = ls_iq_entry->rs2;
+			iq_entry->rs2_value = ls_iq_entry->rs2_value;
+			iq_entry->rs2_ready = ls_iq_entry->rs2_valid;
+			iq_entry->literal = ls_iq_entry->buffer;
+			iq_entry->fu_type = get_issue_queue_fu_type(ls_iq_entry->inst_type);
+			iq_entry->lsq_index = *lsq_index;
+			iq_entry->rob_index = ls_iq_entry->rob_index;
+
+			// every entry already in queue is older, and the new entry is older than none of them
+			for (int w=0; w<issue_queue->mask_words; w++) {
+				get_age_row(issue_queue, add_position)[w] = issue_queue->valid_mask[w];
+				uint64_t valid_bits = issue_queue->valid_mask[w];
+				while (valid_bits) {
+					int i = w*64 + __builtin_ctzll(valid_bits);
+					clear_mask_bit(get_age_row(issue_queue, i), add_position);
+					valid_bits &= valid_bits - 1;
+				}
+			}
+			set_mask_bit(issue_queue->valid_mask, add_position);
+			set_mask_bit(issue_queue->fu_mask[iq_entry->fu_type], add_position);
+
+			// register for wakeup on every src reg not yet ready
+			if (iq_entry->rs1_ready==INVALID) {
+				add_issue_queue_tag_waiter(issue_queue, iq_entry->rs1, add_position);
+			}
+			if (iq_entry->rs2_ready==INVALID) {
+				add_issue_queue_tag_waiter(issue_queue, iq_entry->rs2, add_position);
+			}
+			if (((iq_entry->inst_type==STORE)||(iq_entry->inst_type==STR))&&(iq_entry->rd_ready==INVALID)) {
+				add_issue_queue_tag_waiter(issue_queue, iq_entry->rd, add_position);
+			}
+			if (is_issue_queue_entry_ready(iq_entry)) {
+				set_mask_bit(issue_queue->ready_mask, add_position);
+			}
 		}
 	}
 	return SUCCESS;
 }
 
 
-int update_issue_queue_entry(APEX_IQ* issue_queue, LS_IQ_Entry ls_iq_entry) {
+int update_issue_queue_entry(APEX_IQ* issue_queue, const LS_IQ_Entry* ls_iq_entry) {
 	// this is updating values from func unit to any entry which is waiting in queue
-	// array to hold respective reg update positions
-	// int rs1_position[IQ_SIZE] = {-1}; // these can use to see where values got updated
-	// int rs2_position[IQ_SIZE] = {-1};
+	// only entries registered as waiting on the tag are visited
 	int update_pos_sum = 0;
-	if (!ls_iq_entry.executed) {
+	if (!ls_iq_entry->executed) {
+		return FAILURE;
+	}
+	else if ((ls_iq_entry->rd<0)||(ls_iq_entry->rd>=issue_queue->tag_count)) {
 		return FAILURE;
 	}
 	else {
-		// for now loop through entire issue_queue and check
-		for (int i=0; i<IQ_SIZE; i++) {
-			// check only alloted entries
-			if (issue_queue->iq_entries[i].status == VALID) {
+		uint64_t* waiters = get_tag_waiters(issue_queue, ls_iq_entry->rd);
+		for (int w=0; w<issue_queue->mask_words; w++) {
+			uint64_t waiter_bits = waiters[w] & issue_queue->valid_mask[w];
+			while (waiter_bits) {
+				int i = w*64 + __builtin_ctzll(waiter_bits);
+				IQ_FORMAT* iq_entry = &issue_queue->iq_entries[i];
 				// first check rd ie flow and output dependencies
-				if ((ls_iq_entry.rd == issue_queue->iq_entries[i].rs1)&&(issue_queue->iq_entries[i].rs1_ready==INVALID)) {
-					issue_queue->iq_entries[i].rs1_value = ls_iq_entry.rd_value;
-					issue_queue->iq_entries[i].rs1_ready = VALID;
-					// rs1_position[i] = i;
+				if ((ls_iq_entry->rd == iq_entry->rs1)&&(iq_entry->rs1_ready==INVALID)) {
+					iq_entry->rs1_value = ls_iq_entry->rd_value;
+					iq_entry->rs1_ready = VALID;
 					update_pos_sum += 1;
 				}
-				if ((ls_iq_entry.rd == issue_queue->iq_entries[i].rs2)&&(issue_queue->iq_entries[i].rs2_ready==INVALID)) {
-					issue_queue->iq_entries[i].rs2_value = ls_iq_entry.rd_value;
-					issue_queue->iq_entries[i].rs2_ready = VALID;
-					// rs2_position[i] = i;
+				if ((ls_iq_entry->rd == iq_entry->rs2)&&(iq_entry->rs2_ready==INVALID)) {
+					iq_entry->rs2_value = ls_iq_entry->rd_value;
+					iq_entry->rs2_ready = VALID;
 					update_pos_sum += 1;
 				}
 				// this for updating STORE STR Rd
-				if ((issue_queue->iq_entries[i].inst_type==STORE)||(issue_queue->iq_entries[i].inst_type==STR)) {
-					if ((ls_iq_entry.rd == issue_queue->iq_entries[i].rd)&&(issue_queue->iq_entries[i].rd_ready==INVALID)) {
-						issue_queue->iq_entries[i].rd_value = ls_iq_entry.rd_value;
-						issue_queue->iq_entries[i].rd_ready = VALID;
-						// rs2_position[i] = i;
+				if ((iq_entry->inst_type==STORE)||(iq_entry->inst_type==STR)) {
+					if ((ls_iq_entry->rd == iq_entry->rd)&&(iq_entry->rd_ready==INVALID)) {
+						iq_entry->rd_value = ls_iq_entry->rd_value;
+						iq_entry->rd_ready = VALID;
 						update_pos_sum += 1;
 					}
 				}
+				if (is_issue_queue_entry_ready(iq_entry)) {
+					set_mask_bit(issue_queue->ready_mask, i);
+				}
+				waiter_bits &= waiter_bits - 1;
 			}
+			// every waiter got the value
+			waiters[w] = 0;
 		}
 	}
 	if (update_pos_sum == 0) {
-		if (ENABLE_DEBUG_MESSAGES_L2) {
-			fprintf(stderr, "No Update in IQ for Inst %d at pc(%d)\n", ls_iq_entry.inst_type, ls_iq_entry.pc);
-		}
+		// nothing was waiting on this reg, caller prints the message if required
+		return FAILURE;
 	}
 	return SUCCESS;
 }
 
 
-int get_issue_queue_index_to_issue(APEX_IQ* issue_queue, int* issue_index) {
-	// get all the index of issue_queue entries
-	// in cpu loop through index and issue instructions to respective func units
-	// int issue_index[IQ_SIZE] = {-1}; // these can use to see where values got updated
-	int index_sum = 0;
-	int stage_cycle_array[IQ_SIZE] = {[0 ... IQ_SIZE-1] = -1};
-	for (int i=0; i<IQ_SIZE; i++) {
-		// check only alloted entries
-		if (issue_queue->iq_entries[i].status == VALID) {
-			// check if instructions have been in IQ for atleast one cycle
-			// if (issue_queue->iq_entries[i].stage_cycle>0) {  // no need if we are executing in reverse
-			switch (issue_queue->iq_entries[i].inst_type) {
-
-				// check no src reg instructions
-				case MOVC: case BZ: case BNZ:
-					issue_index[i] = i;
-					index_sum += 1;
-					break;
-
-				// check single src reg instructions
-				case STORE: case LOAD: case MOV: case ADDL: case SUBL: case JUMP:
-					if (issue_queue->iq_entries[i].rs1_ready) {
-						issue_index[i] = i;
-						index_sum += 1;
-					}
-					break;
-
-				// check single src/desc reg instructions
-				// case STORE:
-				// 	if ((issue_queue->iq_entries[i].rs1_ready)&&(issue_queue->iq_entries[i].rd_ready)) {
-				// 		issue_index[i] = i;
-				// 		index_sum += 1;
-				// 	}
-				// 	break;
-
-				// check two src reg instructions
-				case STR: case LDR: case ADD: case SUB: case MUL: case DIV: case AND: case OR: case EXOR:
-					if ((issue_queue->iq_entries[i].rs1_ready)&&(issue_queue->iq_entries[i].rs2_ready)) {
-						issue_index[i] = i;
-						index_sum += 1;
-					}
-					break;
-
-				// check double src and desc reg instructions
-				// case STR:
-				// 	if ((issue_queue->iq_entries[i].rs1_ready)&&(issue_queue->iq_entries[i].rs2_ready)&&(issue_queue->iq_entries[i].rd_ready)) {
-				// 		issue_index[i] = i;
-				// 		index_sum += 1;
-				// 	}
-				// 	break;
-				// confirm if for Store we need to check all three src reg before issuing
-				// or the src reg (desc rd) is checked in LSQ before its issueed from LSQ to Mem stage
-				default:
-					break;
+int get_issue_queue_index_to_issue(APEX_IQ* issue_queue, int fu_type, int* issue_index) {
+	// select the oldest ready entry for func unit
+	// oldest is the candidate with no older candidate in its age matrix row
+	uint64_t* candidates = issue_queue->candidates;
+	for (int w=0; w<issue_queue->mask_words; w++) {
+		candidates[w] = issue_queue->ready_mask[w] & issue_queue->fu_mask[fu_type][w];
+	}
+	for (int w=0; w<issue_queue->mask_words; w++) {
+		uint64_t candidate_bits = candidates[w];
+		while (candidate_bits) {
+			int i = w*64 + __builtin_ctzll(candidate_bits);
+			uint64_t older = 0;
+			for (int k=0; k<issue_queue->mask_words; k++) {
+				older |= get_age_row(issue_queue, i)[k] & candidates[k];
 			}
-			// even if inst is invalid inc stage cycle to know how long inst has been in IQ
-			issue_queue->iq_entries[i].stage_cycle += 1;
-			stage_cycle_array[i] = issue_queue->iq_entries[i].stage_cycle;
+			if (!older) {
+				*issue_index = i;
+				return SUCCESS;
+			}
+			candidate_bits &= candidate_bits - 1;
 		}
 	}
-	if (index_sum == 0) {
-		return FAILURE;
-	}
-	else {
-		int i,j,temp;
-		for(i=0; i<IQ_SIZE; i++)
-		{
-			for(j=i+1; j<IQ_SIZE; j++)
-			{
-				if(stage_cycle_array[i] < stage_cycle_array[j])
-				{
-					temp = issue_index[i];
-					issue_index[i] = issue_index[j];
-					issue_index[j] = temp;
-				}
-			}
+	return FAILURE;
+}
+
+
+void remove_issue_queue_entry(APEX_IQ* issue_queue, int issue_index) {
+	// remove the entry from issue_queue once its issued to func unit
+	IQ_FORMAT* iq_entry = &issue_queue->iq_entries[issue_index];
+
+	clear_mask_bit(issue_queue->valid_mask, issue_index);
+	clear_mask_bit(issue_queue->ready_mask, issue_index);
+	clear_mask_bit(issue_queue->fu_mask[iq_entry->fu_type], issue_index);
+	remove_issue_queue_tag_waiter(issue_queue, iq_entry->rs1, issue_index);
+	remove_issue_queue_tag_waiter(issue_queue, iq_entry->rs2, issue_index);
+	remove_issue_queue_tag_waiter(issue_queue, iq_entry->rd, issue_index);
+
+	iq_entry->status = INVALID;
+	iq_entry->inst_type = INVALID;
+	iq_entry->inst_ptr = INVALID;
+	iq_entry->rd = INVALID;
+	iq_entry->rd_value = INVALID;
+	iq_entry->rd_ready = INVALID;
+	iq_entry->rs1 = INVALID;
+	iq_entry->rs1_value = INVALID;
+	iq_entry->rs1_ready = INVALID;
+	iq_entry->rs2 = INVALID;
+	iq_entry->rs2_value = INVALID;
+	iq_entry->rs2_ready = INVALID;
+	iq_entry->literal = INVALID;
+	iq_entry->fu_type = INVALID;
+	iq_entry->lsq_index = INVALID;
+	iq_entry->rob_index = INVALID;
+}
+
+
+int has_issue_queue_ready_entry(APEX_IQ* issue_queue) {
+	// any ready entry that can go to a func unit
+	for (int w=0; w<issue_queue->mask_words; w++) {
+		if (issue_queue->ready_mask[w] & ~issue_queue->fu_mask[IQ_FU_NONE][w]) {
+			return SUCCESS;
 		}
 	}
+	return FAILURE;
+}
 
-	return SUCCESS;
+
+int get_issue_queue_count(APEX_IQ* issue_queue) {
+	int count = 0;
+	for (int w=0; w<issue_queue->mask_words; w++) {
+		count += __builtin_popcountll(issue_queue->valid_mask[w]);
+	}
+	return count;
 }
 
 
 void clear_issue_queue_entry(APEX_IQ* issue_queue) {
 
 	// clear all rob entries
-	for(int i=0; i<IQ_SIZE; i++) {
+	for(int i=0; i<issue_queue->size; i++) {
 		issue_queue->iq_entries[i].status = INVALID;
 		issue_queue->iq_entries[i].inst_type = INVALID;
 		issue_queue->iq_entries[i].inst_ptr = INVALID;
@@ -250,9 +382,11 @@ void clear_issue_queue_entry(APEX_IQ* issue_queue) {
 		issue_queue->iq_entries[i].rs2 = INVALID;
 		issue_queue->iq_entries[i].rs2_ready = INVALID;
 		issue_queue->iq_entries[i].rs2_value = INVALID;
-		issue_queue->iq_entries[i].stage_cycle = INVALID;
+		issue_queue->iq_entries[i].fu_type = INVALID;
 		issue_queue->iq_entries[i].lsq_index = INVALID;
+		issue_queue->iq_entries[i].rob_index = INVALID;
 	}
+	memset(issue_queue->mask_storage, 0, get_issue_queue_mask_bytes(issue_queue));
 }
 
 
@@ -261,27 +395,37 @@ void clear_issue_queue_entry(APEX_IQ* issue_queue) {
 */
 
 
-APEX_LSQ* init_ls_queue() {
+APEX_LSQ* init_ls_queue(int lsq_size) {
 
-	APEX_LSQ* ls_queue = malloc(sizeof(*ls_queue));
+	if (lsq_size < 1) {
+		return NULL;
+	}
+	APEX_LSQ* ls_queue = apex_malloc(sizeof(*ls_queue));
 
 	if (!ls_queue) {
 		return NULL;
 	}
 
-	memset(ls_queue->lsq_entries, 0, sizeof(LSQ_FORMAT)*LSQ_SIZE);  // all issue entry set to 0
+	ls_queue->size = lsq_size;
+	ls_queue->lsq_entries = apex_calloc(lsq_size, sizeof(LSQ_FORMAT));  // all lsq entry set to 0
+	if (!ls_queue->lsq_entries) {
+		free(ls_queue);
+		return NULL;
+	}
+	ls_queue->next_seq = 0;
 
 	return ls_queue;
 }
 
 void deinit_ls_queue(APEX_LSQ* ls_queue) {
+	free(ls_queue->lsq_entries);
 	free(ls_queue);
 }
 
 
 int can_add_entry_in_ls_queue(APEX_LSQ* ls_queue) {
 	int add_position = -1;
-	for (int i=0; i<IQ_SIZE; i++) {
+	for (int i=0; i<ls_queue->size; i++) {
 		if (ls_queue->lsq_entries[i].status == INVALID) {
 			add_position = i;
 			break;
@@ -296,11 +440,11 @@ int can_add_entry_in_ls_queue(APEX_LSQ* ls_queue) {
 }
 
 
-int add_ls_queue_entry(APEX_LSQ* ls_queue, LS_IQ_Entry ls_iq_entry, int* lsq_index) {
+int add_ls_queue_entry(APEX_LSQ* ls_queue, const LS_IQ_Entry* ls_iq_entry, int* lsq_index) {
 	// if instruction sucessfully added then only pass the instruction to function units
 	int add_position = -1;
 
-	for (int i=0; i<LSQ_SIZE; i++) {
+	for (int i=0; i<ls_queue->size; i++) {
 		if (ls_queue->lsq_entries[i].status == INVALID) {
 			add_position = i;
 			break;
@@ -312,41 +456,44 @@ int add_ls_queue_entry(APEX_LSQ* ls_queue, LS_IQ_Entry ls_iq_entry, int* lsq_ind
 	else {
 		*lsq_index = add_position;
 		ls_queue->lsq_entries[add_position].status = VALID;
-		ls_queue->lsq_entries[add_position].load_store = ls_iq_entry.inst_type;
-		ls_queue->lsq_entries[add_position].inst_ptr = ls_iq_entry.pc;
-		ls_queue->lsq_entries[add_position].rd = ls_iq_entry.rd;
-		ls_queue->lsq_entries[add_position].rd_value = ls_iq_entry.rd_value;
-		ls_queue->lsq_entries[add_position].rs1 = ls_iq_entry.rs1;
-		ls_queue->lsq_entries[add_position].rs1_value = ls_iq_entry.rs1_value;
-		ls_queue->lsq_entries[add_position].rs2 = ls_iq_entry.rs2;
-		ls_queue->lsq_entries[add_position].rs2_value = ls_iq_entry.rs2_value;
-		ls_queue->lsq_entries[add_position].literal = ls_iq_entry.buffer;
+		ls_queue->lsq_entries[add_position].load_store = ls_iq_entry->inst_type;
+		ls_queue->lsq_entries[add_position].inst_ptr = ls_iq_entry->pc;
+		ls_queue->lsq_entries[add_position].rd = ls_iq_entry->rd;
+		ls_queue->lsq_entries[add_position].rd_value = ls_iq_entry->rd_value;
+		ls_queue->lsq_entries[add_position].rs1 = ls_iq_entry->rs1;
+		ls_queue->lsq_entries[add_position].rs1_value = ls_iq_entry->rs1_value;
+		ls_queue->lsq_entries[add_position].rs2 = ls_iq_entry->rs2;
+		ls_queue->lsq_entries[add_position].rs2_value = ls_iq_entry->rs2_value;
+		ls_queue->lsq_entries[add_position].literal = ls_iq_entry->buffer;
 		ls_queue->lsq_entries[add_position].mem_valid = INVALID;
-		if ((ls_iq_entry.inst_type==STORE)||(ls_iq_entry.inst_type==STR)) {
-			ls_queue->lsq_entries[add_position].data_ready = ls_iq_entry.rd_valid;
+		if ((ls_iq_entry->inst_type==STORE)||(ls_iq_entry->inst_type==STR)) {
+			ls_queue->lsq_entries[add_position].data_ready = ls_iq_entry->rd_valid;
 		}
 		else {
 			ls_queue->lsq_entries[add_position].data_ready = INVALID;
 		}
 		ls_queue->lsq_entries[add_position].stage_cycle = INVALID;
+		ls_queue->lsq_entries[add_position].rob_index = ls_iq_entry->rob_index;
+		ls_queue->lsq_entries[add_position].seq = ls_queue->next_seq;
+		ls_queue->next_seq += 1;
 	}
 	return SUCCESS;
 }
 
 
-int update_ls_queue_entry_mem_address(APEX_LSQ* ls_queue, LS_IQ_Entry ls_iq_entry) {
+int update_ls_queue_entry_mem_address(APEX_LSQ* ls_queue, const LS_IQ_Entry* ls_iq_entry) {
 
-	if (ls_iq_entry.lsq_index<0) {
+	if (ls_iq_entry->lsq_index<0) {
 		return FAILURE;
 	}
 	else {
 		// same inst data can be copied
-		if (ls_queue->lsq_entries[ls_iq_entry.lsq_index].inst_ptr == ls_iq_entry.pc) {
-			ls_queue->lsq_entries[ls_iq_entry.lsq_index].mem_address = ls_iq_entry.mem_address;
-			ls_queue->lsq_entries[ls_iq_entry.lsq_index].mem_valid = VALID;
-			// if (ls_queue->lsq_entries[ls_iq_entry.lsq_index].rd==ls_iq_entry.rd) {
-			// 	ls_queue->lsq_entries[ls_iq_entry.lsq_index].rd_value = ls_iq_entry.rd_value;
-			// 	ls_queue->lsq_entries[ls_iq_entry.lsq_index].data_ready = VALID;
+		if (ls_queue->lsq_entries[ls_iq_entry->lsq_index].inst_ptr == ls_iq_entry->pc) {
+			ls_queue->lsq_entries[ls_iq_entry->lsq_index].mem_address = ls_iq_entry->mem_address;
+			ls_queue->lsq_entries[ls_iq_entry->lsq_index].mem_valid = VALID;
+			// if (ls_queue->lsq_entries[ls_iq_entry->lsq_index].rd==ls_iq_entry->rd) {
+			// 	ls_queue->lsq_entries[ls_iq_entry->lsq_index].rd_value = ls_iq_entry->rd_value;
+			// 	ls_queue->lsq_entries[ls_iq_entry->lsq_index].data_ready = VALID;
 			// }
 		}
 	}
@@ -355,16 +502,16 @@ int update_ls_queue_entry_mem_address(APEX_LSQ* ls_queue, LS_IQ_Entry ls_iq_entr
 }
 
 
-int update_ls_queue_entry_reg(APEX_LSQ* ls_queue, LS_IQ_Entry ls_iq_entry) {
+int update_ls_queue_entry_reg(APEX_LSQ* ls_queue, const LS_IQ_Entry* ls_iq_entry) {
 
 	int update_pos = -1;
 
-	for (int i=0; i<LSQ_SIZE; i++) {
+	for (int i=0; i<ls_queue->size; i++) {
 		if (ls_queue->lsq_entries[i].status == VALID) {
 			if (ls_queue->lsq_entries[i].data_ready==INVALID) {
 				if ((ls_queue->lsq_entries[i].load_store==STORE)||(ls_queue->lsq_entries[i].load_store==STR)) {
-					if (ls_queue->lsq_entries[i].rd==ls_iq_entry.rd) {
-						ls_queue->lsq_entries[i].rd_value = ls_iq_entry.rd_value;
+					if (ls_queue->lsq_entries[i].rd==ls_iq_entry->rd) {
+						ls_queue->lsq_entries[i].rd_value = ls_iq_entry->rd_value;
 						ls_queue->lsq_entries[i].data_ready = VALID;
 						update_pos = i;
 					}
@@ -380,51 +527,84 @@ int update_ls_queue_entry_reg(APEX_LSQ* ls_queue, LS_IQ_Entry ls_iq_entry) {
 }
 
 
-int get_ls_queue_index_to_issue(APEX_LSQ* ls_queue, int* lsq_index) {
-
-	int index = -1;
-	int prev_index = -1;
-	int cycle = 0;
-	int prev_cycle = 0;
+static int is_ls_queue_entry_ready(LSQ_FORMAT* lsq_entry) {
+	// memory address must be ready and for STORE or STR the data as well
+	if ((lsq_entry->load_store==STORE)||(lsq_entry->load_store==STR)) {
+		return ((lsq_entry->mem_valid)&&(lsq_entry->data_ready)) ? VALID : INVALID;
+	}
+	return (lsq_entry->mem_valid) ? VALID : INVALID;
+}
 
-	for (int i=0; i<LSQ_SIZE; i++) {
 
+static int get_ls_queue_head(APEX_LSQ* ls_queue) {
+	// oldest allotted entry, seq difference keeps working after it wraps
+	int head = -1;
+	for (int i=0; i<ls_queue->size; i++) {
 		if (ls_queue->lsq_entries[i].status == VALID) {
-			if ((ls_queue->lsq_entries[i].load_store==STORE)||(ls_queue->lsq_entries[i].load_store==STR)) {
-				if ((ls_queue->lsq_entries[i].mem_valid)&&(ls_queue->lsq_entries[i].data_ready)) {
-					index = i;
-					cycle = ls_queue->lsq_entries[i].stage_cycle;
-				}
-			}
-			else {
-				if (ls_queue->lsq_entries[i].mem_valid) {
-					index = i;
-					cycle = ls_queue->lsq_entries[i].stage_cycle;
-				}
+			if ((head<0)||((int)(ls_queue->lsq_entries[i].seq - ls_queue->lsq_entries[head].seq) < 0)) {
+				head = i;
 			}
-
-		if (cycle > prev_cycle) {
-			prev_cycle = cycle;
-			prev_index = index;
 		}
-		ls_queue->lsq_entries[i].stage_cycle += 1;
+	}
+	return head;
+}
+
+
+int get_ls_queue_index_to_issue(APEX_LSQ* ls_queue, int* lsq_index) {
+	// loads and stores go to Mem FU in program order so a load never passes an older store
+	int index = get_ls_queue_head(ls_queue);
+
+	for (int i=0; i<ls_queue->size; i++) {
+		if (ls_queue->lsq_entries[i].status == VALID) {
+			ls_queue->lsq_entries[i].stage_cycle += 1;
 		}
 	}
 
-	if (prev_index<0) {
+	if ((index<0)||(!is_ls_queue_entry_ready(&ls_queue->lsq_entries[index]))) {
 		return FAILURE;
 	}
 	else {
-		*lsq_index = prev_index;
+		*lsq_index = index;
 	}
 	return SUCCESS;
 }
 
 
+int has_ls_queue_ready_entry(APEX_LSQ* ls_queue) {
+	// same check as get_ls_queue_index_to_issue but without aging the entries
+	int index = get_ls_queue_head(ls_queue);
+	if ((index>=0)&&(is_ls_queue_entry_ready(&ls_queue->lsq_entries[index]))) {
+		return SUCCESS;
+	}
+	return FAILURE;
+}
+
+
+int get_ls_queue_count(APEX_LSQ* ls_queue) {
+	int count = 0;
+	for (int i=0; i<ls_queue->size; i++) {
+		if (ls_queue->lsq_entries[i].status == VALID) {
+			count += 1;
+		}
+	}
+	return count;
+}
+
+
+void age_ls_queue_entries(APEX_LSQ* ls_queue, int cycles) {
+	// bulk version of the stage_cycle increment done every cycle by get_ls_queue_index_to_issue
+	for (int i=0; i<ls_queue->size; i++) {
+		if (ls_queue->lsq_entries[i].status == VALID) {
+			ls_queue->lsq_entries[i].stage_cycle += cycles;
+		}
+	}
+}
+
+
 void clear_ls_queue_entry(APEX_LSQ* ls_queue) {
 
 	// clear all rob entries
-	for(int i=0; i<LSQ_SIZE; i++) {
+	for(int i=0; i<ls_queue->size; i++) {
 		ls_queue->lsq_entries[i].status = INVALID;
 		ls_queue->lsq_entries[i].load_store = INVALID;
 		ls_queue->lsq_entries[i].inst_ptr = INVALID;
@@ -439,6 +619,7 @@ void clear_ls_queue_entry(APEX_LSQ* ls_queue) {
 		ls_queue->lsq_entries[i].rs2_value = INVALID;
 		ls_queue->lsq_entries[i].literal = INVALID;
 		ls_queue->lsq_entries[i].stage_cycle = INVALID;
+		ls_queue->lsq_entries[i].rob_index = INVALID;
 	}
 }
 
@@ -446,7 +627,6 @@ void clear_ls_queue_entry(APEX_LSQ* ls_queue) {
 void print_ls_iq_content(APEX_LSQ* ls_queue, APEX_IQ* issue_queue) {
 	// if require to print the instruction instead of type just call the func fron cpu to print inst
 	if (ENABLE_REG_MEM_STATUS_PRINT) {
-		char* inst_type_str = (char*) malloc(10);
 		printf("\n============ STATE OF ISSUE QUEUE ============\n");
 		printf("Index, "
 						"Status, "
@@ -457,9 +637,7 @@ void print_ls_iq_content(APEX_LSQ* ls_queue, APEX_IQ* issue_queue) {
 						"Rs2-value-ready, "
 						"literal, "
 						"LSQ Index\n");
-		for (int i=0;i<IQ_SIZE;i++) {
-			strcpy(inst_type_str, "");
-			get_inst_name(issue_queue->iq_entries[i].inst_type, inst_type_str);
+		for (int i=0;i<issue_queue->size;i++) {
 			printf("%02d\t|"
 							"\t%d\t|"
 							"\t%d\t|"
@@ -472,7 +650,7 @@ void print_ls_iq_content(APEX_LSQ* ls_queue, APEX_IQ* issue_queue) {
 							i,
 							issue_queue->iq_entries[i].status,
 							issue_queue->iq_entries[i].inst_type,
-							inst_type_str,
+							get_inst_name(issue_queue->iq_entries[i].inst_type),
 							issue_queue->iq_entries[i].rd, issue_queue->iq_entries[i].rd_value, issue_queue->iq_entries[i].rd_ready,
 							issue_queue->iq_entries[i].rs1, issue_queue->iq_entries[i].rs1_value, issue_queue->iq_entries[i].rs1_ready,
 							issue_queue->iq_entries[i].rs2, issue_queue->iq_entries[i].rs2_value, issue_queue->iq_entries[i].rs2_ready,
@@ -490,9 +668,7 @@ void print_ls_iq_content(APEX_LSQ* ls_queue, APEX_IQ* issue_queue) {
 						"Rs1-value, "
 						"Rs2-value, "
 						"literal\n");
-		for (int i=0;i<LSQ_SIZE;i++) {
-			strcpy(inst_type_str, "");
-			get_inst_name(ls_queue->lsq_entries[i].load_store, inst_type_str);
+		for (int i=0;i<ls_queue->size;i++) {
 			printf("%02d\t|"
 							"\t%d\t|"
 							"\t%d\t|"
@@ -506,7 +682,7 @@ void print_ls_iq_content(APEX_LSQ* ls_queue, APEX_IQ* issue_queue) {
 							i,
 							ls_queue->lsq_entries[i].status,
 							ls_queue->lsq_entries[i].load_store,
-							inst_type_str,
+							get_inst_name(ls_queue->lsq_entries[i].load_store),
 							ls_queue->lsq_entries[i].mem_valid,
 							ls_queue->lsq_entries[i].data_ready,
 							ls_queue->lsq_entries[i].rd, ls_queue->lsq_entries[i].rd_value,
@@ -515,6 +691,5 @@ void print_ls_iq_content(APEX_LSQ* ls_queue, APEX_IQ* issue_queue) {
 							ls_queue->lsq_entries[i].literal);
 
 		}
-		free(inst_type_str);
 	}
 }
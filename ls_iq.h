@@ -9,10 +9,29 @@
  *  State University of New York, Binghamton
 */
 
+#include <stdint.h>
+#include <stddef.h>
 
+#include "rob.h"
+
+
+/* Default sizes, the ones used are passed to init at run time */
+#ifndef IQ_SIZE
 #define IQ_SIZE 8
+#endif
 
+#ifndef LSQ_SIZE
 #define LSQ_SIZE 6
+#endif
+
+// func units an IQ entry can be issued to
+enum {
+	IQ_FU_INT,
+	IQ_FU_MUL,
+	IQ_FU_BRANCH,
+	IQ_FU_NONE,
+	NUM_IQ_FU
+};
 
 
 /* Format of an APEX Issue Queue mechanism  */
@@ -30,8 +49,9 @@ typedef struct IQ_FORMAT {
 	int rs2;						// holds src2 reg tag
 	int rs2_ready;			// indicate if src2 is ready
 	int rs2_value;			// holds src2 reg value
-	int stage_cycle;		// holds src2 reg value
+	int fu_type;				// func unit inst is issued to
 	int lsq_index;			// to address lSQ entry in issue queue
+	int rob_index;			// to address ROB entry of the instruction
 } IQ_FORMAT;
 
 
@@ -51,16 +71,30 @@ typedef struct LSQ_FORMAT {
 	int rs2_value;			// holds src1 reg value
 	int literal;				// hold literal value
 	int stage_cycle;
+	int rob_index;			// to address ROB entry of the instruction
+	unsigned int seq;		// dispatch order, memory is accessed in program order
 } LSQ_FORMAT;
 
 
 typedef struct APEX_IQ {
-	IQ_FORMAT iq_entries[IQ_SIZE];
+	int size;						// number of IQ entries
+	int mask_words;					// IQ entries are tracked as bits in mask_words 64 bit words
+	int tag_count;					// phys reg tags an entry can wait on
+	IQ_FORMAT* iq_entries;
+	uint64_t* valid_mask;			// allotted entries
+	uint64_t* ready_mask;			// entries with all required src regs ready
+	uint64_t* fu_mask[NUM_IQ_FU];		// entries by func unit
+	uint64_t* age_matrix;			// size rows, row i has bit j set if entry j is older than entry i
+	uint64_t* tag_waiters;			// tag_count rows, entries waiting on a phys reg tag
+	uint64_t* candidates;			// scratch row for select
+	uint64_t* mask_storage;		// single allocation all masks point into
 }APEX_IQ;
 
 
 typedef struct APEX_LSQ {
-	LSQ_FORMAT lsq_entries[LSQ_SIZE];
+	int size;						// number of LSQ entries
+	LSQ_FORMAT* lsq_entries;
+	unsigned int next_seq;		// seq given to next added entry
 }APEX_LSQ;
 
 /* Format of an Load Store & Issue Queue entry/update mechanism  */
@@ -80,29 +114,37 @@ typedef struct LS_IQ_Entry {
 	int buffer;
 	int mem_address;
 	int lsq_index;
+	int rob_index;
 	int stage_cycle;
 } LS_IQ_Entry;
 
 
-APEX_IQ* init_issue_queue();
+APEX_IQ* init_issue_queue(int iq_size, int tag_count);
 void deinit_issue_queue(APEX_IQ* issue_queue);
+size_t get_issue_queue_mask_bytes(const APEX_IQ* issue_queue);
 
 int can_add_entry_in_issue_queue(APEX_IQ* issue_queue);
-int add_issue_queue_entry(APEX_IQ* issue_queue, LS_IQ_Entry ls_iq_entry, int* lsq_index);
+int add_issue_queue_entry(APEX_IQ* issue_queue, const LS_IQ_Entry* ls_iq_entry, int* lsq_index);
 
-int update_issue_queue_entry(APEX_IQ* issue_queue, LS_IQ_Entry ls_iq_entry);
-int get_issue_queue_index_to_issue(APEX_IQ* issue_queue, int* issue_index);
+int update_issue_queue_entry(APEX_IQ* issue_queue, const LS_IQ_Entry* ls_iq_entry);
+int get_issue_queue_index_to_issue(APEX_IQ* issue_queue, int fu_type, int* issue_index);
+void remove_issue_queue_entry(APEX_IQ* issue_queue, int issue_index);
+int has_issue_queue_ready_entry(APEX_IQ* issue_queue);
+int get_issue_queue_count(APEX_IQ* issue_queue);
 
-APEX_LSQ* init_ls_queue();
+APEX_LSQ* init_ls_queue(int lsq_size);
 void deinit_ls_queue(APEX_LSQ* ls_queue);
 
 int can_add_entry_in_ls_queue(APEX_LSQ* ls_queue);
-int add_ls_queue_entry(APEX_LSQ* ls_queue, LS_IQ_Entry ls_iq_entry, int* add_position);
+int add_ls_queue_entry(APEX_LSQ* ls_queue, const LS_IQ_Entry* ls_iq_entry, int* add_position);
 
-int update_ls_queue_entry_mem_address(APEX_LSQ* ls_queue, LS_IQ_Entry ls_iq_entry);
-int update_ls_queue_entry_reg(APEX_LSQ* ls_queue, LS_IQ_Entry ls_iq_entry);
+int update_ls_queue_entry_mem_address(APEX_LSQ* ls_queue, const LS_IQ_Entry* ls_iq_entry);
+int update_ls_queue_entry_reg(APEX_LSQ* ls_queue, const LS_IQ_Entry* ls_iq_entry);
 
 int get_ls_queue_index_to_issue(APEX_LSQ* ls_queue, int* lsq_index);
+int has_ls_queue_ready_entry(APEX_LSQ* ls_queue);
+int get_ls_queue_count(APEX_LSQ* ls_queue);
+void age_ls_queue_entries(APEX_LSQ* ls_queue, int cycles);
 
 void clear_issue_queue_entry(APEX_IQ* issue_queue);
 void clear_ls_queue_entry(APEX_LSQ* ls_queue);
@@ -9,49 +9,376 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
 
+#include "apex.h"
 #include "cpu.h"
-#include "ls_iq.h"
-#include "rob.h"
 
 
 
-int main(int argc, char const* argv[]) {
+static double get_wall_time() {
+	// monotonic wall clock in seconds, used to report simulation speed
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+
+static int is_valid_func(const char* func) {
+	return ((strcmp(func, "display") == 0)||(strcmp(func, "simulate") == 0)||(strcmp(func, "batch") == 0));
+}
+
+
+static void print_run_result(int ret) {
+	// ret is an APEX_SIM_* code, HALT and running out of cycles or inst are both normal ends
+	if (ret == APEX_SIM_HALTED) {
+		printf("Simulation Complete\n");
+	}
+	else if (ret == APEX_SIM_RUNNING) {
+		printf("Simulation Stopped, HALT not reached\n");
+	}
+	else {
+		printf("Simulation Failed, Return Code %d\n", ret);
+	}
+}
+
+
+static int run_functional(APEX_Sim* sim, const char* count) {
+	// functional mode takes an inst count instead of cycles, it can be larger than an int
+	char* end = NULL;
+	long long max_instructions = strtoll(count, &end, 10);
+	if ((end == count)||(*end != '\0')||(max_instructions < 1)) {
+		fprintf(stderr, "Number of Instructions must be a number larger than 0\n");
+		return APEX_SIM_ERROR;
+	}
+	double start_time = get_wall_time();
+	int ret = APEX_sim_run_functional(sim, max_instructions);
+	double run_time = get_wall_time() - start_time;
+	print_run_result(ret);
+	APEX_sim_print_summary(sim, run_time);
+	APEX_sim_print_arch_state(sim);
+	return ret;
+}
+
+
+/* Options of one run, not part of the machine config */
+typedef struct Run_Options {
+	long long fast_forward;		// inst run functionally before timing starts
+	long long warmup;		// cycles run after fast forward and not counted
+	const char* load_checkpoint;		// machine state to start from
+	const char* save_checkpoint;		// machine state is written here at the end
+	long long checkpoint_every;		// cycles between checkpoints while running, 0 saves only at the end
+	APEX_Sample_Config sample;		// sizes and target of sample mode
+	int native;		// functional runs and fast forward use the program compiled to native code
+	int check;		// every commit is checked against the functional golden model
+} Run_Options;
+
+
+static double get_confidence_z(double confidence) {
+	// z score of the usual two sided confidence levels, 0 for others
+	const double levels[][2] = {{90.0, 1.645}, {95.0, 1.960}, {99.0, 2.576}, {99.7, 3.0}};
+	for (int i=0; i<(int)(sizeof(levels)/sizeof(levels[0])); i++) {
+		if (fabs(confidence - levels[i][0]) < 1e-9) {
+			return levels[i][1];
+		}
+	}
+	return 0.0;
+}
+
+
+static int parse_run_option(const char* option, Run_Options* options) {
+	// returns FAILURE when option is not a run option
+	char* end = NULL;
+	if (strncmp(option, "--fast_forward=", 15) == 0) {
+		options->fast_forward = strtoll(option + 15, &end, 10);
+	}
+	else if (strncmp(option, "--warmup=", 9) == 0) {
+		options->warmup = strtoll(option + 9, &end, 10);
+	}
+	else if (strncmp(option, "--checkpoint_every=", 19) == 0) {
+		options->checkpoint_every = strtoll(option + 19, &end, 10);
+	}
+	else if (strncmp(option, "--sample_unit=", 14) == 0) {
+		options->sample.unit_size = strtoll(option + 14, &end, 10);
+	}
+	else if (strncmp(option, "--sample_warmup=", 16) == 0) {
+		options->sample.warmup_size = strtoll(option + 16, &end, 10);
+	}
+	else if (strncmp(option, "--sample_initial=", 17) == 0) {
+		options->sample.initial_samples = (int)strtol(option + 17, &end, 10);
+	}
+	else if (strncmp(option, "--sample_error=", 15) == 0) {
+		// percent on the command line
+		options->sample.target_error = strtod(option + 15, &end) / 100.0;
+	}
+	else if (strncmp(option, "--sample_confidence=", 20) == 0) {
+		options->sample.z = get_confidence_z(strtod(option + 20, &end));
+	}
+	else if (strncmp(option, "--sample_threads=", 17) == 0) {
+		options->sample.threads = (int)strtol(option + 17, &end, 10);
+	}
+	else if (strcmp(option, "--engine=native") == 0) {
+		options->native = 1;
+	}
+	else if (strcmp(option, "--engine=interp") == 0) {
+		options->native = 0;
+	}
+	else if (strcmp(option, "--check") == 0) {
+		options->check = 1;
+	}
+	else if (strncmp(option, "--load_checkpoint=", 18) == 0) {
+		options->load_checkpoint = option + 18;
+	}
+	else if (strncmp(option, "--save_checkpoint=", 18) == 0) {
+		options->save_checkpoint = option + 18;
+	}
+	else {
+		return FAILURE;
+	}
+	if (((end)&&(*end != '\0'))||(options->fast_forward < 0)||(options->warmup < 0)||(options->checkpoint_every < 0)||(options->sample.z <= 0.0)) {
+		fprintf(stderr, "APEX_Error : Invalid value in '%s'\n", option);
+		exit(1);
+	}
+	return SUCCESS;
+}
+
+
+static int run_cycles(APEX_Sim* sim, long long num_cycle, const Run_Options* options) {
+	// steps in checkpoint_every chunks so a long run can be resumed from the last checkpoint
+	long long chunk = ((options->save_checkpoint)&&(options->checkpoint_every > 0)) ? options->checkpoint_every : num_cycle;
+	int ret = APEX_SIM_RUNNING;
+	while ((num_cycle > 0)&&(ret == APEX_SIM_RUNNING)) {
+		long long cycles = (chunk < num_cycle) ? chunk : num_cycle;
+		ret = APEX_sim_step(sim, cycles);
+		num_cycle -= cycles;
+		if ((num_cycle > 0)&&(ret == APEX_SIM_RUNNING)&&(options->save_checkpoint)) {
+			APEX_sim_save_checkpoint(sim, options->save_checkpoint);
+		}
+	}
+	return ret;
+}
+
+
+static int fast_forward(APEX_Sim* sim, long long num_instructions, long long warmup) {
+	// skip the part of the program which is not timed, pipeline continues from the arch state
+	double start_time = get_wall_time();
+	int ret = APEX_sim_fast_forward(sim, num_instructions, warmup);
+	double run_time = get_wall_time() - start_time;
+	APEX_Stats stats;
+	APEX_sim_get_stats(sim, &stats);
+	printf("Fast Forward %lld Instructions, %lld Warmup Cycles in %.6f s, Return Code %d\n", stats.functional_instructions, warmup, run_time, ret);
+	return ret;
+}
+
+
+static APEX_Sim* create_native_sim(const char* filename, const APEX_Config* config, int verbose, APEX_Program** program, APEX_Native** native) {
+	// native code is compiled from the parsed program, the handle is created from the same program
+	*program = APEX_program_load(filename);
+	if (!*program) {
+		return NULL;
+	}
+	double start_time = get_wall_time();
+	*native = APEX_native_compile(*program);
+	double compile_time = get_wall_time() - start_time;
+	if (!*native) {
+		fprintf(stderr, "APEX_Error : Unable to compile %s to native code\n", filename);
+		return NULL;
+	}
+	printf("Native Compile in %.6f s\n", compile_time);
+	APEX_Sim* sim = APEX_sim_create_from_program(*program, config, verbose);
+	if ((sim)&&(APEX_sim_set_native(sim, *native) != 0)) {
+		APEX_sim_destroy(sim);
+		return NULL;
+	}
+	return sim;
+}
+
+
+static void destroy_sim(APEX_Sim* sim, APEX_Native* native, APEX_Program* program) {
+	// handle first, native code and program are only freed once nothing uses them
+	APEX_sim_destroy(sim);
+	APEX_native_free(native);
+	APEX_program_free(program);
+}
+
+
+static int run_sample(const char* filename, const APEX_Config* config, const char* count, Run_Options* options) {
+	// sample mode builds its own machines from the parsed program, one per round
+	char* end = NULL;
+	options->sample.max_instructions = strtoll(count, &end, 10);
+	if ((end == count)||(*end != '\0')||(options->sample.max_instructions < 1)) {
+		fprintf(stderr, "Number of Instructions must be a number larger than 0\n");
+		return APEX_SIM_ERROR;
+	}
+	APEX_Program* program = APEX_program_load(filename);
+	if (!program) {
+		fprintf(stderr, "APEX_Error : Unable to load %s\n", filename);
+		return APEX_SIM_ERROR;
+	}
+	APEX_Sample_Result result;
+	double start_time = get_wall_time();
+	int ret = APEX_sample_run(program, config, &options->sample, &result);
+	double run_time = get_wall_time() - start_time;
+	APEX_program_free(program);
+	if (ret != 0) {
+		fprintf(stderr, "APEX_Error : Sampling failed\n");
+		return APEX_SIM_ERROR;
+	}
+
+	printf("\n============ SAMPLING SUMMARY ============\n");
+	printf("Program Ins:    %lld\n", result.program_instructions);
+	if (result.exact) {
+		printf("Samples:        none, program is shorter than %d units, ran it all in the pipeline\n", options->sample.initial_samples);
+		printf("CPI:            %.4f (exact)\n", result.cpi);
+	}
+	else {
+		printf("Samples:        %d in round %d, %lld inst units after %lld inst warmup, %d threads\n", result.samples, result.rounds, options->sample.unit_size, options->sample.warmup_size, options->sample.threads);
+		printf("CPI:            %.4f, interval %.4f to %.4f (z %.3f)\n", result.cpi, result.cpi_low, result.cpi_high, options->sample.z);
+		printf("Error:          %.2f%%, target %.2f%% %s\n", result.error * 100.0, options->sample.target_error * 100.0, result.target_met ? "met" : "not met");
+	}
+	printf("IPC:            %.4f\n", (result.cpi > 0.0) ? 1.0 / result.cpi : 0.0);
+	printf("Pipeline:       %lld cycles, %lld inst\n", result.detailed_cycles, result.detailed_instructions);
+	printf("Functional Ins: %lld\n", result.functional_instructions);
+	printf("Wall Time:      %.6f s\n", run_time);
+	return 0;
+}
+
+
+static void print_usage(const char* program) {
+	fprintf(stderr, "APEX_Help : For One Time Execution !!!\n");
+	fprintf(stderr, "Type: %s <input_file> <func(eg: simulate, display Or batch)> <num_cycle> [verbose(0-%d)] [--config=<file>] [--<key>=<value>]\n", program, NUM_VERBOSE-1);
+	fprintf(stderr, "APEX_Help : For Functional Execution, no timing !!!\n");
+	fprintf(stderr, "Type: %s <input_file> functional <num_instructions> [--config=<file>] [--<key>=<value>]\n", program);
+	fprintf(stderr, "APEX_Help : Timed runs can start with --fast_forward=<num_instructions> run functionally and --warmup=<num_cycle> not counted\n");
+	fprintf(stderr, "APEX_Help : --check compares every commit with the functional model and stops at the first difference\n");
+	fprintf(stderr, "APEX_Help : --engine=native runs functional mode and fast forward on the program compiled with the local cc\n");
+	fprintf(stderr, "APEX_Help : --load_checkpoint=<file> starts from a saved machine, --save_checkpoint=<file> [--checkpoint_every=<num_cycle>] saves one\n");
+	fprintf(stderr, "APEX_Help : For Sampled Execution, CPI with a confidence interval !!!\n");
+	fprintf(stderr, "Type: %s <input_file> sample <num_instructions> [--sample_unit=<n>] [--sample_warmup=<n>] [--sample_initial=<n>] [--sample_error=<percent>] [--sample_confidence=<90|95|99|99.7>] [--sample_threads=<n>]\n", program);
+	fprintf(stderr, "APEX_Help : For N Time Execution !!!\n");
+	fprintf(stderr, "Type: %s <input_file> [--config=<file>] [--<key>=<value>]\n", program);
+	print_config_keys();
+}
+
+
+int main(int argc_all, char const* argv_all[]) {
 
 	char command[20];
 	char* cmd;
-	int num_cycle = 0;
-	char func[10];
+	long long num_cycle = 0;
+	char func[20];
+	int verbose = VERBOSE_ALL;
+	Run_Options options = {0};
+	APEX_sample_default_config(&options.sample);
+	// sample windows run on every core unless --sample_threads says otherwise
+	options.sample.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (options.sample.threads < 1) {
+		options.sample.threads = 1;
+	}
+
+	// --options can be anywhere, they are applied in order and removed from the positional arguments
+	APEX_Config config;
+	init_default_config(&config);
+	for (int i=1; i<argc_all; i++) {
+		// a checkpoint brings its own config, --<key> options still apply on top of it
+		if (strncmp(argv_all[i], "--load_checkpoint=", 18) == 0) {
+			if (APEX_checkpoint_get_config(argv_all[i] + 18, &config) != SUCCESS) {
+				exit(1);
+			}
+		}
+	}
+	int argc = 0;
+	char const* argv[5];
+	for (int i=0; i<argc_all; i++) {
+		if ((i>0)&&(strncmp(argv_all[i], "--", 2) == 0)) {
+			if (parse_run_option(argv_all[i], &options) == SUCCESS) {
+				continue;
+			}
+			if (parse_config_option(&config, argv_all[i]) != SUCCESS) {
+				print_usage(argv_all[0]);
+				exit(1);
+			}
+		}
+		else if (argc < 5) {
+			argv[argc++] = argv_all[i];
+		}
+		else {
+			argc = 0; // too many arguments, reported below
+			break;
+		}
+	}
+	if (check_config(&config) != SUCCESS) {
+		exit(1);
+	}
 	// argc = count of arguments, executable being 1st argument in argv[0]
-	if ((argc == 4)||(argc == 2)) {
-		fprintf(stderr, "APEX_INFO : Initializing CPU !!!\n");
-		APEX_CPU* cpu = APEX_cpu_init(argv[1]);
-		APEX_LSQ* ls_queue = init_ls_queue();
-		APEX_IQ* issue_queue = init_issue_queue();
-		APEX_ROB* rob = init_reorder_buffer();
-		APEX_RENAME* rename_table = init_rename_table();
-
-		if ((!cpu)||(!issue_queue)||(!ls_queue)||(!rob)||(!rename_table)) {
+	if ((argc == 5)||(argc == 4)||(argc == 2)) {
+		if (argc >= 4) {
+			strncpy(func, argv[2], sizeof(func)-1);
+			func[sizeof(func)-1] = '\0';
+			if ((strcmp(func, "batch") == 0)||(strcmp(func, "functional") == 0)) {
+				verbose = VERBOSE_QUIET;
+			}
+			if (argc == 5) {
+				verbose = atoi(argv[4]);
+				if ((verbose < VERBOSE_QUIET)||(verbose >= NUM_VERBOSE)) {
+					fprintf(stderr, "Verbosity must be between %d and %d\n", VERBOSE_QUIET, NUM_VERBOSE-1);
+					exit(1);
+				}
+			}
+		}
+		if ((argc >= 4)&&(strcmp(func, "sample") == 0)) {
+			exit((run_sample(argv[1], &config, argv[3], &options) == 0) ? 0 : 1);
+		}
+		if (verbose > VERBOSE_QUIET) {
+			fprintf(stderr, "APEX_INFO : Initializing CPU !!!\n");
+		}
+		APEX_Program* program = NULL;
+		APEX_Native* native = NULL;
+		APEX_Sim* sim = (options.native) ? create_native_sim(argv[1], &config, verbose, &program, &native) : APEX_sim_create(argv[1], &config, verbose);
+
+		if (!sim) {
 			fprintf(stderr, "APEX_Error : Unable to initialize CPU\n");
+			destroy_sim(NULL, native, program);
 			exit(1);
 		}
-		int ret = 0;
-		if (argc == 4) {
-			strcpy(func, argv[2]);
-			num_cycle = atoi(argv[3]);
-			if (((strcmp(func, "display") == 0)||(strcmp(func, "simulate")==0))&&(num_cycle>0)) {
-				ret = APEX_cpu_run(cpu, num_cycle, ls_queue, issue_queue, rob, rename_table);
-				if (ret == SUCCESS) {
-					printf("Simulation Complete\n");
-				}
-				else {
-					printf("Simulation Return Code %d\n",ret);
+		int ret = APEX_SIM_RUNNING;
+		// checker goes on first, a checkpoint with inst in flight then turns it off with a note and the run goes on
+		if ((options.check)&&(APEX_sim_set_checker(sim, 1) != 0)) {
+			destroy_sim(sim, native, program);
+			exit(1);
+		}
+		if ((options.load_checkpoint)&&(APEX_sim_load_checkpoint(sim, options.load_checkpoint) != 0)) {
+			destroy_sim(sim, native, program);
+			exit(1);
+		}
+		int timed_run = (argc == 2)||(strcmp(func, "functional") != 0);
+		if ((timed_run)&&((options.fast_forward > 0)||(options.warmup > 0))) {
+			if (fast_forward(sim, options.fast_forward, options.warmup) == APEX_SIM_ERROR) {
+				destroy_sim(sim, native, program);
+				exit(1);
+			}
+		}
+		if ((argc >= 4)&&(strcmp(func, "functional") == 0)) {
+			if (run_functional(sim, argv[3]) == APEX_SIM_ERROR) {
+				destroy_sim(sim, native, program);
+				exit(1);
+			}
+		}
+		else if (argc >= 4) {
+			num_cycle = atoll(argv[3]);
+			if ((is_valid_func(func))&&(num_cycle>0)) {
+				double start_time = get_wall_time();
+				ret = run_cycles(sim, num_cycle, &options);
+				double run_time = get_wall_time() - start_time;
+				print_run_result(ret);
+				if (strcmp(func, "batch") == 0) {
+					APEX_sim_print_summary(sim, run_time);
 				}
 				if (strcmp(func, "display") == 0) {
 					// show everything
-					print_cpu_content(cpu);
-					print_ls_iq_content(ls_queue, issue_queue);
-					print_rob_and_rename_content(rob, rename_table);
+					APEX_sim_print_state(sim);
 				}
 			}
 			else {
@@ -59,37 +386,33 @@ int main(int argc, char const* argv[]) {
 				if (!num_cycle) {
 					fprintf(stderr, "Number of Cycles cannot be 0\n");
 				}
-				fprintf(stderr, "APEX_Help : Usage %s <input_file> <func(eg: simulate Or display)> <num_cycle>\n", argv[0]);
+				fprintf(stderr, "APEX_Help : Usage %s <input_file> <func(eg: simulate, display Or batch)> <num_cycle> [verbose(0-%d)]\n", argv[0], NUM_VERBOSE-1);
 				exit(1);
 			}
 		}
 		else if (argc == 2) {
-			while (ret==0) {
+			while (ret == APEX_SIM_RUNNING) {
 				fprintf(stderr, "Usage ?: <func(eg: simulate Or display)> <num_cycle>\n");
 				fprintf(stderr, "Exit : exit<space><entre>\n");
 				fgets(command, 20, stdin);
 				cmd = strtok (command," ");
 				strcpy(func, cmd);
 				cmd = strtok (NULL," ");
-				num_cycle = atoi(cmd);
+				num_cycle = atoll(cmd);
 				if (strcmp(func, "exit") == 0) {
 					printf("Terminating Simulation\n");
 					ret = 1;
 					break;
 				}
 				if (((strcmp(func, "display") == 0)||(strcmp(func, "simulate")==0))&&(num_cycle>0)) {
-					ret = APEX_cpu_run(cpu, num_cycle, ls_queue, issue_queue, rob, rename_table);
-					if (ret == SUCCESS) {
-						printf("Simulation Complete\n");
-					}
-					else {
-						printf("Simulation Return Code %d\n",ret);
-					}
+					// num_cycle is the clock to run up to
+					APEX_Stats stats;
+					APEX_sim_get_stats(sim, &stats);
+					ret = (num_cycle > stats.cycles) ? APEX_sim_step(sim, num_cycle - stats.cycles) : APEX_SIM_RUNNING;
+					print_run_result(ret);
 					if (strcmp(func, "display") == 0) {
 						// show everything
-						print_cpu_content(cpu);
-						print_ls_iq_content(ls_queue, issue_queue);
-						print_rob_and_rename_content(rob, rename_table);
+						APEX_sim_print_state(sim);
 					}
 					// printf("FUNC :: %s, CYCLE  :: %d\n",func, num_cycle);
 				}
@@ -102,20 +425,21 @@ int main(int argc, char const* argv[]) {
 				}
 			}
 		}
-		printf("Press Any Key to Exit Simulation\n");
-		getchar();
-		deinit_issue_queue(issue_queue);
-		deinit_ls_queue(ls_queue);
-		deinit_rename_table(rename_table);
-		deinit_reorder_buffer(rob);
-		APEX_cpu_stop(cpu);
+		if ((options.save_checkpoint)&&(APEX_sim_save_checkpoint(sim, options.save_checkpoint) != 0)) {
+			ret = APEX_SIM_ERROR;
+		}
+		if (argc == 2) {
+			printf("Press Any Key to Exit Simulation\n");
+			getchar();
+		}
+		destroy_sim(sim, native, program);
+		if (ret == APEX_SIM_ERROR) {
+			exit(1);
+		}
 	}
 	else {
 		fprintf(stderr, "Invalid parameters passed !!!\n");
-		fprintf(stderr, "APEX_Help : For One Time Execution !!!\n");
-		fprintf(stderr, "Type: %s <input_file> <func(eg: simulate Or display)> <num_cycle>\n", argv[0]);
-		fprintf(stderr, "APEX_Help : For N Time Execution !!!\n");
-		fprintf(stderr, "Type: %s <input_file>\n", argv[0]);
+		print_usage(argv_all[0]);
 		exit(1);
 	}
 
@@ -19,14 +19,21 @@
  * ########################################## Reorder Buffer Stage ##########################################
 */
 
-APEX_ROB* init_reorder_buffer() {
+APEX_ROB* init_reorder_buffer(int rob_size) {
 
-	APEX_ROB* rob = malloc(sizeof(*rob));
+	if (rob_size < 1) {
+		return NULL;
+	}
+	APEX_ROB* rob = apex_malloc(sizeof(*rob));
 	if (!rob) {
 		return NULL;
 	}
-
-	memset(rob->rob_entry, 0, sizeof(APEX_ROB_ENTRY)*ROB_SIZE);  // all rob entry set to 0
+	rob->size = rob_size;
+	rob->rob_entry = apex_calloc(rob_size, sizeof(APEX_ROB_ENTRY));  // all rob entry set to 0
+	if (!rob->rob_entry) {
+		free(rob);
+		return NULL;
+	}
 	rob->commit_ptr = 0; // rob commit pointer set to 0
 	rob->issue_ptr = 0; // rob issue pointer set to 0
 	rob->buffer_length  = 0; // rob buffer length set to 0
@@ -34,34 +41,56 @@ APEX_ROB* init_reorder_buffer() {
 	return rob;
 }
 
-APEX_RENAME* init_rename_table() {
+static void reset_rename_alias_table(APEX_RENAME* rename_table) {
+	// no arch reg is renamed and every Pn is free, in order P0 to Pn
+	for (int i=0; i<REGISTER_FILE_SIZE; i++) {
+		rename_table->rat_rename[i] = -1;
+	}
+	for (int i=0; i<rename_table->size; i++) {
+		rename_table->free_list[i] = i;
+	}
+	rename_table->free_head = 0;
+	rename_table->free_count = rename_table->size;
+}
+
+APEX_RENAME* init_rename_table(int rename_table_size) {
 
-	APEX_RENAME* rename_table = malloc(sizeof(*rename_table));
+	if (rename_table_size < 1) {
+		return NULL;
+	}
+	APEX_RENAME* rename_table = apex_malloc(sizeof(*rename_table));
 	if (!rename_table) {
 		return NULL;
 	}
-
-	memset(rename_table->reg_rename, 0, sizeof(APEX_RENAME_TABLE)*RENAME_TABLE_SIZE);  // all rename table entry set to 0
-	memset(rename_table->rat_rename, 0, sizeof(APEX_ARF_TABLE)*RENAME_TABLE_SIZE);  // all rename table entry set to 0
-	rename_table->last_rename_pos = 0;
+	rename_table->size = rename_table_size;
+	rename_table->reg_rename = apex_calloc(rename_table_size, sizeof(APEX_RENAME_TABLE));  // all rename table entry set to 0
+	rename_table->free_list = apex_malloc(sizeof(int) * rename_table_size);
+	if ((!rename_table->reg_rename)||(!rename_table->free_list)) {
+		deinit_rename_table(rename_table);
+		return NULL;
+	}
+	reset_rename_alias_table(rename_table);
 
 	return rename_table;
 }
 
 void deinit_reorder_buffer(APEX_ROB* rob) {
+	free(rob->rob_entry);
 	free(rob);
 }
 
 void deinit_rename_table(APEX_RENAME* rename_table) {
+	free(rename_table->reg_rename);
+	free(rename_table->free_list);
 	free(rename_table);
 }
 
 
 int can_add_entry_in_reorder_buffer(APEX_ROB* rob) {
-	if (rob->issue_ptr == ROB_SIZE) {
+	if (rob->issue_ptr == rob->size) {
 		rob->issue_ptr = 0; // go back to zero index
 	}
-	if (rob->buffer_length == ROB_SIZE) {
+	if (rob->buffer_length == rob->size) {
 		return FAILURE;
 	}
 	else if (rob->rob_entry[rob->issue_ptr].status) { // checking if enrty if free
@@ -73,14 +102,14 @@ int can_add_entry_in_reorder_buffer(APEX_ROB* rob) {
 }
 
 
-int add_reorder_buffer_entry(APEX_ROB* rob, ROB_Entry rob_entry) {
+int add_reorder_buffer_entry(APEX_ROB* rob, const ROB_Entry* rob_entry, int* rob_index) {
 	// if instruction sucessfully added then only pass the instruction to function units
 	// entry gets added by DRF at the same time dispatching instruction to issue_queue
 	// using rob_entry to add entry so first add to issue_queue and use the same entry to add to rob simultaniously
-	if (rob->issue_ptr == ROB_SIZE) {
+	if (rob->issue_ptr == rob->size) {
 		rob->issue_ptr = 0; // go back to zero index
 	}
-	if (rob->buffer_length == ROB_SIZE) {
+	if (rob->buffer_length == rob->size) {
 		return FAILURE;
 	}
 	else if (rob->rob_entry[rob->issue_ptr].status) { // checking if enrty if free
@@ -88,15 +117,18 @@ int add_reorder_buffer_entry(APEX_ROB* rob, ROB_Entry rob_entry) {
 	}
 	else {
 		rob->rob_entry[rob->issue_ptr].status = VALID;
-		rob->rob_entry[rob->issue_ptr].inst_type = rob_entry.inst_type;
-		rob->rob_entry[rob->issue_ptr].inst_ptr = rob_entry.pc;
-		rob->rob_entry[rob->issue_ptr].rd = rob_entry.rd;
+		rob->rob_entry[rob->issue_ptr].inst_type = rob_entry->inst_type;
+		rob->rob_entry[rob->issue_ptr].inst_ptr = rob_entry->pc;
+		rob->rob_entry[rob->issue_ptr].rd = rob_entry->rd;
 		rob->rob_entry[rob->issue_ptr].rd_value = -1;
+		rob->rob_entry[rob->issue_ptr].mem_address = -1;
 		rob->rob_entry[rob->issue_ptr].exception = 0;
 		rob->rob_entry[rob->issue_ptr].valid = 0;
-		if (rob_entry.inst_type==HALT) {
+		if (rob_entry->inst_type==HALT) {
 			rob->rob_entry[rob->issue_ptr].valid = VALID;
 		}
+		// instruction carries this index till commit, so writeback needs no search
+		*rob_index = rob->issue_ptr;
 		// increment buffer_length and issue_ptr
 		rob->buffer_length += 1;
 		rob->issue_ptr += 1;
@@ -105,35 +137,29 @@ int add_reorder_buffer_entry(APEX_ROB* rob, ROB_Entry rob_entry) {
 }
 
 
-int update_reorder_buffer_entry_data(APEX_ROB* rob, ROB_Entry rob_entry) {
+int update_reorder_buffer_entry_data(APEX_ROB* rob, const ROB_Entry* rob_entry) {
 	// check the stage data and update the rob data value
-	int update_position = -1;
-	if (!rob_entry.executed) {
+	int update_position = rob_entry->rob_index;
+	if (!rob_entry->executed) {
 		return FAILURE;
 	}
 	else {
-		// for now loop through entire rob and check
-		// a better way would be checking between commit_ptr and issue_ptr
-		for (int i=0; i<ROB_SIZE; i++) {
-			// check only alloted entries
-			if (rob->rob_entry[i].status == VALID) {
-				// check pc to match instructions
-				if (rob->rob_entry[i].inst_ptr==rob_entry.pc) {
-					update_position = i;
-					break;
-				}
-			}
+		// rob index is carried from dispatch, pc check only guards against a stale index
+		if ((update_position<0)||(update_position>=rob->size)) {
+			return FAILURE;
 		}
-		if (update_position<0) {
+		if ((rob->rob_entry[update_position].status != VALID)||(rob->rob_entry[update_position].inst_ptr != rob_entry->pc)) {
 			return FAILURE;
 		}
 		else {
-			if (rob->rob_entry[update_position].rd == rob_entry.rd) {
-				rob->rob_entry[update_position].rd_value = rob_entry.rd_value;
-				rob->rob_entry[update_position].valid = rob_entry.rd_valid;
-				if (rob_entry.inst_type==BRANCH) {
-					rob->rob_entry[update_position].valid = rob_entry.rd_valid;
-					rob->rob_entry[update_position].exception = rob_entry.rd_valid;
+			if (rob->rob_entry[update_position].rd == rob_entry->rd) {
+				rob->rob_entry[update_position].rd_value = rob_entry->rd_value;
+				rob->rob_entry[update_position].mem_address = rob_entry->mem_address;
+				rob->rob_entry[update_position].valid = rob_entry->rd_valid;
+				if ((rob_entry->inst_type==BZ)||(rob_entry->inst_type==BNZ)||(rob_entry->inst_type==JUMP)) {
+					// branch is done either way, rd_valid only tells if younger inst must be squashed
+					rob->rob_entry[update_position].valid = VALID;
+					rob->rob_entry[update_position].exception = rob_entry->rd_valid;
 				}
 			}
 			else {
@@ -147,7 +173,7 @@ int update_reorder_buffer_entry_data(APEX_ROB* rob, ROB_Entry rob_entry) {
 
 int commit_reorder_buffer_entry(APEX_ROB* rob, ROB_Entry* rob_entry) {
 
-	if (rob->commit_ptr == ROB_SIZE) {
+	if (rob->commit_ptr == rob->size) {
 		rob->commit_ptr = 0; // go back to zero index
 	}
 	if (!rob->rob_entry[rob->commit_ptr].valid) {
@@ -161,6 +187,7 @@ int commit_reorder_buffer_entry(APEX_ROB* rob, ROB_Entry* rob_entry) {
 		rob_entry->rd = rob->rob_entry[rob->commit_ptr].rd;
 		rob_entry->rd_value = rob->rob_entry[rob->commit_ptr].rd_value;
 		rob_entry->rd_valid = rob->rob_entry[rob->commit_ptr].valid;
+		rob_entry->mem_address = rob->rob_entry[rob->commit_ptr].mem_address;
 		rob_entry->exception = rob->rob_entry[rob->commit_ptr].exception;
 		rob_entry->rs1 = INVALID;
 		rob_entry->rs1_value = INVALID;
@@ -177,6 +204,7 @@ int commit_reorder_buffer_entry(APEX_ROB* rob, ROB_Entry* rob_entry) {
 		rob->rob_entry[rob->commit_ptr].inst_ptr = INVALID;
 		rob->rob_entry[rob->commit_ptr].rd = INVALID;
 		rob->rob_entry[rob->commit_ptr].rd_value = INVALID;
+		rob->rob_entry[rob->commit_ptr].mem_address = INVALID;
 		rob->rob_entry[rob->commit_ptr].exception = 0;
 		rob->rob_entry[rob->commit_ptr].valid = INVALID;
 		// decrement buffer_length and increment commit_ptr
@@ -187,44 +215,50 @@ int commit_reorder_buffer_entry(APEX_ROB* rob, ROB_Entry* rob_entry) {
 }
 
 
-int can_rename_reg_tag(APEX_RENAME* rename_table) {
+int can_commit_reorder_buffer_entry(APEX_ROB* rob) {
+	// same check as commit_reorder_buffer_entry but without removing the entry
+	int commit_ptr = (rob->commit_ptr == rob->size) ? 0 : rob->commit_ptr;
+	if (!rob->rob_entry[commit_ptr].valid) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
 
-	int rename_position = -1;
-	int search_start = 0;
 
-	if (rename_table->last_rename_pos<(RENAME_TABLE_SIZE-1)) {
-		search_start = rename_table->last_rename_pos;
+int has_younger_reorder_buffer_entry(APEX_ROB* rob, int rob_index) {
+	// entries are added at issue ptr, anything between rob_index and issue ptr is younger
+	int next_ptr = (rob_index + 1 == rob->size) ? 0 : rob_index + 1;
+	int issue_ptr = (rob->issue_ptr == rob->size) ? 0 : rob->issue_ptr;
+	if ((next_ptr != issue_ptr)&&(rob->rob_entry[next_ptr].status == VALID)) {
+		return SUCCESS;
 	}
+	return FAILURE;
+}
 
-	for (int i=search_start; i<RENAME_TABLE_SIZE; i++) {
-		if (rename_table->reg_rename[i].tag_valid==INVALID) {
-			rename_position = i;
-			break;
-		}
+
+int can_rename_reg_tag(APEX_RENAME* rename_table) {
+
+	if (rename_table->free_count>0) {
+		return SUCCESS;
 	}
-	if (rename_position<0) {
+	else {
 		return FAILURE;
 	}
-	else {
-		return SUCCESS;
+}
+
+
+static int get_arch_reg_mapping(int arch_reg, APEX_RENAME* rename_table) {
+	// latest Pn for arch reg, -1 if not renamed or out of range
+	if ((arch_reg<0)||(arch_reg>=REGISTER_FILE_SIZE)) {
+		return -1;
 	}
+	return rename_table->rat_rename[arch_reg];
 }
 
 
 int check_if_reg_renamed(int arch_reg, APEX_RENAME* rename_table) {
 	// this tells if the arch regs are already renamed
-	// check in reverse order
-	int rename_position = -1;
-
-	for (int i=RENAME_TABLE_SIZE-1; i>=0; i--) {
-		if (rename_table->reg_rename[i].tag_valid==VALID) {
-			if (rename_table->reg_rename[i].rename_tag == arch_reg) {
-				rename_position = i;
-				break;
-			}
-		}
-	}
-	if (rename_position<0) {
+	if (get_arch_reg_mapping(arch_reg, rename_table)<0) {
 		return FAILURE;
 	}
 	else {
@@ -235,17 +269,8 @@ int check_if_reg_renamed(int arch_reg, APEX_RENAME* rename_table) {
 
 int get_reg_renamed_tag(int* src_reg, APEX_RENAME* rename_table) {
 	// this gives already renamed arch regs
-	// check in reverse order
-	int rename_position = -1;
-
-	for (int i=RENAME_TABLE_SIZE-1; i>=0; i--) {
-		if (rename_table->reg_rename[i].tag_valid==VALID) {
-			if (rename_table->reg_rename[i].rename_tag == *src_reg) {
-				rename_position = i;
-				break;
-			}
-		}
-	}
+	int rename_position = get_arch_reg_mapping(*src_reg, rename_table);
+
 	if (rename_position<0) {
 		return FAILURE;
 	}
@@ -258,7 +283,6 @@ int get_reg_renamed_tag(int* src_reg, APEX_RENAME* rename_table) {
 
 int get_phy_reg_renamed_tag(int phy_reg, APEX_RENAME* rename_table) {
 	// any_reg is P
-	// check in reverse order
 	int arch_reg = -1;
 
 	if (rename_table->reg_rename[phy_reg].tag_valid==VALID) {
@@ -271,53 +295,90 @@ int get_phy_reg_renamed_tag(int phy_reg, APEX_RENAME* rename_table) {
 
 int rename_desc_reg(int* desc_reg, APEX_RENAME* rename_table) {
 	// this actually renames the regs
-	int rename_position = -1;
-	int search_start = 0;
-
-	if (rename_table->last_rename_pos<(RENAME_TABLE_SIZE-1)) {
-		search_start = rename_table->last_rename_pos;
-	}
-
-	for (int i=search_start; i<RENAME_TABLE_SIZE; i++) {
-		if (rename_table->reg_rename[i].tag_valid==INVALID) {
-			rename_position = i;
-			break;
-		}
-	}
-	if (rename_position<0) {
+	if ((rename_table->free_count<=0)||(*desc_reg<0)||(*desc_reg>=REGISTER_FILE_SIZE)) {
 		return FAILURE;
 	}
 	else {
+		// take Pn from head of free list
+		int rename_position = rename_table->free_list[rename_table->free_head];
+		rename_table->free_head = (rename_table->free_head + 1) % rename_table->size;
+		rename_table->free_count -= 1;
+
 		rename_table->reg_rename[rename_position].rename_tag = *desc_reg;
-		*desc_reg = rename_position;
 		rename_table->reg_rename[rename_position].tag_valid = VALID;
-		rename_table->last_rename_pos = rename_position;
+		rename_table->reg_rename[rename_position].value_valid = INVALID;
+		rename_table->rat_rename[*desc_reg] = rename_position;
+		*desc_reg = rename_position;
 	}
 
 	return SUCCESS;
 }
 
 
+void free_phy_reg(int phy_reg, APEX_RENAME* rename_table) {
+	// Pn is freed when its producer commits, value now lives in arch reg
+	if ((phy_reg<0)||(phy_reg>=rename_table->size)||(rename_table->reg_rename[phy_reg].tag_valid!=VALID)) {
+		return;
+	}
+	int arch_reg = rename_table->reg_rename[phy_reg].rename_tag;
+	rename_table->reg_rename[phy_reg].tag_valid = INVALID;
+	rename_table->reg_rename[phy_reg].value_valid = INVALID;
+	// arch reg is no longer renamed unless a younger inst renamed it again
+	if (get_arch_reg_mapping(arch_reg, rename_table)==phy_reg) {
+		rename_table->rat_rename[arch_reg] = -1;
+	}
+	// add Pn to tail of free list
+	int tail = (rename_table->free_head + rename_table->free_count) % rename_table->size;
+	rename_table->free_list[tail] = phy_reg;
+	rename_table->free_count += 1;
+}
+
+
+void set_phy_reg_value(int phy_reg, int value, APEX_RENAME* rename_table) {
+	// result bus writes Pn so later consumers can read it at decode
+	if ((phy_reg<0)||(phy_reg>=rename_table->size)||(rename_table->reg_rename[phy_reg].tag_valid!=VALID)) {
+		return;
+	}
+	rename_table->reg_rename[phy_reg].value = value;
+	rename_table->reg_rename[phy_reg].value_valid = VALID;
+}
+
+
+int get_phy_reg_value(int phy_reg, int* value, APEX_RENAME* rename_table) {
+	// value of Pn if its producer has broadcast the result
+	if ((phy_reg<0)||(phy_reg>=rename_table->size)||(rename_table->reg_rename[phy_reg].tag_valid!=VALID)) {
+		return FAILURE;
+	}
+	if (rename_table->reg_rename[phy_reg].value_valid!=VALID) {
+		return FAILURE;
+	}
+	*value = rename_table->reg_rename[phy_reg].value;
+	return SUCCESS;
+}
+
+
 void clear_rename_table(APEX_RENAME* rename_table) {
 
 	// clear all rename
-	for(int i=0; i<RENAME_TABLE_SIZE; i++) {
+	for(int i=0; i<rename_table->size; i++) {
 		rename_table->reg_rename[i].tag_valid = INVALID;
 		rename_table->reg_rename[i].rename_tag = INVALID;
+		rename_table->reg_rename[i].value_valid = INVALID;
 	}
-	rename_table->last_rename_pos = INVALID;
+	reset_rename_alias_table(rename_table);
 }
 
 
 void clear_reorder_buffer(APEX_ROB* rob) {
 
 	// clear all rob entries
-	for(int i=0; i<ROB_SIZE; i++) {
+	for(int i=0; i<rob->size; i++) {
 		rob->rob_entry[i].status = INVALID;
 		rob->rob_entry[i].inst_type = INVALID;
 		rob->rob_entry[i].inst_ptr = INVALID;
 		rob->rob_entry[i].rd = INVALID;
 		rob->rob_entry[i].rd_value = INVALID;
+		rob->rob_entry[i].mem_address = INVALID;
 		rob->rob_entry[i].exception = INVALID;
 		rob->rob_entry[i].valid = INVALID;
 	}
@@ -330,7 +391,6 @@ void clear_reorder_buffer(APEX_ROB* rob) {
 void print_rob_and_rename_content(APEX_ROB* rob, APEX_RENAME* rename_table) {
 
 	if (ENABLE_REG_MEM_STATUS_PRINT) {
-		char* inst_type_str = (char*) malloc(10);
 		printf("\n============ STATE OF REORDER BUFFER ============\n");
 		printf("ROB Buffer Length: %d, Commit Pointer: %d, Issue Pointer: %d\n", rob->buffer_length, rob->commit_ptr, rob->issue_ptr);
 		printf("Index, "
@@ -340,9 +400,7 @@ void print_rob_and_rename_content(APEX_ROB* rob, APEX_RENAME* rename_table) {
 						"Rd-value, "
 						"Exception, "
 						"Valid\n");
-		for (int i=0;i<ROB_SIZE;i++) {
-			strcpy(inst_type_str, "");
-			get_inst_name(rob->rob_entry[i].inst_type, inst_type_str);
+		for (int i=0;i<rob->size;i++) {
 			printf("%02d\t|"
 							"\t%d\t|"
 							"\t%d\t|"
@@ -353,7 +411,7 @@ void print_rob_and_rename_content(APEX_ROB* rob, APEX_RENAME* rename_table) {
 							i,
 							rob->rob_entry[i].status,
 							rob->rob_entry[i].inst_type,
-							inst_type_str,
+							get_inst_name(rob->rob_entry[i].inst_type),
 							rob->rob_entry[i].rd, rob->rob_entry[i].rd_value,
 							rob->rob_entry[i].exception,
 							rob->rob_entry[i].valid);
@@ -362,7 +420,7 @@ void print_rob_and_rename_content(APEX_ROB* rob, APEX_RENAME* rename_table) {
 		printf("Index, "
 						"Tag, "
 						"Valid\n");
-		for (int i=0;i<RENAME_TABLE_SIZE;i++) {
+		for (int i=0;i<rename_table->size;i++) {
 			printf("P%02d\t|"
 							"\tR%02d\t|"
 							"\t%d\n",
@@ -370,6 +428,5 @@ void print_rob_and_rename_content(APEX_ROB* rob, APEX_RENAME* rename_table) {
 							rename_table->reg_rename[i].rename_tag,
 							rename_table->reg_rename[i].tag_valid);
 		}
-	free(inst_type_str);
 	}
 }
@@ -9,11 +9,16 @@
  *  State University of New York, Binghamton
  */
 
-#include "ls_iq.h"
-
-
+/* Default sizes, the ones used are passed to init at run time */
+#ifndef ROB_SIZE
 #define ROB_SIZE 12
+#endif
+#ifndef RENAME_TABLE_SIZE
 #define RENAME_TABLE_SIZE 24
+#endif
+#ifndef REGISTER_FILE_SIZE
+#define REGISTER_FILE_SIZE 32
+#endif
 
 
 /* Format of an APEX ROB mechanism  */
@@ -23,24 +28,19 @@ typedef struct APEX_ROB_ENTRY {
 	int inst_ptr;				// holds instruction address
 	int rd;							// holds destination reg tag
 	int rd_value;			  // holds destination reg value
+	int mem_address;		// holds store address or jump target, read at commit
 	int exception;			// indicate if there is exception
 	int valid;					// indicate if instruction is ready to commit
 } APEX_ROB_ENTRY;
 
 
-typedef struct APEX_ARF_TABLE {
-	// array index is used to tell if its P0 or Pn
-	// this tells us from which rob entry we will get our Pn Value
-	int tag_valid;				// tells if rob tag is valid or not
-	int rob_tag;					// holds the index of rob entry ie issue_ptr
-}APEX_ARF_TABLE;
-
-
 typedef struct APEX_RENAME_TABLE {
 	// array index is used to tell if its P0 or Pn
 	// this tells us which Pn will holds our desc reg value
 	int tag_valid;					// tells if rename entry gor desc reg is valid
 	int rename_tag;					// holds the index of desc reg like R0 or Rn
+	int value;							// result broadcast for Pn
+	int value_valid;				// tells if Pn result has been broadcast
 } APEX_RENAME_TABLE;
 
 
@@ -48,14 +48,21 @@ typedef struct APEX_ROB {
 	int commit_ptr;				  // pointer index for commit rob entry
 	int issue_ptr;					// pointer index of last rob entry
 	int buffer_length;			// rob buffer length
-	APEX_ROB_ENTRY rob_entry[ROB_SIZE];					// array of ROB_SIZE rob entry struct. Note: use . in struct with variable names, use -> when its a pointer
+	int size;								// number of rob entries
+	APEX_ROB_ENTRY* rob_entry;					// array of size rob entry struct. Note: use . in struct with variable names, use -> when its a pointer
 } APEX_ROB;
 
 
 typedef struct APEX_RENAME {
-	APEX_RENAME_TABLE reg_rename[RENAME_TABLE_SIZE];
-	APEX_ARF_TABLE rat_rename[RENAME_TABLE_SIZE];
-	int last_rename_pos;
+	int size;								// number of Pn
+	APEX_RENAME_TABLE* reg_rename;
+	// array index is arch reg like R0 or Rn
+	// holds the latest Pn renamed for it, INVALID(-1) when arch reg holds the value
+	int rat_rename[REGISTER_FILE_SIZE];
+	// circular list of free Pn, allocated from free_head
+	int* free_list;
+	int free_head;
+	int free_count;
 } APEX_RENAME;
 
 
@@ -74,18 +81,20 @@ typedef struct ROB_Entry {
 	int rs2_value;
 	int rs2_valid;
 	int buffer;
+	int mem_address;
 	int exception;
 	int stage_cycle;
+	int rob_index;
 } ROB_Entry;
 
 
-APEX_ROB* init_reorder_buffer();
-APEX_RENAME* init_rename_table();
+APEX_ROB* init_reorder_buffer(int rob_size);
+APEX_RENAME* init_rename_table(int rename_table_size);
 void deinit_reorder_buffer(APEX_ROB* rob);
 void deinit_rename_table(APEX_RENAME* rename_table);
 
 int can_add_entry_in_reorder_buffer(APEX_ROB* rob);
-int add_reorder_buffer_entry(APEX_ROB* rob, ROB_Entry rob_entry);
+int add_reorder_buffer_entry(APEX_ROB* rob, const ROB_Entry* rob_entry, int* rob_index);
 
 int can_rename_reg_tag(APEX_RENAME* rename_table);
 int rename_desc_reg(int* desc_reg, APEX_RENAME* rename_table);
@@ -94,9 +103,14 @@ int check_if_reg_renamed(int any_reg, APEX_RENAME* rename_table);
 int get_reg_renamed_tag(int* src_reg, APEX_RENAME* rename_table);
 
 int get_phy_reg_renamed_tag(int reg_number, APEX_RENAME* rename_table);
+void free_phy_reg(int phy_reg, APEX_RENAME* rename_table);
+void set_phy_reg_value(int phy_reg, int value, APEX_RENAME* rename_table);
+int get_phy_reg_value(int phy_reg, int* value, APEX_RENAME* rename_table);
 
-int update_reorder_buffer_entry_data(APEX_ROB* rob, ROB_Entry rob_entry);
+int update_reorder_buffer_entry_data(APEX_ROB* rob, const ROB_Entry* rob_entry);
 int commit_reorder_buffer_entry(APEX_ROB* rob, ROB_Entry* rob_entry);
+int can_commit_reorder_buffer_entry(APEX_ROB* rob);
+int has_younger_reorder_buffer_entry(APEX_ROB* rob, int rob_index);
 
 void clear_rename_table(APEX_RENAME* rename_table);
 void clear_reorder_buffer(APEX_ROB* rob);
@@ -0,0 +1,419 @@
+/*
+ *  sampling.c
+ *  Contains APEX SMARTS style sampling, short pipeline windows between functional runs give CPI with a confidence interval
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "apex.h"
+#include "forwarding.h"
+
+/* Sums of one round of samples */
+typedef struct Sample_Round {
+	int samples;					// units measured
+	double cpi_sum;
+	double cpi_square_sum;
+	long long detailed_cycles;		// pipeline cycles of warmup, units and drains
+	long long detailed_instructions;
+	long long functional_instructions;
+} Sample_Round;
+
+/* What one window measured */
+typedef struct Window_Result {
+	int measured;					// unit committed all its inst
+	double cpi;
+	long long cycles;				// pipeline cycles of warmup and unit
+	long long instructions;
+} Window_Result;
+
+/* Arch states of window starts passed from the functional run to the workers */
+typedef struct Window_Pool {
+	const APEX_Program* program;
+	const APEX_Config* config;
+	const APEX_Sample_Config* sample;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;		// a state was added or taken, or producer is done
+	APEX_Arch_State** queue;		// ring of states not taken yet
+	int* queue_index;				// window each queued state starts
+	int capacity;
+	int head;
+	int count;
+	int done;						// no more states will be added
+	Window_Result* results;		// one per window, merged in window order
+} Window_Pool;
+
+
+void APEX_sample_default_config(APEX_Sample_Config* sample) {
+	// unit and warmup are short since ROB, IQ and LSQ are the only state with history
+	sample->unit_size = 1000;
+	sample->warmup_size = 200;
+	sample->initial_samples = 30;
+	sample->max_rounds = 4;
+	sample->target_error = 0.03;
+	sample->z = 3.0;
+	sample->max_instructions = 0;
+	sample->threads = 1;
+}
+
+
+static long long get_window_cycles(const APEX_Config* config, long long num_instructions) {
+	// upper bound of cycles a window can take, only reached if the pipeline locks up
+	return num_instructions * (config->mem_latency + 64) + 1000;
+}
+
+
+/*
+ * ########################################## Program Length ##########################################
+*/
+
+static long long get_program_length(const APEX_Program* program, const APEX_Config* config, long long max_instructions) {
+	// inst till HALT or max_instructions, in functional mode
+	APEX_Sim* sim = APEX_sim_create_from_program(program, config, 0);
+	if (!sim) {
+		return -1;
+	}
+	APEX_Stats stats;
+	int ret = APEX_sim_run_functional(sim, (max_instructions > 0) ? max_instructions : LLONG_MAX);
+	APEX_sim_get_stats(sim, &stats);
+	APEX_sim_destroy(sim);
+	return (ret == APEX_SIM_ERROR) ? -1 : stats.functional_instructions;
+}
+
+
+static int run_detailed(const APEX_Program* program, const APEX_Config* config, long long num_instructions, APEX_Sample_Result* result) {
+	// program too short to sample, every inst goes through the pipeline
+	APEX_Sim* sim = APEX_sim_create_from_program(program, config, 0);
+	if (!sim) {
+		return APEX_SIM_ERROR;
+	}
+	APEX_Stats stats;
+	int ret = APEX_sim_step_instructions(sim, num_instructions, get_window_cycles(config, num_instructions));
+	APEX_sim_get_stats(sim, &stats);
+	APEX_sim_destroy(sim);
+	if ((ret == APEX_SIM_ERROR)||(stats.instructions == 0)) {
+		return APEX_SIM_ERROR;
+	}
+	result->exact = 1;
+	result->samples = 1;
+	result->rounds = 1;
+	result->cpi = (double)stats.cycles / stats.instructions;
+	result->cpi_low = result->cpi;
+	result->cpi_high = result->cpi;
+	result->error = 0.0;
+	result->target_met = 1;
+	result->detailed_cycles = stats.cycles;
+	result->detailed_instructions = stats.instructions;
+	return 0;
+}
+
+
+/*
+ * ########################################## Sampling Round ##########################################
+*/
+
+static int run_sample_round(const APEX_Program* program, const APEX_Config* config, const APEX_Sample_Config* sample, long long program_length, int num_samples, Sample_Round* round) {
+	// systematic sampling, one warmup and unit window in the middle of each of num_samples equal periods
+	// functional mode runs everything between windows, the pipeline is drained after each unit
+	APEX_Sim* sim = APEX_sim_create_from_program(program, config, 0);
+	if (!sim) {
+		return APEX_SIM_ERROR;
+	}
+	memset(round, 0, sizeof(*round));
+	long long window = sample->warmup_size + sample->unit_size;
+	long long period = program_length / num_samples;
+	APEX_Stats stats;
+	int ret = APEX_SIM_RUNNING;
+
+	for (int i=0; (i<num_samples)&&(ret==APEX_SIM_RUNNING); i++) {
+		long long window_start = (i * period) + ((period - window) / 2);
+		APEX_sim_get_stats(sim, &stats);
+		long long position = stats.functional_instructions + stats.instructions;
+		if (window_start > position) {
+			ret = APEX_sim_run_functional(sim, window_start - position);
+			if (ret != APEX_SIM_RUNNING) {
+				break;
+			}
+		}
+		if (sample->warmup_size > 0) {
+			ret = APEX_sim_step_instructions(sim, sample->warmup_size, get_window_cycles(config, sample->warmup_size));
+			if (ret != APEX_SIM_RUNNING) {
+				break;
+			}
+		}
+		APEX_Stats before;
+		APEX_sim_get_stats(sim, &before);
+		ret = APEX_sim_step_instructions(sim, sample->unit_size, get_window_cycles(config, sample->unit_size));
+		APEX_sim_get_stats(sim, &stats);
+		long long unit_instructions = stats.instructions - before.instructions;
+		if (unit_instructions >= sample->unit_size) {
+			// a unit cut short by HALT is not the same size as the others, it is left out
+			double cpi = (double)(stats.cycles - before.cycles) / unit_instructions;
+			round->samples += 1;
+			round->cpi_sum += cpi;
+			round->cpi_square_sum += cpi * cpi;
+		}
+		if (ret == APEX_SIM_RUNNING) {
+			ret = APEX_sim_drain(sim, get_window_cycles(config, window));
+		}
+	}
+
+	APEX_sim_get_stats(sim, &stats);
+	round->detailed_cycles = stats.cycles;
+	round->detailed_instructions = stats.instructions;
+	round->functional_instructions = stats.functional_instructions;
+	APEX_sim_destroy(sim);
+	return (ret == APEX_SIM_ERROR) ? APEX_SIM_ERROR : 0;
+}
+
+
+/*
+ * ########################################## Parallel Round ##########################################
+*/
+
+static void run_window(const Window_Pool* pool, const APEX_Arch_State* state, Window_Result* result) {
+	// fresh machine continues from the window start, warmup then measured unit
+	const APEX_Sample_Config* sample = pool->sample;
+	APEX_Sim* sim = APEX_sim_create_from_program(pool->program, pool->config, 0);
+	if ((!sim)||(APEX_sim_set_arch_state(sim, state) != 0)) {
+		APEX_sim_destroy(sim);
+		return;
+	}
+	int ret = APEX_SIM_RUNNING;
+	if (sample->warmup_size > 0) {
+		ret = APEX_sim_step_instructions(sim, sample->warmup_size, get_window_cycles(pool->config, sample->warmup_size));
+	}
+	APEX_Stats before, stats;
+	APEX_sim_get_stats(sim, &before);
+	if (ret == APEX_SIM_RUNNING) {
+		APEX_sim_step_instructions(sim, sample->unit_size, get_window_cycles(pool->config, sample->unit_size));
+	}
+	APEX_sim_get_stats(sim, &stats);
+	long long unit_instructions = stats.instructions - before.instructions;
+	if (unit_instructions >= sample->unit_size) {
+		result->measured = 1;
+		result->cpi = (double)(stats.cycles - before.cycles) / unit_instructions;
+	}
+	result->cycles = stats.cycles;
+	result->instructions = stats.instructions;
+	APEX_sim_destroy(sim);
+}
+
+
+static void* window_worker(void* arg) {
+	// workers take the oldest queued window start till producer is done and queue is empty
+	Window_Pool* pool = arg;
+	while (1) {
+		pthread_mutex_lock(&pool->lock);
+		while ((pool->count == 0)&&(!pool->done)) {
+			pthread_cond_wait(&pool->changed, &pool->lock);
+		}
+		if (pool->count == 0) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		APEX_Arch_State* state = pool->queue[pool->head];
+		int index = pool->queue_index[pool->head];
+		pool->head = (pool->head + 1) % pool->capacity;
+		pool->count -= 1;
+		pthread_cond_broadcast(&pool->changed);
+		pthread_mutex_unlock(&pool->lock);
+
+		run_window(pool, state, &pool->results[index]);
+		APEX_arch_state_free(state);
+	}
+	return NULL;
+}
+
+
+static void add_window_state(Window_Pool* pool, APEX_Arch_State* state, int index) {
+	// waits while queue is full, so only a few data memories are held at once
+	pthread_mutex_lock(&pool->lock);
+	while (pool->count == pool->capacity) {
+		pthread_cond_wait(&pool->changed, &pool->lock);
+	}
+	int tail = (pool->head + pool->count) % pool->capacity;
+	pool->queue[tail] = state;
+	pool->queue_index[tail] = index;
+	pool->count += 1;
+	pthread_cond_broadcast(&pool->changed);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+
+static int produce_window_states(Window_Pool* pool, long long program_length, int num_samples, long long* functional_instructions) {
+	// one functional run through the program, arch state at every window start goes to the workers
+	APEX_Sim* sim = APEX_sim_create_from_program(pool->program, pool->config, 0);
+	if (!sim) {
+		return APEX_SIM_ERROR;
+	}
+	long long window = pool->sample->warmup_size + pool->sample->unit_size;
+	long long period = program_length / num_samples;
+	APEX_Stats stats;
+	int ret = APEX_SIM_RUNNING;
+	for (int i=0; (i<num_samples)&&(ret==APEX_SIM_RUNNING); i++) {
+		long long window_start = (i * period) + ((period - window) / 2);
+		APEX_sim_get_stats(sim, &stats);
+		if (window_start > stats.functional_instructions) {
+			ret = APEX_sim_run_functional(sim, window_start - stats.functional_instructions);
+			if (ret != APEX_SIM_RUNNING) {
+				break;
+			}
+		}
+		APEX_Arch_State* state = APEX_sim_get_arch_state(sim);
+		if (!state) {
+			ret = APEX_SIM_ERROR;
+			break;
+		}
+		add_window_state(pool, state, i);
+	}
+	APEX_sim_get_stats(sim, &stats);
+	*functional_instructions = stats.functional_instructions;
+	APEX_sim_destroy(sim);
+	return (ret == APEX_SIM_ERROR) ? APEX_SIM_ERROR : 0;
+}
+
+
+static int run_parallel_round(const APEX_Program* program, const APEX_Config* config, const APEX_Sample_Config* sample, long long program_length, int num_samples, Sample_Round* round) {
+	// same windows as run_sample_round, each one on its own machine started from an arch checkpoint
+	memset(round, 0, sizeof(*round));
+	Window_Pool pool = {.program = program, .config = config, .sample = sample, .capacity = 2 * sample->threads};
+	pool.queue = apex_calloc(pool.capacity, sizeof(APEX_Arch_State*));
+	pool.queue_index = apex_calloc(pool.capacity, sizeof(int));
+	pool.results = apex_calloc(num_samples, sizeof(Window_Result));
+	pthread_t* threads = apex_calloc(sample->threads, sizeof(pthread_t));
+	if ((!pool.queue)||(!pool.queue_index)||(!pool.results)||(!threads)) {
+		free(pool.queue);
+		free(pool.queue_index);
+		free(pool.results);
+		free(threads);
+		return APEX_SIM_ERROR;
+	}
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.changed, NULL);
+
+	int started = 0;
+	for (; started<sample->threads; started++) {
+		if (pthread_create(&threads[started], NULL, window_worker, &pool) != 0) {
+			break;
+		}
+	}
+	int ret = APEX_SIM_ERROR;
+	if (started > 0) {
+		ret = produce_window_states(&pool, program_length, num_samples, &round->functional_instructions);
+	}
+	pthread_mutex_lock(&pool.lock);
+	pool.done = 1;
+	pthread_cond_broadcast(&pool.changed);
+	pthread_mutex_unlock(&pool.lock);
+	for (int i=0; i<started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	for (int i=0; i<num_samples; i++) {
+		const Window_Result* result = &pool.results[i];
+		if (result->measured) {
+			round->samples += 1;
+			round->cpi_sum += result->cpi;
+			round->cpi_square_sum += result->cpi * result->cpi;
+		}
+		round->detailed_cycles += result->cycles;
+		round->detailed_instructions += result->instructions;
+	}
+	pthread_cond_destroy(&pool.changed);
+	pthread_mutex_destroy(&pool.lock);
+	free(pool.queue);
+	free(pool.queue_index);
+	free(pool.results);
+	free(threads);
+	return ret;
+}
+
+
+static void set_round_result(const APEX_Sample_Config* sample, const Sample_Round* round, APEX_Sample_Result* result) {
+	// mean CPI of the units, half width of the interval is z * s / sqrt(n)
+	int n = round->samples;
+	double mean = round->cpi_sum / n;
+	double variance = (n > 1) ? (round->cpi_square_sum - (n * mean * mean)) / (n - 1) : 0.0;
+	double half_width = (variance > 0.0) ? sample->z * sqrt(variance / n) : 0.0;
+	result->samples = n;
+	result->cpi = mean;
+	result->cpi_stddev = (variance > 0.0) ? sqrt(variance) : 0.0;
+	result->cpi_low = mean - half_width;
+	result->cpi_high = mean + half_width;
+	result->error = (mean > 0.0) ? half_width / mean : 0.0;
+	result->target_met = (n > 1)&&(result->error <= sample->target_error);
+	result->detailed_cycles += round->detailed_cycles;
+	result->detailed_instructions += round->detailed_instructions;
+	result->functional_instructions += round->functional_instructions;
+}
+
+
+/*
+ * ########################################## Sample Run ##########################################
+*/
+
+int APEX_sample_run(const APEX_Program* program, const APEX_Config* config, const APEX_Sample_Config* sample, APEX_Sample_Result* result) {
+	// rounds start from the beginning of the program, each one with the sample count the last one asked for
+	if ((!program)||(!config)||(!sample)||(!result)||(check_config(config) != APEX_CONFIG_SUCCESS)) {
+		return APEX_SIM_ERROR;
+	}
+	if ((sample->unit_size < 1)||(sample->unit_size > INT_MAX)||(sample->warmup_size < 0)||(sample->warmup_size > INT_MAX)||
+		(sample->initial_samples < 2)||(sample->max_rounds < 1)||(sample->threads < 1)||(sample->target_error <= 0.0)||(sample->z <= 0.0)) {
+		fprintf(stderr, "APEX_Sample : Invalid sampling parameters\n");
+		return APEX_SIM_ERROR;
+	}
+	memset(result, 0, sizeof(*result));
+	result->program_instructions = get_program_length(program, config, sample->max_instructions);
+	if (result->program_instructions < 0) {
+		return APEX_SIM_ERROR;
+	}
+
+	long long window = sample->warmup_size + sample->unit_size;
+	long long max_samples = result->program_instructions / window;
+	if (max_samples > INT_MAX) {
+		max_samples = INT_MAX;
+	}
+	if (max_samples < sample->initial_samples) {
+		return run_detailed(program, config, result->program_instructions, result);
+	}
+
+	int num_samples = sample->initial_samples;
+	Sample_Round round;
+	while (result->rounds < sample->max_rounds) {
+		int ret = (sample->threads > 1) ?
+			run_parallel_round(program, config, sample, result->program_instructions, num_samples, &round) :
+			run_sample_round(program, config, sample, result->program_instructions, num_samples, &round);
+		if (ret != 0) {
+			return APEX_SIM_ERROR;
+		}
+		result->rounds += 1;
+		if (round.samples < 2) {
+			fprintf(stderr, "APEX_Sample : Only %d units could be measured\n", round.samples);
+			return APEX_SIM_ERROR;
+		}
+		set_round_result(sample, &round, result);
+		if (result->target_met) {
+			break;
+		}
+		// samples needed for target error from the variation seen, n = (z * s / (error * mean))^2
+		double needed = pow(sample->z * result->cpi_stddev / (sample->target_error * result->cpi), 2.0);
+		if (needed >= (double)max_samples) {
+			needed = (double)max_samples;
+		}
+		if ((int)ceil(needed) <= num_samples) {
+			// windows would overlap, program is not long enough for the target error
+			break;
+		}
+		num_samples = (int)ceil(needed);
+	}
+	return 0;
+}
@@ -0,0 +1,360 @@
+/*
+ *  sweep.c
+ *  Contains apex_sweep, runs one program over a grid of configs on a thread pool and writes a CSV
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "apex.h"
+
+#define MAX_SWEEP_AXES 32
+#define MAX_AXIS_VALUES 256
+#define DEFAULT_MAX_CYCLES 1000000
+
+/* One swept key and the values it takes, kept as text so pipeline_width works like on apex_sim */
+typedef struct Sweep_Axis {
+	char key[64];
+	char values[MAX_AXIS_VALUES][16];
+	int count;
+} Sweep_Axis;
+
+/* One grid point and what running it gave */
+typedef struct Sweep_Point {
+	APEX_Config config;
+	int valid;			// config passed check_config
+	int created;			// machine could be built
+	APEX_Stats stats;
+} Sweep_Point;
+
+/* State shared by workers, only next_point is written after start */
+typedef struct Sweep_Pool {
+	const APEX_Program* program;
+	Sweep_Point* points;
+	int num_points;
+	long long max_cycles;
+	long long fast_forward;		// inst run functionally before timing starts
+	long long warmup;		// cycles run after fast forward and not counted
+	const char* checkpoint;		// machine state every point starts from
+	int next_point;
+} Sweep_Pool;
+
+
+static double get_wall_time() {
+	// monotonic wall clock in seconds, used to report sweep speed
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+
+static void print_usage(const char* program) {
+	fprintf(stderr, "APEX_Help : Usage %s <input_file> [--threads=<n>] [--max_cycles=<n>] [--fast_forward=<n>] [--warmup=<n>] [--checkpoint=<file>] [--output=<file.csv>] [--config=<file>] [--<key>=<values>]\n", program);
+	fprintf(stderr, "APEX_Help : <values> is a comma list of numbers or <first>:<last>[:<step>] ranges, eg: --rob_size=16,32:128:32\n");
+	fprintf(stderr, "APEX_Help : every combination of the swept keys is one point, the rest come from --config or defaults\n");
+	print_config_keys();
+}
+
+
+/*
+ * ########################################## Grid ##########################################
+*/
+
+static int add_axis_value(Sweep_Axis* axis, int value) {
+	if (axis->count >= MAX_AXIS_VALUES) {
+		fprintf(stderr, "APEX_Sweep : %s has more than %d values\n", axis->key, MAX_AXIS_VALUES);
+		return APEX_SIM_ERROR;
+	}
+	snprintf(axis->values[axis->count], sizeof(axis->values[0]), "%d", value);
+	axis->count += 1;
+	return 0;
+}
+
+
+static int parse_axis_values(Sweep_Axis* axis, const char* text) {
+	// comma separated numbers or first:last[:step] ranges
+	char list[1024];
+	if (strlen(text) >= sizeof(list)) {
+		fprintf(stderr, "APEX_Sweep : values of %s are too long\n", axis->key);
+		return APEX_SIM_ERROR;
+	}
+	strcpy(list, text);
+	char* save_ptr = NULL;
+	for (char* item = strtok_r(list, ",", &save_ptr); item; item = strtok_r(NULL, ",", &save_ptr)) {
+		int first = 0, last = 0, step = 1;
+		char end = '\0';
+		int ok = 0;
+		if (strchr(item, ':') == NULL) {
+			ok = (sscanf(item, "%d%c", &first, &end) == 1);
+			last = first;
+		}
+		else {
+			int fields = sscanf(item, "%d:%d:%d%c", &first, &last, &step, &end);
+			ok = ((fields == 2)||(fields == 3))&&(step >= 1)&&(last >= first);
+		}
+		if (!ok) {
+			fprintf(stderr, "APEX_Sweep : Invalid value '%s' of %s\n", item, axis->key);
+			return APEX_SIM_ERROR;
+		}
+		for (int value=first; value<=last; value+=step) {
+			if (add_axis_value(axis, value) != 0) {
+				return APEX_SIM_ERROR;
+			}
+		}
+	}
+	if (axis->count == 0) {
+		fprintf(stderr, "APEX_Sweep : No values for %s\n", axis->key);
+		return APEX_SIM_ERROR;
+	}
+	return 0;
+}
+
+
+static Sweep_Point* create_grid(const APEX_Config* base, const Sweep_Axis* axes, int num_axes, int* num_points) {
+	// point index is a mixed radix number, last axis changes fastest
+	long total = 1;
+	for (int a=0; a<num_axes; a++) {
+		total *= axes[a].count;
+		if (total > 10000000) {
+			fprintf(stderr, "APEX_Sweep : Grid has more than 10000000 points\n");
+			return NULL;
+		}
+	}
+	Sweep_Point* points = calloc(total, sizeof(Sweep_Point));
+	if (!points) {
+		return NULL;
+	}
+	for (long p=0; p<total; p++) {
+		Sweep_Point* point = &points[p];
+		point->config = *base;
+		point->valid = 1;
+		long rest = p;
+		int digits[MAX_SWEEP_AXES];
+		for (int a=num_axes-1; a>=0; a--) {
+			digits[a] = rest % axes[a].count;
+			rest /= axes[a].count;
+		}
+		// keys apply in command line order, so pipeline_width before a width sets the default it overrides
+		for (int a=0; a<num_axes; a++) {
+			if (set_config_value(&point->config, axes[a].key, axes[a].values[digits[a]]) != APEX_CONFIG_SUCCESS) {
+				point->valid = 0;
+			}
+		}
+	}
+	*num_points = (int)total;
+	return points;
+}
+
+
+/*
+ * ########################################## Workers ##########################################
+*/
+
+static void run_point(const Sweep_Pool* pool, Sweep_Point* point) {
+	if ((!point->valid)||(check_config(&point->config) != APEX_CONFIG_SUCCESS)) {
+		point->valid = 0;
+		return;
+	}
+	APEX_Sim* sim = APEX_sim_create_from_program(pool->program, &point->config, 0);
+	if (!sim) {
+		return;
+	}
+	if ((pool->checkpoint)&&(APEX_sim_load_checkpoint(sim, pool->checkpoint) != 0)) {
+		APEX_sim_destroy(sim);
+		return;
+	}
+	point->created = 1;
+	if ((pool->fast_forward > 0)||(pool->warmup > 0)) {
+		APEX_sim_fast_forward(sim, pool->fast_forward, pool->warmup);
+	}
+	APEX_sim_step(sim, pool->max_cycles);
+	APEX_sim_get_stats(sim, &point->stats);
+	APEX_sim_destroy(sim);
+}
+
+
+static void* sweep_worker(void* arg) {
+	// workers take the next unclaimed point till none are left
+	Sweep_Pool* pool = arg;
+	while (1) {
+		int index = __atomic_fetch_add(&pool->next_point, 1, __ATOMIC_RELAXED);
+		if (index >= pool->num_points) {
+			break;
+		}
+		run_point(pool, &pool->points[index]);
+	}
+	return NULL;
+}
+
+
+static int run_pool(Sweep_Pool* pool, int num_threads) {
+	pthread_t* threads = calloc(num_threads, sizeof(pthread_t));
+	if (!threads) {
+		return APEX_SIM_ERROR;
+	}
+	int started = 0;
+	for (; started<num_threads; started++) {
+		if (pthread_create(&threads[started], NULL, sweep_worker, pool) != 0) {
+			break;
+		}
+	}
+	if (started == 0) {
+		// no thread could be started, run the points here
+		sweep_worker(pool);
+	}
+	for (int i=0; i<started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	free(threads);
+	return 0;
+}
+
+
+/*
+ * ########################################## CSV ##########################################
+*/
+
+static void write_csv(FILE* fp, const Sweep_Point* points, int num_points) {
+	for (int k=0; get_config_key(k); k++) {
+		fprintf(fp, "%s,", get_config_key(k));
+	}
+	fprintf(fp, "status,cycles,instructions,ipc,halted,rob_full_cycles,iq_full_cycles,lsq_full_cycles,rename_stall_cycles,result_bus_stall_cycles\n");
+
+	for (int p=0; p<num_points; p++) {
+		const Sweep_Point* point = &points[p];
+		for (int k=0; get_config_key(k); k++) {
+			int value = 0;
+			get_config_value(&point->config, get_config_key(k), &value);
+			fprintf(fp, "%d,", value);
+		}
+		const APEX_Stats* stats = &point->stats;
+		const char* status = (!point->valid) ? "invalid_config" : (!point->created) ? "init_failed" : (stats->halted) ? "halted" : "max_cycles";
+		double ipc = (stats->cycles > 0) ? (double)stats->instructions / stats->cycles : 0.0;
+		fprintf(fp, "%s,%lld,%lld,%.4f,%d,%lld,%lld,%lld,%lld,%lld\n", status, stats->cycles, stats->instructions, ipc, stats->halted,
+			stats->rob_full_cycles, stats->iq_full_cycles, stats->lsq_full_cycles, stats->rename_stall_cycles, stats->result_bus_stall_cycles);
+	}
+}
+
+
+/*
+ * ########################################## Main ##########################################
+*/
+
+int main(int argc, char const* argv[]) {
+
+	if (argc < 2) {
+		print_usage(argv[0]);
+		exit(1);
+	}
+
+	APEX_Config base;
+	init_default_config(&base);
+	static Sweep_Axis axes[MAX_SWEEP_AXES];
+	int num_axes = 0;
+	long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	long long max_cycles = DEFAULT_MAX_CYCLES;
+	long long fast_forward = 0;
+	long long warmup = 0;
+	const char* checkpoint = NULL;
+	const char* output = NULL;
+
+	for (int i=2; i<argc; i++) {
+		const char* option = argv[i];
+		const char* equal = strchr(option, '=');
+		if ((strncmp(option, "--", 2) != 0)||(!equal)||(equal - option - 2 >= (long)sizeof(axes[0].key))) {
+			fprintf(stderr, "APEX_Sweep : Invalid option '%s'\n", option);
+			print_usage(argv[0]);
+			exit(1);
+		}
+		if (strncmp(option, "--threads=", 10) == 0) {
+			num_threads = atol(equal + 1);
+		}
+		else if (strncmp(option, "--max_cycles=", 13) == 0) {
+			max_cycles = atoll(equal + 1);
+		}
+		else if (strncmp(option, "--fast_forward=", 15) == 0) {
+			fast_forward = atoll(equal + 1);
+		}
+		else if (strncmp(option, "--warmup=", 9) == 0) {
+			warmup = atoll(equal + 1);
+		}
+		else if (strncmp(option, "--checkpoint=", 13) == 0) {
+			checkpoint = equal + 1;
+		}
+		else if (strncmp(option, "--output=", 9) == 0) {
+			output = equal + 1;
+		}
+		else if (strncmp(option, "--config=", 9) == 0) {
+			if (read_config_file(&base, equal + 1) != APEX_CONFIG_SUCCESS) {
+				exit(1);
+			}
+		}
+		else {
+			if (num_axes >= MAX_SWEEP_AXES) {
+				fprintf(stderr, "APEX_Sweep : More than %d swept keys\n", MAX_SWEEP_AXES);
+				exit(1);
+			}
+			Sweep_Axis* axis = &axes[num_axes];
+			memcpy(axis->key, option + 2, equal - option - 2);
+			axis->key[equal - option - 2] = '\0';
+			// check the key once here, not for every point
+			APEX_Config probe = base;
+			if ((parse_axis_values(axis, equal + 1) != 0)||(set_config_value(&probe, axis->key, axis->values[0]) != APEX_CONFIG_SUCCESS)) {
+				exit(1);
+			}
+			num_axes += 1;
+		}
+	}
+	if ((num_threads < 1)||(max_cycles < 1)) {
+		fprintf(stderr, "APEX_Sweep : threads and max_cycles must be at least 1\n");
+		exit(1);
+	}
+	if ((fast_forward < 0)||(warmup < 0)) {
+		fprintf(stderr, "APEX_Sweep : fast_forward and warmup cannot be negative\n");
+		exit(1);
+	}
+
+	// program is parsed once and only read by every worker
+	APEX_Program* program = APEX_program_load(argv[1]);
+	if (!program) {
+		fprintf(stderr, "APEX_Sweep : Unable to load %s\n", argv[1]);
+		exit(1);
+	}
+	Sweep_Pool pool = {.program = program, .max_cycles = max_cycles, .fast_forward = fast_forward, .warmup = warmup, .checkpoint = checkpoint, .next_point = 0};
+	pool.points = create_grid(&base, axes, num_axes, &pool.num_points);
+	if (!pool.points) {
+		APEX_program_free(program);
+		exit(1);
+	}
+	if (num_threads > pool.num_points) {
+		num_threads = pool.num_points;
+	}
+
+	double start_time = get_wall_time();
+	run_pool(&pool, (int)num_threads);
+	double run_time = get_wall_time() - start_time;
+
+	FILE* fp = output ? fopen(output, "w") : stdout;
+	if (!fp) {
+		fprintf(stderr, "APEX_Sweep : Unable to open %s\n", output);
+	}
+	else {
+		write_csv(fp, pool.points, pool.num_points);
+		if (output) {
+			fclose(fp);
+		}
+	}
+	fprintf(stderr, "APEX_Sweep : %d points on %ld threads in %.3f s\n", pool.num_points, num_threads, run_time);
+
+	free(pool.points);
+	APEX_program_free(program);
+	return fp ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+MOVC,R2,#3
+NOP
+NOP
+NOP
+NOP
+NOP
+NOP
+NOP
+NOP
+MUL,R10,R2,R2
+MUL,R11,R10,R10
+MOVC,R5,#7
+MOVC,R12,#1
+ADD,R1,R2,R2
+DIV,R3,R1,R2
+MUL,R13,R3,R3
+MOVC,R10,#5
+MOVC,R14,#1
+ADD,R4,R2,R2
+EX-OR,R6,R4,R2
+STORE,R3,R2,#0
+STORE,R6,R2,#1
+HALT
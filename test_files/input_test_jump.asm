@@ -0,0 +1,18 @@
+MOVC,R1,#4000
+MOVC,R2,#5
+MOVC,R3,#0
+NOP
+ADDL,R3,R3,#7
+SUBL,R2,R2,#1
+BZ,#16
+JUMP,R1,#16
+NOP
+MOVC,R3,#99
+NOP
+MOVC,R4,#4060
+JUMP,R4,#0
+MOVC,R3,#-1
+HALT
+NOP
+STORE,R3,R2,#8
+HALT
@@ -0,0 +1,17 @@
+MOVC,R1,#4016
+MOVC,R2,#5
+MOVC,R3,#0
+MOVC,R5,#0
+ADDL,R3,R3,#7
+SUBL,R2,R2,#1
+BZ,#16
+JUMP,R1,#0
+MOVC,R3,#99
+MOVC,R5,#99
+ADDL,R4,R3,#4025
+JUMP,R4,#0
+MOVC,R3,#-1
+MOVC,R5,#-1
+HALT
+STORE,R3,R5,#8
+HALT
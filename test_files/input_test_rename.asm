@@ -0,0 +1,68 @@
+; apex_gen --size=60 --loop=10 --ilp=8 --seed=2 --mix=add:40,mul:20,load:20,store:15, run with more than 32 phys regs
+MOVC,R31,#0
+MOVC,R30,#1
+MOVC,R29,#3
+MOVC,R28,#10
+MOVC,R0,#1
+MOVC,R1,#2
+MOVC,R2,#3
+MOVC,R3,#4
+MOVC,R4,#5
+MOVC,R5,#6
+MOVC,R6,#7
+MOVC,R7,#8
+ADD,R0,R0,R29
+MUL,R1,R1,R30
+MUL,R2,R2,R30
+ADD,R3,R3,R29
+LOAD,R4,R31,#0
+STORE,R5,R31,#1
+ADD,R6,R6,R29
+MUL,R7,R7,R30
+STORE,R0,R31,#2
+LOAD,R1,R31,#3
+ADD,R2,R2,R29
+MUL,R3,R3,R30
+ADD,R4,R4,R29
+ADD,R5,R5,R29
+MUL,R6,R6,R30
+ADD,R7,R7,R29
+ADD,R0,R0,R29
+ADD,R1,R1,R29
+ADD,R2,R2,R29
+LOAD,R3,R31,#4
+STORE,R4,R31,#5
+ADD,R5,R5,R29
+ADD,R6,R6,R29
+MUL,R7,R7,R30
+ADD,R0,R0,R29
+ADD,R1,R1,R29
+LOAD,R2,R31,#6
+ADD,R3,R3,R29
+ADD,R4,R4,R29
+MUL,R5,R5,R30
+LOAD,R6,R31,#7
+STORE,R7,R31,#8
+LOAD,R0,R31,#9
+MUL,R1,R1,R30
+ADD,R2,R2,R29
+ADD,R3,R3,R29
+MUL,R4,R4,R30
+MUL,R5,R5,R30
+ADD,R6,R6,R29
+ADD,R7,R7,R29
+STORE,R0,R31,#10
+ADD,R1,R1,R29
+ADD,R2,R2,R29
+ADD,R3,R3,R29
+LOAD,R4,R31,#11
+ADD,R5,R5,R29
+STORE,R6,R31,#12
+ADD,R7,R7,R29
+ADD,R0,R0,R29
+STORE,R1,R31,#13
+ADD,R2,R2,R29
+ADD,R3,R3,R29
+SUBL,R28,R28,#1
+BNZ,#-244
+HALT
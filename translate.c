@@ -0,0 +1,474 @@
+/*
+ *  translate.c
+ *  Contains APEX ahead of time translation, code memory to C compiled and loaded as a functional engine
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <dlfcn.h>
+
+#include "cpu.h"
+#include "translate.h"
+#include "functional.h"
+#include "forwarding.h"
+
+/*
+ * ########################################## Basic Blocks ##########################################
+*/
+
+static int is_counted(int type) {
+	// same inst the interpreter counts, NOP and unknown types never complete
+	return ((type >= STORE)&&(type <= HALT));
+}
+
+
+static int is_block_end(int type) {
+	// control may leave after these, so the next inst starts a block
+	return ((type == BZ)||(type == BNZ)||(type == JUMP)||(type == HALT)||(type < STORE)||(type > NOP));
+}
+
+
+static int get_pc(int index) {
+	return 4000 + (index * 4);
+}
+
+
+static int get_branch_target(int pc, int imm) {
+	// wraps like the int add of Branch FU
+	return (int)((unsigned int)pc + (unsigned int)imm);
+}
+
+
+static int set_basic_blocks(const APEX_Instruction* code_memory, int code_memory_size, char* leader, int* block_count) {
+	// leaders are pc 4000, direct branch targets and inst after a block end
+	// block_count[i] is the inst counted from i to the end of its block, taken off the budget on entry at i
+	int end_pc = get_pc(code_memory_size);
+	memset(leader, 0, (size_t)code_memory_size);
+	if (code_memory_size > 0) {
+		leader[0] = 1;
+	}
+	for (int i=0; i<code_memory_size; i++) {
+		const APEX_Instruction* ins = &code_memory[i];
+		if ((ins->rd >= REGISTER_FILE_SIZE)||(ins->rs1 >= REGISTER_FILE_SIZE)||(ins->rs2 >= REGISTER_FILE_SIZE)) {
+			fprintf(stderr, "Native Invalid Register in %s at pc(%d)\n", get_inst_name(ins->type), get_pc(i));
+			return FAILURE;
+		}
+		if (is_block_end(ins->type)&&(i+1 < code_memory_size)) {
+			leader[i+1] = 1;
+		}
+		if ((ins->type == BZ)||(ins->type == BNZ)) {
+			int target = get_branch_target(get_pc(i), ins->imm);
+			if ((target >= 4000)&&(target < end_pc)&&((target - 4000) % 4 == 0)) {
+				leader[(target - 4000) / 4] = 1;
+			}
+		}
+	}
+	for (int i=code_memory_size-1; i>=0; i--) {
+		int rest = ((i+1 < code_memory_size)&&(!leader[i+1])) ? block_count[i+1] : 0;
+		block_count[i] = rest + (is_counted(code_memory[i].type) ? 1 : 0);
+	}
+	return SUCCESS;
+}
+
+
+/*
+ * ########################################## Code Generation ##########################################
+*/
+
+static void write_int(FILE* fp, int value) {
+	// INT_MIN has no literal of type int
+	if (value == INT_MIN) {
+		fprintf(fp, "(%d-1)", INT_MIN + 1);
+	}
+	else {
+		fprintf(fp, "(%d)", value);
+	}
+}
+
+
+static void write_goto_pc(FILE* fp, int target, int end_pc, const char* indent) {
+	// target is already known to be inside code memory or one past it
+	if (target == end_pc) {
+		fprintf(fp, "%spc = %d;\n%sgoto out_empty;\n", indent, target, indent);
+	}
+	else if ((target - 4000) % 4 == 0) {
+		fprintf(fp, "%sgoto E%d;\n", indent, (target - 4000) / 4);
+	}
+	else {
+		// unaligned targets are left to the interpreter
+		fprintf(fp, "%spc = %d;\n%sgoto out_fallback;\n", indent, target, indent);
+	}
+}
+
+
+static void write_block_entry(FILE* fp, int index, int count) {
+	// a block runs only when all its inst fit the budget, the last partial block is left to the interpreter
+	fprintf(fp, "E%d:\n", index);
+	fprintf(fp, "\tif (left <= %d) {\n\t\tpc = %d;\n\t\tgoto out_limit;\n\t}\n", count, get_pc(index));
+	if (count > 0) {
+		fprintf(fp, "\tleft -= %d;\n", count);
+	}
+}
+
+
+static void write_address(FILE* fp, const APEX_Instruction* ins, int use_imm) {
+	fprintf(fp, "\taddress = (int)((unsigned int)r%d + (unsigned int)", ins->rs1);
+	if (use_imm) {
+		write_int(fp, ins->imm);
+	}
+	else {
+		fprintf(fp, "r%d", ins->rs2);
+	}
+	fprintf(fp, ");\n");
+}
+
+
+static void write_set_zf(FILE* fp, const char* indent) {
+	fprintf(fp, "%szf_value = value;\n%szf = (value == 0) ? 1 : 0;\n", indent, indent);
+}
+
+
+static void write_instruction(FILE* fp, const APEX_Instruction* ins, int index, int end_pc) {
+	// same semantics as the handlers of APEX_functional_run, see functional.c
+	int pc = get_pc(index);
+	int target = 0;
+	switch (ins->type) {
+		case STORE:
+		case STR:
+			write_address(fp, ins, ins->type == STORE);
+			fprintf(fp, "\tif ((address < 0)||(address >= %d)) {\n", DATA_MEMORY_SIZE);
+			fprintf(fp, "\t\tfprintf(stderr, \"Segmentation fault for writing memory location :: %%d\\n\", address);\n");
+			fprintf(fp, "\t}\n\telse {\n\t\tdata_memory[address] = r%d;\n\t}\n", ins->rd);
+			break;
+		case LOAD:
+		case LDR:
+			write_address(fp, ins, ins->type == LOAD);
+			fprintf(fp, "\tif ((address < 0)||(address >= %d)) {\n", DATA_MEMORY_SIZE);
+			fprintf(fp, "\t\tfprintf(stderr, \"Segmentation fault for accessing memory location :: %%d\\n\", address);\n");
+			fprintf(fp, "\t}\n\telse {\n\t\tr%d = data_memory[address];\n\t}\n", ins->rd);
+			break;
+		case MOVC:
+			fprintf(fp, "\tr%d = ", ins->rd);
+			write_int(fp, ins->imm);
+			fprintf(fp, ";\n");
+			break;
+		case MOV:
+			fprintf(fp, "\tr%d = r%d;\n", ins->rd, ins->rs1);
+			break;
+		case ADD:
+		case ADDL:
+			// result is dropped on overflow, rd and ZF keep their values
+			fprintf(fp, "\tif (__builtin_add_overflow(r%d, ", ins->rs1);
+			if (ins->type == ADDL) {
+				write_int(fp, ins->imm);
+			}
+			else {
+				fprintf(fp, "r%d", ins->rs2);
+			}
+			fprintf(fp, ", &value)) {\n\t\tof = 1;\n\t}\n\telse {\n\t\tof = 0;\n\t\tr%d = value;\n", ins->rd);
+			write_set_zf(fp, "\t\t");
+			fprintf(fp, "\t}\n");
+			break;
+		case SUB:
+		case SUBL:
+			// ZF is only updated without carry
+			if (ins->type == SUBL) {
+				fprintf(fp, "\tvalue = ");
+				write_int(fp, ins->imm);
+				fprintf(fp, ";\n");
+			}
+			else {
+				fprintf(fp, "\tvalue = r%d;\n", ins->rs2);
+			}
+			fprintf(fp, "\tif (value > r%d) {\n\t\tcf = 1;\n", ins->rs1);
+			fprintf(fp, "\t\tvalue = (int)((unsigned int)r%d - (unsigned int)value);\n\t\tzf_value = value;\n\t}\n", ins->rs1);
+			fprintf(fp, "\telse {\n\t\tcf = 0;\n\t\tvalue = (int)((unsigned int)r%d - (unsigned int)value);\n", ins->rs1);
+			write_set_zf(fp, "\t\t");
+			fprintf(fp, "\t}\n\tr%d = value;\n", ins->rd);
+			break;
+		case MUL:
+			fprintf(fp, "\tvalue = (int)((unsigned int)r%d * (unsigned int)r%d);\n\tr%d = value;\n", ins->rs1, ins->rs2, ins->rd);
+			write_set_zf(fp, "\t");
+			break;
+		case DIV:
+			// division by zero gives zero, ZF flag is left as it was
+			fprintf(fp, "\tif (r%d == 0) {\n\t\tvalue = 0;\n\t\tzf_value = 0;\n\t}\n", ins->rs2);
+			fprintf(fp, "\telse {\n\t\tvalue = ((r%d == INT_MIN)&&(r%d == -1)) ? INT_MIN : r%d / r%d;\n", ins->rs1, ins->rs2, ins->rs1, ins->rs2);
+			write_set_zf(fp, "\t\t");
+			fprintf(fp, "\t}\n\tr%d = value;\n", ins->rd);
+			break;
+		case AND:
+			fprintf(fp, "\tr%d = r%d & r%d;\n", ins->rd, ins->rs1, ins->rs2);
+			break;
+		case OR:
+			fprintf(fp, "\tr%d = r%d | r%d;\n", ins->rd, ins->rs1, ins->rs2);
+			break;
+		case EXOR:
+			fprintf(fp, "\tr%d = r%d ^ r%d;\n", ins->rd, ins->rs1, ins->rs2);
+			break;
+		case BZ:
+		case BNZ:
+			// not taken falls through to the next block
+			target = get_branch_target(pc, ins->imm);
+			fprintf(fp, "\tif (zf_value %s 0) {\n", (ins->type == BZ) ? "==" : "!=");
+			if ((target < 4000)||(target > end_pc)) {
+				fprintf(fp, "\t\tfprintf(stderr, \"Instruction %s Invalid Relative Address %%d\\n\", %d);\n", get_inst_name(ins->type), target);
+			}
+			else {
+				write_goto_pc(fp, target, end_pc, "\t\t");
+			}
+			fprintf(fp, "\t}\n");
+			break;
+		case JUMP:
+			// target is only known at run time, it goes through the dispatch switch
+			fprintf(fp, "\tnew_pc = (int)((unsigned int)r%d + (unsigned int)", ins->rs1);
+			write_int(fp, ins->imm);
+			fprintf(fp, ");\n\tif ((new_pc < 4000)||(new_pc > %d)) {\n", end_pc);
+			fprintf(fp, "\t\tfprintf(stderr, \"Instruction %s Invalid Address %%d\\n\", new_pc);\n", get_inst_name(ins->type));
+			fprintf(fp, "\t}\n\telse {\n\t\tpc = new_pc;\n\t\tgoto dispatch;\n\t}\n");
+			break;
+		case HALT:
+			fprintf(fp, "\tpc = %d;\n\tgoto out_halt;\n", pc + 4);
+			break;
+		case NOP:
+			fprintf(fp, "\t;\n");
+			break;
+		default:
+			fprintf(fp, "\tpc = %d;\n\tgoto out_empty;\n", pc);
+			break;
+	}
+}
+
+
+int write_native_source(FILE* fp, const APEX_Instruction* code_memory, int code_memory_size) {
+	// one C function for the whole program, every basic block is a label and branches are gotos
+	// arch regs and flags live in locals and are written back on every exit
+	int end_pc = get_pc(code_memory_size);
+	char* leader = apex_malloc((size_t)code_memory_size + 1);
+	int* block_count = apex_malloc(((size_t)code_memory_size + 1) * sizeof(int));
+	if ((!leader)||(!block_count)||(set_basic_blocks(code_memory, code_memory_size, leader, block_count) != SUCCESS)) {
+		free(leader);
+		free(block_count);
+		return FAILURE;
+	}
+
+	fprintf(fp, "/* Generated by libapex from %d inst of code memory */\n\n", code_memory_size);
+	fprintf(fp, "#include <stdio.h>\n#include <limits.h>\n\n");
+	fprintf(fp, "int %s(int* regs, int* flags, int* data_memory, int* zf_value_ptr, int* pc_ptr, long long* executed, long long max_instructions) {\n", NATIVE_RUN_SYMBOL);
+	for (int i=0; i<REGISTER_FILE_SIZE; i++) {
+		fprintf(fp, "\tint r%d = regs[%d];\n", i, i);
+	}
+	fprintf(fp, "\tint zf = flags[%d];\n\tint cf = flags[%d];\n\tint of = flags[%d];\n", ZF, CF, OF);
+	fprintf(fp, "\tint zf_value = *zf_value_ptr;\n\tint pc = *pc_ptr;\n\tlong long left = max_instructions;\n");
+	fprintf(fp, "\tint value = 0;\n\tint address = 0;\n\tint new_pc = 0;\n\tint ret = 0;\n\n");
+
+	// entry and JUMP targets, any inst can be entered with the count of the rest of its block
+	fprintf(fp, "dispatch:\n\tswitch (pc) {\n");
+	for (int i=0; i<code_memory_size; i++) {
+		fprintf(fp, "\t\tcase %d: goto E%d;\n", get_pc(i), i);
+	}
+	fprintf(fp, "\t\tcase %d: goto out_empty;\n\t\tdefault: goto out_fallback;\n\t}\n\n", end_pc);
+
+	for (int i=0; i<code_memory_size; i++) {
+		if (leader[i]) {
+			write_block_entry(fp, i, block_count[i]);
+		}
+		fprintf(fp, "B%d:\t// pc(%d) %s\n", i, get_pc(i), get_inst_name(code_memory[i].type));
+		write_instruction(fp, &code_memory[i], i, end_pc);
+	}
+	fprintf(fp, "\tpc = %d;\n\tgoto out_empty;\n\n", end_pc);
+
+	// entries into the middle of a block, only reached through dispatch
+	for (int i=0; i<code_memory_size; i++) {
+		if (!leader[i]) {
+			write_block_entry(fp, i, block_count[i]);
+			fprintf(fp, "\tgoto B%d;\n", i);
+		}
+	}
+
+	fprintf(fp, "\nout_limit:\n\tret = %d;\n\tgoto out;\n", SUCCESS);
+	fprintf(fp, "out_fallback:\n\tret = %d;\n\tgoto out;\n", FAILURE);
+	fprintf(fp, "out_empty:\n\tret = %d;\n\tgoto out;\n", EMPTY);
+	fprintf(fp, "out_halt:\n\tret = %d;\n", HALT);
+	fprintf(fp, "out:\n");
+	for (int i=0; i<REGISTER_FILE_SIZE; i++) {
+		fprintf(fp, "\tregs[%d] = r%d;\n", i, i);
+	}
+	fprintf(fp, "\tflags[%d] = zf;\n\tflags[%d] = cf;\n\tflags[%d] = of;\n", ZF, CF, OF);
+	fprintf(fp, "\t*zf_value_ptr = zf_value;\n\t*pc_ptr = pc;\n\t*executed = max_instructions - left;\n\treturn ret;\n}\n");
+
+	free(leader);
+	free(block_count);
+	return ferror(fp) ? FAILURE : SUCCESS;
+}
+
+
+/*
+ * ########################################## Compile Load ##########################################
+*/
+
+static char* get_path(const char* dir, const char* name) {
+	size_t size = strlen(dir) + strlen(name) + 2;
+	char* path = apex_malloc(size);
+	if (path) {
+		snprintf(path, size, "%s/%s", dir, name);
+	}
+	return path;
+}
+
+
+static int split_words(char* str, char** argv, int count, int max) {
+	// APEX_CC and the cflags are split on blanks, no shell so no quoting
+	for (char* word = strtok(str, " \t"); word; word = strtok(NULL, " \t")) {
+		if (count >= max) {
+			return -1;
+		}
+		argv[count++] = word;
+	}
+	return count;
+}
+
+
+static int compile_native_source(const char* source, const char* object, int code_memory_size) {
+	// compiler runs with fork and execvp, paths and APEX_CC never go through a shell
+	const char* compiler = getenv("APEX_CC");
+	if ((!compiler)||(compiler[0] == '\0')) {
+		compiler = NATIVE_CC;
+	}
+	const char* flags = (code_memory_size > NATIVE_LARGE_PROGRAM) ? NATIVE_CFLAGS_LARGE : NATIVE_CFLAGS;
+	char* words = apex_malloc(strlen(compiler) + strlen(flags) + 2);
+	if (!words) {
+		return FAILURE;
+	}
+	sprintf(words, "%s %s", compiler, flags);
+	char* argv[NATIVE_MAX_ARGS + 4];
+	int argc = split_words(words, argv, 0, NATIVE_MAX_ARGS);
+	if (argc <= 0) {
+		fprintf(stderr, "APEX_Native : APEX_CC has no compiler or more than %d words\n", NATIVE_MAX_ARGS);
+		free(words);
+		return FAILURE;
+	}
+	argv[argc++] = "-o";
+	argv[argc++] = (char*)object;
+	argv[argc++] = (char*)source;
+	argv[argc] = NULL;
+
+	int status = -1;
+	pid_t pid = fork();
+	if (pid == 0) {
+		execvp(argv[0], argv);
+		fprintf(stderr, "APEX_Native : Unable to run %s\n", argv[0]);
+		_exit(127);
+	}
+	int ret = FAILURE;
+	if (pid < 0) {
+		fprintf(stderr, "APEX_Native : Unable to fork for %s\n", argv[0]);
+	}
+	else {
+		while ((waitpid(pid, &status, 0) < 0)&&(errno == EINTR)) {
+		}
+		ret = ((WIFEXITED(status))&&(WEXITSTATUS(status) == 0)) ? SUCCESS : FAILURE;
+		if (ret != SUCCESS) {
+			fprintf(stderr, "APEX_Native : %s failed on %s\n", argv[0], source);
+		}
+	}
+	free(words);
+	return ret;
+}
+
+
+int load_native_code(Native_Code* native, const APEX_Instruction* code_memory, int code_memory_size) {
+	// generated C and shared object only live in a temp dir till dlopen, the mapping stays after unlink
+	memset(native, 0, sizeof(*native));
+	const char* temp = getenv("TMPDIR");
+	if ((!temp)||(temp[0] == '\0')) {
+		temp = "/tmp";
+	}
+	char* dir = get_path(temp, "apex_native_XXXXXX");
+	if ((!dir)||(!mkdtemp(dir))) {
+		fprintf(stderr, "APEX_Native : Unable to create a directory in %s\n", temp);
+		free(dir);
+		return FAILURE;
+	}
+	char* source = get_path(dir, "code.c");
+	char* object = get_path(dir, "code.so");
+	int ret = ((source)&&(object)) ? SUCCESS : FAILURE;
+
+	FILE* fp = (ret == SUCCESS) ? fopen(source, "w") : NULL;
+	if (!fp) {
+		fprintf(stderr, "APEX_Native : Unable to write generated code to %s\n", dir);
+		ret = FAILURE;
+	}
+	else {
+		ret = write_native_source(fp, code_memory, code_memory_size);
+		if ((fclose(fp) != 0)&&(ret == SUCCESS)) {
+			fprintf(stderr, "APEX_Native : Unable to write generated code to %s\n", dir);
+			ret = FAILURE;
+		}
+	}
+	if (ret == SUCCESS) {
+		ret = compile_native_source(source, object, code_memory_size);
+	}
+	if (ret == SUCCESS) {
+		native->handle = dlopen(object, RTLD_NOW | RTLD_LOCAL);
+		native->run = (native->handle) ? (Native_Run)dlsym(native->handle, NATIVE_RUN_SYMBOL) : NULL;
+		if (!native->run) {
+			fprintf(stderr, "APEX_Native : %s\n", dlerror());
+			unload_native_code(native);
+			ret = FAILURE;
+		}
+		else {
+			native->code_memory_size = code_memory_size;
+		}
+	}
+
+	if (source) {
+		remove(source);
+	}
+	if (object) {
+		remove(object);
+	}
+	rmdir(dir);
+	free(source);
+	free(object);
+	free(dir);
+	return ret;
+}
+
+
+void unload_native_code(Native_Code* native) {
+	if (native->handle) {
+		dlclose(native->handle);
+	}
+	memset(native, 0, sizeof(*native));
+}
+
+
+/*
+ * ########################################## Native Run ##########################################
+*/
+
+int APEX_native_run(APEX_CPU* cpu, const Native_Code* native, long long max_instructions) {
+	// same returns as APEX_functional_run, which finishes what the generated code hands back
+	// that is the last block when it does not fit max_instructions, or an unaligned target
+	if (native->code_memory_size != cpu->code_memory_size) {
+		return ERROR;
+	}
+	long long executed = 0;
+	int ret = native->run(cpu->regs, cpu->flags, cpu->data_memory, &cpu->zf_value, &cpu->pc, &executed, max_instructions);
+	cpu->functional_ins_completed += executed;
+	if ((ret == FAILURE)||((ret == SUCCESS)&&(executed < max_instructions))) {
+		ret = APEX_functional_run(cpu, max_instructions - executed);
+	}
+	return ret;
+}
@@ -0,0 +1,51 @@
+#ifndef _APEX_TRANSLATE_H_
+#define _APEX_TRANSLATE_H_
+/*
+ *  translate.h
+ *  Contains APEX ahead of time translation, code memory to C compiled and loaded as a functional engine
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+
+#include "cpu.h"
+
+/* Compiler for the generated C, APEX_CC in the environment overrides it */
+#ifndef NATIVE_CC
+#define NATIVE_CC "cc"
+#endif
+#ifndef NATIVE_CFLAGS
+#define NATIVE_CFLAGS "-O2 -shared -fPIC -w"
+#endif
+// compile time grows with inst count, programs bigger than this use the cheaper flags below
+#ifndef NATIVE_LARGE_PROGRAM
+#define NATIVE_LARGE_PROGRAM 256
+#endif
+#ifndef NATIVE_CFLAGS_LARGE
+#define NATIVE_CFLAGS_LARGE "-O1 -shared -fPIC -w"
+#endif
+// words APEX_CC and NATIVE_CFLAGS (or NATIVE_CFLAGS_LARGE) together can have
+#define NATIVE_MAX_ARGS 64
+// symbol the generated shared object exports
+#define NATIVE_RUN_SYMBOL "apex_native_run"
+
+/* Entry point of generated code, arch state is passed as plain pointers so no struct layout is shared */
+typedef int (*Native_Run)(int* regs, int* flags, int* data_memory, int* zf_value, int* pc, long long* executed, long long max_instructions);
+
+/* One program compiled to a shared object */
+typedef struct Native_Code {
+	void* handle;		// dlopen handle
+	Native_Run run;
+	int code_memory_size;		// inst translated
+} Native_Code;
+
+
+int write_native_source(FILE* fp, const APEX_Instruction* code_memory, int code_memory_size);
+int load_native_code(Native_Code* native, const APEX_Instruction* code_memory, int code_memory_size);
+void unload_native_code(Native_Code* native);
+int APEX_native_run(APEX_CPU* cpu, const Native_Code* native, long long max_instructions);
+
+#endif